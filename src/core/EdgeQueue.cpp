@@ -0,0 +1,166 @@
+#include "EdgeQueue.hpp"
+
+#include <algorithm>
+
+namespace subface {
+
+EdgeQueue::EdgeQueue(std::vector<Vertex>& vertexes)
+    : vertex_base_(vertexes.data())
+    , incident_(vertexes.size())
+{
+}
+
+bool EdgeQueue::Less(uint32_t a, uint32_t b) const
+{
+    const QueueEdge& ea = edges_[a];
+    const QueueEdge& eb = edges_[b];
+    if (ea.cost != eb.cost)
+        return ea.cost < eb.cost;
+    if (ea.v[0] != eb.v[0])
+        return ea.v[0] < eb.v[0];
+    return ea.v[1] < eb.v[1];
+}
+
+void EdgeQueue::Place(size_t pos, uint32_t e)
+{
+    heap_[pos] = e;
+    heap_pos_[e] = static_cast<uint32_t>(pos);
+}
+
+void EdgeQueue::SiftUp(size_t pos)
+{
+    uint32_t e = heap_[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!Less(e, heap_[parent]))
+            break;
+        Place(pos, heap_[parent]);
+        pos = parent;
+    }
+    Place(pos, e);
+}
+
+void EdgeQueue::SiftDown(size_t pos)
+{
+    uint32_t e = heap_[pos];
+    size_t size = heap_.size();
+    while (true) {
+        size_t child = pos * 2 + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size && Less(heap_[child + 1], heap_[child]))
+            ++child;
+        if (!Less(heap_[child], e))
+            break;
+        Place(pos, heap_[child]);
+        pos = child;
+    }
+    Place(pos, e);
+}
+
+uint32_t EdgeQueue::Push(Vertex* v0, Vertex* v1, float cost, bool heapify)
+{
+    uint32_t e = Find(v0, v1);
+    if (e != INVALID)
+        return e;
+
+    e = static_cast<uint32_t>(edges_.size());
+    edges_.push_back({ { std::min(v0, v1), std::max(v0, v1) }, cost });
+    heap_pos_.push_back(static_cast<uint32_t>(heap_.size()));
+    heap_.push_back(e);
+    incident_[VertexIndex(v0)].push_back(e);
+    incident_[VertexIndex(v1)].push_back(e);
+    if (heapify)
+        SiftUp(heap_.size() - 1);
+    return e;
+}
+
+void EdgeQueue::Heapify()
+{
+    for (size_t pos = heap_.size() / 2; pos-- > 0;)
+        SiftDown(pos);
+}
+
+uint32_t EdgeQueue::Find(const Vertex* v0, const Vertex* v1) const
+{
+    const Vertex* a = std::min(v0, v1);
+    const Vertex* b = std::max(v0, v1);
+    // Scan the shorter list.
+    const std::vector<uint32_t>& inc0 = incident_[VertexIndex(a)];
+    const std::vector<uint32_t>& inc1 = incident_[VertexIndex(b)];
+    for (uint32_t e : inc0.size() <= inc1.size() ? inc0 : inc1)
+        if (heap_pos_[e] != INVALID && edges_[e].v[0] == a && edges_[e].v[1] == b)
+            return e;
+    return INVALID;
+}
+
+void EdgeQueue::Remove(uint32_t e)
+{
+    if (!Contains(e))
+        return;
+
+    size_t pos = heap_pos_[e];
+    heap_pos_[e] = INVALID;
+    uint32_t last = heap_.back();
+    heap_.pop_back();
+    if (pos < heap_.size()) {
+        Place(pos, last);
+        SiftUp(pos);
+        SiftDown(heap_pos_[last]);
+    }
+}
+
+void EdgeQueue::RemoveIncident(const Vertex* v)
+{
+    std::vector<uint32_t>& inc = incident_[VertexIndex(v)];
+    for (uint32_t e : inc)
+        if (heap_pos_[e] != INVALID && (edges_[e].v[0] == v || edges_[e].v[1] == v))
+            Remove(e);
+    inc.clear();
+}
+
+void EdgeQueue::Update(uint32_t e, float cost)
+{
+    if (!Contains(e))
+        return;
+
+    edges_[e].cost = cost;
+    size_t pos = heap_pos_[e];
+    SiftUp(pos);
+    SiftDown(heap_pos_[e]);
+}
+
+void EdgeQueue::Merge(Vertex* from, Vertex* to)
+{
+    std::vector<uint32_t> inc_from = std::move(incident_[VertexIndex(from)]);
+    incident_[VertexIndex(from)].clear();
+
+    for (uint32_t e : inc_from) {
+        QueueEdge& qe = edges_[e];
+        if (heap_pos_[e] == INVALID || (qe.v[0] != from && qe.v[1] != from))
+            continue;
+        Vertex* other = qe.v[0] == from ? qe.v[1] : qe.v[0];
+        if (other == to || Find(other, to) != INVALID) {
+            Remove(e);
+            continue;
+        }
+        qe.v[0] = std::min(other, to);
+        qe.v[1] = std::max(other, to);
+        // The tie-breaking order may have changed.
+        Update(e, qe.cost);
+        incident_[VertexIndex(to)].push_back(e);
+    }
+    Incident(to);
+}
+
+const std::vector<uint32_t>& EdgeQueue::Incident(const Vertex* v)
+{
+    std::vector<uint32_t>& inc = incident_[VertexIndex(v)];
+    inc.erase(std::remove_if(inc.begin(), inc.end(), [&](uint32_t e) {
+        return heap_pos_[e] == INVALID || (edges_[e].v[0] != v && edges_[e].v[1] != v);
+    }),
+        inc.end());
+    return inc;
+}
+
+}
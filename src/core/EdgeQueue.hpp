@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Subface.hpp"
+
+namespace subface {
+
+// Indexed binary min-heap of edges for edge-collapse decimation.
+// Each edge gets a stable handle when pushed, so its cost can be updated or the edge removed in O(log n) without searching.
+// Each vertex keeps a list of its incident edge handles, which makes looking up an edge O(valence).
+// Handles of removed or re-targeted edges are left in the incident lists and skipped lazily.
+class EdgeQueue {
+public:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    struct QueueEdge {
+        // `v[0] < v[1]` always holds. Together with `cost` this defines a strict total order,
+        // so the pop order doesn't depend on the heap layout.
+        Vertex* v[2];
+        float cost;
+    };
+
+private:
+    const Vertex* vertex_base_;
+    std::vector<QueueEdge> edges_;
+    // Heap of edge handles.
+    std::vector<uint32_t> heap_;
+    // Position of each edge in `heap_`, or `INVALID` if removed.
+    std::vector<uint32_t> heap_pos_;
+    // Incident edge handles of each vertex.
+    std::vector<std::vector<uint32_t>> incident_;
+
+    size_t VertexIndex(const Vertex* v) const
+    {
+        return static_cast<size_t>(v - vertex_base_);
+    }
+    bool Less(uint32_t a, uint32_t b) const;
+    void Place(size_t pos, uint32_t e);
+    void SiftUp(size_t pos);
+    void SiftDown(size_t pos);
+
+public:
+    // `vertexes` must outlive the queue. Vertexes are identified by their offsets in it.
+    explicit EdgeQueue(std::vector<Vertex>& vertexes);
+
+    // Add edge `(v0, v1)` unless it's already in the queue. Returns the handle either way.
+    // Edges added with `heapify==false` are not ordered until `Heapify()` is called.
+    uint32_t Push(Vertex* v0, Vertex* v1, float cost, bool heapify = true);
+    // Build the heap in O(n) after pushing edges with `heapify==false`.
+    void Heapify();
+    // Handle of edge `(v0, v1)`, or `INVALID` if it's not in the queue.
+    uint32_t Find(const Vertex* v0, const Vertex* v1) const;
+    void Remove(uint32_t e);
+    // Remove all the edges incident to `v`.
+    void RemoveIncident(const Vertex* v);
+    // Increase or decrease the cost of edge `e`.
+    void Update(uint32_t e, float cost);
+    // Re-target all the edges of `from` to `to`. Edges that would duplicate an existing edge of `to`,
+    // or would become the loop `(to, to)`, are removed.
+    void Merge(Vertex* from, Vertex* to);
+    // Live edges incident to `v`. Stale handles are compacted away.
+    const std::vector<uint32_t>& Incident(const Vertex* v);
+
+    bool Empty() const
+    {
+        return heap_.empty();
+    }
+    size_t Size() const
+    {
+        return heap_.size();
+    }
+    bool Contains(uint32_t e) const
+    {
+        return e < heap_pos_.size() && heap_pos_[e] != INVALID;
+    }
+    uint32_t Top() const
+    {
+        return heap_.front();
+    }
+    const QueueEdge& operator[](uint32_t e) const
+    {
+        return edges_[e];
+    }
+};
+
+}
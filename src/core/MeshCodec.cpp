@@ -0,0 +1,478 @@
+#include "MeshCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Parallel.hpp"
+
+namespace subface {
+
+// Elements and triangles per block. Blocks are coded independently, so they are the unit of parallelism.
+const size_t vertex_block_size = 8192;
+const size_t index_block_size = 8192;
+
+// Encode the blocks on `thread_count` threads, then concatenate them after the table of their end offsets.
+template <typename EncodeBlock>
+static std::vector<uint8_t> EncodeBlocks(size_t block_count, int thread_count, const EncodeBlock& encode_block)
+{
+    std::vector<std::vector<uint8_t>> blocks(block_count);
+    ParallelFor(block_count, thread_count <= 0 ? DefaultThreadCount() : thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t b = begin; b < end; ++b)
+            encode_block(b, blocks[b]);
+    });
+
+    size_t size = block_count * sizeof(uint64_t);
+    for (const std::vector<uint8_t>& block : blocks)
+        size += block.size();
+    std::vector<uint8_t> stream;
+    stream.reserve(size);
+    stream.resize(block_count * sizeof(uint64_t));
+    for (size_t b = 0; b < block_count; ++b) {
+        stream.insert(stream.end(), blocks[b].begin(), blocks[b].end());
+        uint64_t block_end = stream.size();
+        std::memcpy(&stream[b * sizeof(uint64_t)], &block_end, sizeof(block_end));
+        std::vector<uint8_t>().swap(blocks[b]);
+    }
+    return stream;
+}
+
+// Call `decode_block(block, begin, end)` on `thread_count` threads. Returns false if the table is corrupted or a call returns false.
+template <typename DecodeBlock>
+static bool DecodeBlocks(const uint8_t* data, size_t size, size_t block_count, int thread_count, const DecodeBlock& decode_block)
+{
+    if (block_count == 0)
+        return size == 0;
+    if (size / sizeof(uint64_t) < block_count)
+        return false;
+    std::vector<uint64_t> block_ends(block_count);
+    std::memcpy(block_ends.data(), data, block_count * sizeof(uint64_t));
+    uint64_t block_begin = block_count * sizeof(uint64_t);
+    for (uint64_t block_end : block_ends) {
+        if (block_end < block_begin || block_end > size)
+            return false;
+        block_begin = block_end;
+    }
+
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+    std::vector<uint8_t> thread_invalid(thread_count, 0);
+    ParallelFor(block_count, thread_count, [&](size_t begin, size_t end, int tid) {
+        for (size_t b = begin; b < end && !thread_invalid[tid]; ++b)
+            if (!decode_block(b, data + (b == 0 ? block_count * sizeof(uint64_t) : block_ends[b - 1]), data + block_ends[b]))
+                thread_invalid[tid] = 1;
+    });
+    return std::find(thread_invalid.begin(), thread_invalid.end(), 1) == thread_invalid.end();
+}
+
+// Codes of the words of one channel, i.e. the same word of consecutive elements, against the previous word.
+enum EChannelMode : uint8_t {
+    CM_Delta = 0,
+    CM_Xor = 1,
+};
+
+static uint32_t ChannelCode(EChannelMode mode, uint32_t word, uint32_t previous)
+{
+    if (mode == CM_Xor)
+        return word ^ previous;
+    // Zigzag, so that small negative deltas have small codes too.
+    uint32_t delta = word - previous;
+    return (delta << 1) ^ (0u - (delta >> 31));
+}
+
+static uint32_t ChannelWord(EChannelMode mode, uint32_t code, uint32_t previous)
+{
+    if (mode == CM_Xor)
+        return code ^ previous;
+    return previous + ((code >> 1) ^ (0u - (code & 1)));
+}
+
+// Append the 4 byte planes of `codes`, padded with zeros to groups of 16. Each plane is the 2-bit widths of its groups, 0, 2, 4
+// or 8 bits, 4 groups per byte, followed by the groups packed at their widths.
+static void EncodeBytePlanes(const uint32_t* codes, size_t count, std::vector<uint8_t>& out)
+{
+    size_t group_count = (count + 15) / 16;
+    for (int plane = 0; plane < 4; ++plane) {
+        size_t widths = out.size();
+        out.resize(out.size() + (group_count + 3) / 4, 0);
+        for (size_t g = 0; g < group_count; ++g) {
+            uint8_t bytes[16] = {};
+            uint8_t any = 0;
+            for (size_t k = 0; k < 16 && g * 16 + k < count; ++k) {
+                bytes[k] = static_cast<uint8_t>(codes[g * 16 + k] >> (plane * 8));
+                any |= bytes[k];
+            }
+            int width = any == 0 ? 0 : any < 4 ? 1 : any < 16 ? 2 : 3;
+            out[widths + g / 4] |= static_cast<uint8_t>(width << (g % 4 * 2));
+            if (width == 1) {
+                for (int j = 0; j < 4; ++j)
+                    out.push_back(static_cast<uint8_t>(bytes[j * 4] | bytes[j * 4 + 1] << 2 | bytes[j * 4 + 2] << 4 | bytes[j * 4 + 3] << 6));
+            } else if (width == 2) {
+                for (int j = 0; j < 8; ++j)
+                    out.push_back(static_cast<uint8_t>(bytes[j * 2] | bytes[j * 2 + 1] << 4));
+            } else if (width == 3) {
+                out.insert(out.end(), bytes, bytes + 16);
+            }
+        }
+    }
+}
+
+// Bytes of the packed bytes of 2-bit and 4-bit groups, little-endian.
+struct UnpackTables {
+    uint32_t two[256];
+    uint16_t four[256];
+
+    UnpackTables()
+    {
+        for (uint32_t x = 0; x < 256; ++x) {
+            two[x] = (x & 3) | (x >> 2 & 3) << 8 | (x >> 4 & 3) << 16 | (x >> 6) << 24;
+            four[x] = static_cast<uint16_t>((x & 15) | (x >> 4) << 8);
+        }
+    }
+};
+const UnpackTables unpack_tables;
+
+// Inverse of `EncodeBytePlanes()` into the 4 planes of `planes`, each of `count` rounded up to groups of 16 bytes.
+// Returns false if it would read past `end`.
+static bool DecodeBytePlanes(const uint8_t*& p, const uint8_t* end, uint8_t* planes, size_t count)
+{
+    size_t group_count = (count + 15) / 16;
+    for (int plane = 0; plane < 4; ++plane) {
+        const uint8_t* widths = p;
+        if (static_cast<size_t>(end - p) < (group_count + 3) / 4)
+            return false;
+        p += (group_count + 3) / 4;
+        uint8_t* group = planes + plane * group_count * 16;
+        for (size_t g = 0; g < group_count; ++g, group += 16) {
+            switch (widths[g / 4] >> (g % 4 * 2) & 3) {
+            case 0:
+                std::memset(group, 0, 16);
+                break;
+            case 1:
+                if (end - p < 4)
+                    return false;
+                for (int j = 0; j < 4; ++j)
+                    std::memcpy(group + j * 4, &unpack_tables.two[p[j]], 4);
+                p += 4;
+                break;
+            case 2:
+                if (end - p < 8)
+                    return false;
+                for (int j = 0; j < 8; ++j)
+                    std::memcpy(group + j * 2, &unpack_tables.four[p[j]], 2);
+                p += 8;
+                break;
+            default:
+                if (end - p < 16)
+                    return false;
+                std::memcpy(group, p, 16);
+                p += 16;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> EncodeVertexStream(const void* elements, size_t count, size_t element_size, int thread_count)
+{
+    const char* data = static_cast<const char*>(elements);
+    size_t word_count = element_size / sizeof(uint32_t);
+    size_t block_count = (count + vertex_block_size - 1) / vertex_block_size;
+    return EncodeBlocks(block_count, thread_count, [&](size_t b, std::vector<uint8_t>& out) {
+        size_t begin = b * vertex_block_size, n = std::min(count, begin + vertex_block_size) - begin;
+        std::vector<uint32_t> codes(n);
+        std::vector<uint8_t> planes[2];
+        // Per channel, the mode byte and the planes of its codes. The first element is coded against 0.
+        for (size_t c = 0; c < word_count; ++c) {
+            for (EChannelMode mode : { CM_Delta, CM_Xor }) {
+                uint32_t previous = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    uint32_t word;
+                    std::memcpy(&word, data + (begin + i) * element_size + c * sizeof(uint32_t), sizeof(word));
+                    codes[i] = ChannelCode(mode, word, previous);
+                    previous = word;
+                }
+                planes[mode].clear();
+                EncodeBytePlanes(codes.data(), n, planes[mode]);
+            }
+            EChannelMode mode = planes[CM_Xor].size() < planes[CM_Delta].size() ? CM_Xor : CM_Delta;
+            out.push_back(mode);
+            out.insert(out.end(), planes[mode].begin(), planes[mode].end());
+        }
+    });
+}
+
+bool DecodeVertexStream(const uint8_t* data, size_t size, void* elements, size_t count, size_t element_size, int thread_count)
+{
+    size_t word_count = element_size / sizeof(uint32_t);
+    size_t block_count = (count + vertex_block_size - 1) / vertex_block_size;
+    return DecodeBlocks(data, size, block_count, thread_count, [&](size_t b, const uint8_t* p, const uint8_t* end) {
+        size_t begin = b * vertex_block_size, n = std::min(count, begin + vertex_block_size) - begin;
+        size_t padded = (n + 15) / 16 * 16;
+        std::vector<uint8_t> planes(padded * 4);
+        const uint8_t *b0 = planes.data(), *b1 = b0 + padded, *b2 = b1 + padded, *b3 = b2 + padded;
+        for (size_t c = 0; c < word_count; ++c) {
+            if (p == end || *p > CM_Xor)
+                return false;
+            EChannelMode mode = static_cast<EChannelMode>(*p++);
+            if (!DecodeBytePlanes(p, end, planes.data(), n))
+                return false;
+            uint32_t previous = 0;
+            char* out = static_cast<char*>(elements) + begin * element_size + c * sizeof(uint32_t);
+            // Separate loops, so that the mode isn't tested per word.
+            if (mode == CM_Xor) {
+                for (size_t i = 0; i < n; ++i) {
+                    previous = ChannelWord(CM_Xor, b0[i] | b1[i] << 8 | b2[i] << 16 | uint32_t(b3[i]) << 24, previous);
+                    std::memcpy(out + i * element_size, &previous, sizeof(previous));
+                }
+            } else {
+                for (size_t i = 0; i < n; ++i) {
+                    previous = ChannelWord(CM_Delta, b0[i] | b1[i] << 8 | b2[i] << 16 | uint32_t(b3[i]) << 24, previous);
+                    std::memcpy(out + i * element_size, &previous, sizeof(previous));
+                }
+            }
+        }
+        return p == end;
+    });
+}
+
+// FIFOs of the recent edges and vertexes of an index stream, and the next new vertex and the last explicit one.
+// Index 0 of a FIFO is its most recent entry.
+struct IndexCodecState {
+    uint32_t edges[16][2] = {};
+    uint32_t vertexes[16] = {};
+    size_t edge_offset = 0, vertex_offset = 0;
+    uint32_t next = 0, last = 0;
+
+    const uint32_t* Edge(int k) const
+    {
+        return edges[(edge_offset - 1 - k) & 15];
+    }
+    uint32_t Vertex(int k) const
+    {
+        return vertexes[(vertex_offset - 1 - k) & 15];
+    }
+    void PushEdge(uint32_t a, uint32_t b)
+    {
+        edges[edge_offset & 15][0] = a;
+        edges[edge_offset & 15][1] = b;
+        ++edge_offset;
+    }
+    void PushVertex(uint32_t v)
+    {
+        vertexes[vertex_offset++ & 15] = v;
+    }
+};
+
+// Triangle codes, one byte per triangle:
+//     edge << 4 | rotation << 2 | kind of the third vertex, for `edge < edge_fifo_size`
+//     no_edge_code | kinds of the 3 vertexes, 2 bits each, else
+// followed by the data of their vertexes in the data section of the block.
+const int edge_fifo_size = 12;
+const uint8_t no_edge_code = edge_fifo_size << 4;
+
+// Vertex kinds and their data.
+enum EVertexKind {
+    // None, the next new vertex.
+    VK_Next = 0,
+    // A byte of the index in the vertex FIFO.
+    VK_Fifo = 1,
+    // A zigzag varint of the delta from the last explicit vertex.
+    VK_Explicit = 2,
+    // A varint of the distance back from the next new vertex, for vertexes seen recently but not in the FIFO.
+    // Doesn't move the last explicit vertex.
+    VK_Back = 3,
+};
+
+static void WriteVarint(uint64_t value, std::vector<uint8_t>& data)
+{
+    for (; value >= 0x80; value >>= 7)
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t VarintSize(uint64_t value)
+{
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7)
+        ++size;
+    return size;
+}
+
+// Up to 5 bytes, enough for 32 bits and their zigzag sign.
+static bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0;; shift += 7) {
+        if (p == end || shift > 28)
+            return false;
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (byte < 0x80)
+            return true;
+    }
+}
+
+static EVertexKind EncodeVertex(IndexCodecState& state, uint32_t v, std::vector<uint8_t>& data)
+{
+    if (v == state.next) {
+        ++state.next;
+        state.PushVertex(v);
+        return VK_Next;
+    }
+    for (int k = 0; k < 16; ++k)
+        if (state.Vertex(k) == v) {
+            data.push_back(static_cast<uint8_t>(k));
+            return VK_Fifo;
+        }
+    int64_t delta = int64_t(v) - int64_t(state.last);
+    uint64_t explicit_code = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+    state.PushVertex(v);
+    if (v < state.next && VarintSize(state.next - 1 - v) < VarintSize(explicit_code)) {
+        WriteVarint(state.next - 1 - v, data);
+        return VK_Back;
+    }
+    WriteVarint(explicit_code, data);
+    state.last = v;
+    state.next = std::max(state.next, v + 1);
+    return VK_Explicit;
+}
+
+// Explicit and back vertexes, see `DecodeVertex()`.
+static bool DecodeVarintVertex(IndexCodecState& state, int kind, const uint8_t*& p, const uint8_t* end, uint32_t& v)
+{
+    uint64_t code;
+    if (!ReadVarint(p, end, code))
+        return false;
+    if (kind == VK_Explicit) {
+        int64_t value = int64_t(state.last) + (int64_t(code >> 1) ^ -int64_t(code & 1));
+        if (value < 0 || value > int64_t(UINT32_MAX))
+            return false;
+        v = state.last = static_cast<uint32_t>(value);
+        state.next = std::max(state.next, v + 1);
+    } else {
+        if (code >= state.next)
+            return false;
+        v = static_cast<uint32_t>(state.next - 1 - code);
+    }
+    state.PushVertex(v);
+    return true;
+}
+
+// Validating the decoded indexes is left to the caller. The common kinds are inline, the varints aren't.
+static inline bool DecodeVertex(IndexCodecState& state, int kind, const uint8_t*& p, const uint8_t* end, uint32_t& v)
+{
+    if (kind == VK_Next) {
+        v = state.next++;
+        state.PushVertex(v);
+        return true;
+    }
+    if (kind == VK_Fifo) {
+        if (p == end || *p >= 16)
+            return false;
+        v = state.Vertex(*p++);
+        return true;
+    }
+    return DecodeVarintVertex(state, kind, p, end, v);
+}
+
+std::vector<uint8_t> EncodeIndexStream(const uint32_t* indexes, size_t index_count, int thread_count)
+{
+    // Each block begins with the next new vertex after the previous blocks, i.e. after their largest index.
+    size_t triangle_count = index_count / 3;
+    size_t block_count = (triangle_count + index_block_size - 1) / index_block_size;
+    std::vector<uint32_t> block_nexts(block_count + 1, 0);
+    ParallelFor(block_count, thread_count <= 0 ? DefaultThreadCount() : thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t b = begin; b < end; ++b)
+            for (size_t i = b * index_block_size * 3; i < std::min(index_count, (b + 1) * index_block_size * 3); ++i)
+                block_nexts[b + 1] = std::max(block_nexts[b + 1], indexes[i] + 1);
+    });
+    for (size_t b = 0; b < block_count; ++b)
+        block_nexts[b + 1] = std::max(block_nexts[b + 1], block_nexts[b]);
+
+    return EncodeBlocks(block_count, thread_count, [&](size_t b, std::vector<uint8_t>& out) {
+        size_t begin = b * index_block_size, end = std::min(triangle_count, begin + index_block_size);
+        IndexCodecState state;
+        state.next = block_nexts[b];
+        // The next new vertex, then the triangle codes, then the vertex data.
+        out.resize(sizeof(uint32_t) + end - begin);
+        std::memcpy(out.data(), &state.next, sizeof(uint32_t));
+        std::vector<uint8_t> data;
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* v = indexes + t * 3;
+            // The edges in the FIFO are reversed, as the neighbors see them.
+            int edge = -1, rotation = 0;
+            for (int k = 0; k < edge_fifo_size && edge < 0; ++k)
+                for (int r = 0; r < 3; ++r)
+                    if (state.Edge(k)[0] == v[r] && state.Edge(k)[1] == v[(r + 1) % 3]) {
+                        edge = k;
+                        rotation = r;
+                        break;
+                    }
+
+            uint8_t& code = out[sizeof(uint32_t) + t - begin];
+            if (edge >= 0) {
+                uint32_t a = v[rotation], b = v[(rotation + 1) % 3], c = v[(rotation + 2) % 3];
+                code = static_cast<uint8_t>(edge << 4 | rotation << 2 | EncodeVertex(state, c, data));
+                state.PushEdge(c, b);
+                state.PushEdge(a, c);
+            } else {
+                code = no_edge_code;
+                for (int j = 0; j < 3; ++j)
+                    code |= static_cast<uint8_t>(EncodeVertex(state, v[j], data) << (j * 2));
+                state.PushEdge(v[1], v[0]);
+                state.PushEdge(v[2], v[1]);
+                state.PushEdge(v[0], v[2]);
+            }
+        }
+        out.insert(out.end(), data.begin(), data.end());
+    });
+}
+
+bool DecodeIndexStream(const uint8_t* data, size_t size, uint32_t* indexes, size_t index_count, size_t vertex_count, int thread_count)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count * 3 != index_count)
+        return false;
+    size_t block_count = (triangle_count + index_block_size - 1) / index_block_size;
+    return DecodeBlocks(data, size, block_count, thread_count, [&](size_t b, const uint8_t* p, const uint8_t* end) {
+        size_t begin = b * index_block_size, n = std::min(triangle_count, begin + index_block_size) - begin;
+        if (static_cast<size_t>(end - p) < sizeof(uint32_t) + n)
+            return false;
+        IndexCodecState state;
+        std::memcpy(&state.next, p, sizeof(uint32_t));
+        const uint8_t* codes = p + sizeof(uint32_t);
+        p = codes + n;
+        for (size_t t = 0; t < n; ++t) {
+            uint8_t code = codes[t];
+            uint32_t* v = indexes + (begin + t) * 3;
+            if (code < no_edge_code) {
+                int rotation = code >> 2 & 3;
+                if (rotation == 3)
+                    return false;
+                const int rotation_next[4] = { 1, 2, 0, 1 };
+                const uint32_t* edge = state.Edge(code >> 4);
+                uint32_t a = edge[0], b = edge[1], c;
+                if (!DecodeVertex(state, code & 3, p, end, c))
+                    return false;
+                v[rotation] = a;
+                v[rotation_next[rotation]] = b;
+                v[rotation_next[rotation + 1]] = c;
+                state.PushEdge(c, b);
+                state.PushEdge(a, c);
+            } else {
+                for (int j = 0; j < 3; ++j)
+                    if (!DecodeVertex(state, code >> (j * 2) & 3, p, end, v[j]))
+                        return false;
+                state.PushEdge(v[1], v[0]);
+                state.PushEdge(v[2], v[1]);
+                state.PushEdge(v[0], v[2]);
+            }
+            if (v[0] >= vertex_count || v[1] >= vertex_count || v[2] >= vertex_count)
+                return false;
+        }
+        return p == end;
+    });
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace subface {
+
+// Lossless codecs of vertex and index streams in the manner of meshoptimizer's, encoded and decoded in independent blocks on
+// `thread_count` threads, 0 for all the hardware threads. Both streams begin with the end offsets of their blocks as `uint64_t`s.
+//
+// Vertex streams are arrays of elements of `element_size` bytes, a multiple of 4, taken as 32-bit words, e.g. floats. Each word of
+// an element is delta or XOR coded against the same word of the previous element, whichever is smaller in the block. The 4 byte
+// planes of the codes are then packed in groups of 16 bytes of 0, 2, 4 or 8 bits, so bytes that rarely change cost almost nothing.
+//
+// Index streams are triangle lists, kept in order with their corners in order. A triangle sharing one of the last 12 edges costs a
+// byte for the edge's place in a FIFO, the rotation of the triangle and how its third vertex is coded, plus the data of the vertex.
+// A vertex is the next one never referenced before, one of the last 16 vertexes, a delta from the last explicit one, or a distance
+// back from the next one. Meshes in vertex cache order, e.g. by `Subface::OptimizeVertexOrder()`, take under 2 bytes per triangle.
+std::vector<uint8_t> EncodeVertexStream(const void* elements, size_t count, size_t element_size, int thread_count = 0);
+// Returns false if `data` isn't a stream of `count` elements of `element_size` bytes.
+bool DecodeVertexStream(const uint8_t* data, size_t size, void* elements, size_t count, size_t element_size, int thread_count = 0);
+
+std::vector<uint8_t> EncodeIndexStream(const uint32_t* indexes, size_t index_count, int thread_count = 0);
+// Returns false if `data` isn't a stream of `index_count` indexes or an index isn't below `vertex_count`.
+bool DecodeIndexStream(const uint8_t* data, size_t size, uint32_t* indexes, size_t index_count, size_t vertex_count, int thread_count = 0);
+
+}
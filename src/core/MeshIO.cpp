@@ -0,0 +1,1074 @@
+#include "MeshIO.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+#include "MappedFile.hpp"
+#include "MeshCodec.hpp"
+#include "Parallel.hpp"
+#include "Timer.hpp"
+
+namespace subface {
+
+static_assert(sizeof(BinaryMeshHeader) == 64, "The binary mesh header must have no padding.");
+static_assert(sizeof(CompressedMeshHeader) == 64, "The compressed mesh header must have no padding.");
+
+MeshView MeshData::View() const
+{
+    MeshView view;
+    view.positions = positions.data();
+    view.position_count = positions.size();
+    view.indexes = indexes.data();
+    view.index_count = indexes.size();
+    view.normals = normals.empty() ? nullptr : normals.data();
+    view.uvs = uvs.empty() ? nullptr : uvs.data();
+    return view;
+}
+
+// A line-aligned range of an OBJ file, parsed by one thread.
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    // Elements in the chunk, counted by the first pass.
+    size_t position_count = 0, normal_count = 0, uv_count = 0, index_count = 0;
+    // Elements before the chunk, i.e. where the second pass writes its elements.
+    size_t position_offset = 0, normal_offset = 0, uv_offset = 0, index_offset = 0;
+    bool invalid = false;
+};
+
+static const char* SkipSpaces(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return p;
+}
+
+static const char* SkipToken(const char* p, const char* end)
+{
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        ++p;
+    return p;
+}
+
+static const char* LineEnd(const char* p, const char* end)
+{
+    const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return line_end ? line_end : end;
+}
+
+// `std::from_chars()` doesn't take a leading '+'. Leaves `value` unchanged if there is no number.
+template <typename T>
+static const char* ParseNumber(const char* p, const char* end, T& value)
+{
+    p = SkipSpaces(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    return std::from_chars(p, end, value).ptr;
+}
+
+// Kinds of the OBJ lines the reader uses.
+enum EObjLine {
+    OL_Other,
+    OL_Position,
+    OL_Normal,
+    OL_Uv,
+    OL_Face,
+};
+
+// Advances `p` past the keyword.
+static EObjLine ObjLineKind(const char*& p, const char* end)
+{
+    auto keyword = [&](const char* k, size_t n) {
+        if (static_cast<size_t>(end - p) > n && std::memcmp(p, k, n) == 0 && (p[n] == ' ' || p[n] == '\t')) {
+            p += n;
+            return true;
+        }
+        return false;
+    };
+    if (keyword("v", 1))
+        return OL_Position;
+    if (keyword("vn", 2))
+        return OL_Normal;
+    if (keyword("vt", 2))
+        return OL_Uv;
+    if (keyword("f", 1))
+        return OL_Face;
+    return OL_Other;
+}
+
+// 0-based index of the OBJ index `i` in an array of `count` elements, of which `defined` precede the face. -1 if invalid.
+static int64_t ResolveObjIndex(int64_t i, size_t defined, size_t count)
+{
+    int64_t index = i > 0 ? i - 1 : static_cast<int64_t>(defined) + i;
+    return i != 0 && 0 <= index && index < static_cast<int64_t>(count) ? index : -1;
+}
+
+static void CountObjChunk(ObjChunk& chunk)
+{
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* line_end = LineEnd(p, chunk.end);
+        p = SkipSpaces(p, line_end);
+        switch (ObjLineKind(p, line_end)) {
+        case OL_Position:
+            ++chunk.position_count;
+            break;
+        case OL_Normal:
+            ++chunk.normal_count;
+            break;
+        case OL_Uv:
+            ++chunk.uv_count;
+            break;
+        case OL_Face: {
+            size_t corner_count = 0;
+            for (p = SkipSpaces(p, line_end); p < line_end && *p != '\r' && *p != '#'; p = SkipSpaces(SkipToken(p, line_end), line_end))
+                ++corner_count;
+            // Polygons are triangulated as fans.
+            if (corner_count >= 3)
+                chunk.index_count += (corner_count - 2) * 3;
+            break;
+        }
+        default:
+            break;
+        }
+        p = line_end + 1;
+    }
+}
+
+// `corner_normals` and `corner_uvs` get the 0-based attribute index of each corner, -1 for none. They are empty if the file has no such
+// attributes or they aren't read, in which case `normals` and `uvs` are empty too and their statements are only counted.
+static void ParseObjChunk(ObjChunk& chunk, const ObjChunk& total, MeshData& mesh, std::vector<glm::vec3>& normals,
+    std::vector<glm::vec2>& uvs, std::vector<int32_t>& corner_normals, std::vector<int32_t>& corner_uvs)
+{
+    size_t position = chunk.position_offset, normal = chunk.normal_offset, uv = chunk.uv_offset, index = chunk.index_offset;
+    for (const char* p = chunk.begin; p < chunk.end;) {
+        const char* line_end = LineEnd(p, chunk.end);
+        p = SkipSpaces(p, line_end);
+        switch (ObjLineKind(p, line_end)) {
+        case OL_Position: {
+            glm::vec3& v = mesh.positions[position++];
+            v = glm::vec3(0.f);
+            ParseNumber(ParseNumber(ParseNumber(p, line_end, v.x), line_end, v.y), line_end, v.z);
+            break;
+        }
+        case OL_Normal: {
+            // Counted anyway for the relative indexes of the faces.
+            if (normals.empty()) {
+                ++normal;
+                break;
+            }
+            glm::vec3& n = normals[normal++];
+            n = glm::vec3(0.f);
+            ParseNumber(ParseNumber(ParseNumber(p, line_end, n.x), line_end, n.y), line_end, n.z);
+            break;
+        }
+        case OL_Uv: {
+            if (uvs.empty()) {
+                ++uv;
+                break;
+            }
+            glm::vec2& t = uvs[uv++];
+            t = glm::vec2(0.f);
+            ParseNumber(ParseNumber(p, line_end, t.x), line_end, t.y);
+            break;
+        }
+        case OL_Face: {
+            // Fan of the corners: (first, previous, current).
+            int64_t corners[3][3];
+            size_t corner_count = 0;
+            for (p = SkipSpaces(p, line_end); p < line_end && *p != '\r' && *p != '#'; p = SkipSpaces(SkipToken(p, line_end), line_end)) {
+                // v, v/vt, v//vn or v/vt/vn.
+                int64_t v = 0, vt = 0, vn = 0;
+                const char* q = ParseNumber(p, line_end, v);
+                if (q < line_end && *q == '/') {
+                    ++q;
+                    if (q < line_end && *q != '/')
+                        q = ParseNumber(q, line_end, vt);
+                    if (q < line_end && *q == '/')
+                        ParseNumber(q + 1, line_end, vn);
+                }
+                int64_t* corner = corners[std::min(corner_count, size_t(2))];
+                corner[0] = ResolveObjIndex(v, position, total.position_count);
+                corner[1] = vt ? ResolveObjIndex(vt, uv, total.uv_count) : -1;
+                corner[2] = vn ? ResolveObjIndex(vn, normal, total.normal_count) : -1;
+                if (corner[0] == -1 || (vt && corner[1] == -1) || (vn && corner[2] == -1))
+                    chunk.invalid = true;
+                if (++corner_count < 3)
+                    continue;
+
+                for (int j = 0; j < 3; ++j, ++index) {
+                    mesh.indexes[index] = static_cast<uint32_t>(std::max(corners[j][0], int64_t(0)));
+                    if (!corner_uvs.empty())
+                        corner_uvs[index] = static_cast<int32_t>(corners[j][1]);
+                    if (!corner_normals.empty())
+                        corner_normals[index] = static_cast<int32_t>(corners[j][2]);
+                }
+                std::copy(corners[2], corners[2] + 3, corners[1]);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        p = line_end + 1;
+    }
+}
+
+bool LoadObj(const std::string& file_name, MeshData& mesh, int thread_count, ELoadProfile profile)
+{
+    std::string func_name = fmt::format("LoadObj({})", file_name);
+    Timer timer(func_name);
+
+    mesh = MeshData();
+    MappedFile file(file_name);
+    if (!file.valid()) {
+        spdlog::error("{}: Cannot open the file!", func_name);
+        return false;
+    }
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+    const char* file_end = file.data() + file.size();
+
+    // Line-aligned chunks of similar sizes, 1 per thread. Small files aren't worth splitting.
+    const size_t min_chunk_size = 1 << 20;
+    size_t chunk_count = std::max(size_t(1), std::min(static_cast<size_t>(thread_count), file.size() / min_chunk_size));
+    std::vector<ObjChunk> chunks(chunk_count);
+    const char* chunk_begin = file.data();
+    for (size_t c = 0; c < chunk_count; ++c) {
+        const char* chunk_end = c + 1 == chunk_count ? file_end : file.data() + file.size() * (c + 1) / chunk_count;
+        if (chunk_end < chunk_begin)
+            chunk_end = chunk_begin;
+        if (chunk_end != file_end)
+            chunk_end = std::min(LineEnd(chunk_end, file_end) + 1, file_end);
+        chunks[c].begin = chunk_begin;
+        chunks[c].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    // Count the elements of each chunk, so that the chunks can be parsed straight into their places.
+    ParallelFor(chunk_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t c = begin; c < end; ++c)
+            CountObjChunk(chunks[c]);
+    });
+    ObjChunk total;
+    for (ObjChunk& chunk : chunks) {
+        chunk.position_offset = total.position_count;
+        chunk.normal_offset = total.normal_count;
+        chunk.uv_offset = total.uv_count;
+        chunk.index_offset = total.index_count;
+        total.position_count += chunk.position_count;
+        total.normal_count += chunk.normal_count;
+        total.uv_count += chunk.uv_count;
+        total.index_count += chunk.index_count;
+    }
+
+    mesh.positions.resize(total.position_count);
+    mesh.indexes.resize(total.index_count);
+    std::vector<glm::vec3> normals(profile == LP_Full ? total.normal_count : 0);
+    std::vector<glm::vec2> uvs(profile == LP_Full ? total.uv_count : 0);
+    std::vector<int32_t> corner_normals(normals.empty() ? 0 : total.index_count);
+    std::vector<int32_t> corner_uvs(uvs.empty() ? 0 : total.index_count);
+    ParallelFor(chunk_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t c = begin; c < end; ++c)
+            ParseObjChunk(chunks[c], total, mesh, normals, uvs, corner_normals, corner_uvs);
+    });
+    for (const ObjChunk& chunk : chunks)
+        if (chunk.invalid) {
+            spdlog::error("{}: A face refers to a missing element!", func_name);
+            mesh = MeshData();
+            return false;
+        }
+
+    // Per-corner attributes. Corners without one are zero.
+    mesh.normals.resize(corner_normals.size());
+    mesh.uvs.resize(corner_uvs.size());
+    ParallelFor(total.index_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!corner_normals.empty())
+                mesh.normals[i] = corner_normals[i] >= 0 ? normals[corner_normals[i]] : glm::vec3(0.f);
+            if (!corner_uvs.empty())
+                mesh.uvs[i] = corner_uvs[i] >= 0 ? uvs[corner_uvs[i]] : glm::vec2(0.f);
+        }
+    });
+
+    spdlog::info("{}: {} triangles, {} vertexes, {} threads", func_name, mesh.FaceCount(), mesh.positions.size(), chunk_count);
+    return true;
+}
+
+enum EPlyType {
+    PT_Invalid,
+    PT_Int8,
+    PT_Uint8,
+    PT_Int16,
+    PT_Uint16,
+    PT_Int32,
+    PT_Uint32,
+    PT_Float32,
+    PT_Float64,
+};
+
+static EPlyType PlyType(const std::string& name)
+{
+    static const std::unordered_map<std::string, EPlyType> types = {
+        { "char", PT_Int8 }, { "int8", PT_Int8 }, { "uchar", PT_Uint8 }, { "uint8", PT_Uint8 },
+        { "short", PT_Int16 }, { "int16", PT_Int16 }, { "ushort", PT_Uint16 }, { "uint16", PT_Uint16 },
+        { "int", PT_Int32 }, { "int32", PT_Int32 }, { "uint", PT_Uint32 }, { "uint32", PT_Uint32 },
+        { "float", PT_Float32 }, { "float32", PT_Float32 }, { "double", PT_Float64 }, { "float64", PT_Float64 },
+    };
+    auto it = types.find(name);
+    return it == types.end() ? PT_Invalid : it->second;
+}
+
+static size_t PlyTypeSize(EPlyType type)
+{
+    static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[type];
+}
+
+template <typename T>
+static T ReadPlyValue(const char* p, EPlyType type)
+{
+    auto read = [p](auto value) {
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<T>(value);
+    };
+    switch (type) {
+    case PT_Int8:
+        return read(int8_t());
+    case PT_Uint8:
+        return read(uint8_t());
+    case PT_Int16:
+        return read(int16_t());
+    case PT_Uint16:
+        return read(uint16_t());
+    case PT_Int32:
+        return read(int32_t());
+    case PT_Uint32:
+        return read(uint32_t());
+    case PT_Float32:
+        return read(float());
+    case PT_Float64:
+        return read(double());
+    default:
+        return T();
+    }
+}
+
+struct PlyProperty {
+    std::string name;
+    EPlyType type = PT_Invalid;
+    // `PT_Invalid` unless the property is a list.
+    EPlyType count_type = PT_Invalid;
+    // Offset in the element if the element has a fixed size.
+    size_t offset = 0;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+    // 0 if the element has lists.
+    size_t size = 0;
+
+    const PlyProperty* Find(std::initializer_list<const char*> names) const
+    {
+        for (const char* name : names)
+            for (const PlyProperty& property : properties)
+                if (property.name == name)
+                    return &property;
+        return nullptr;
+    }
+};
+
+// Size of the element at `p`, or 0 if it runs past `end`.
+static size_t PlyElementSize(const PlyElement& element, const char* p, const char* end)
+{
+    // Every advance is checked, so that `p` never leaves the mapping.
+    const char* begin = p;
+    for (const PlyProperty& property : element.properties) {
+        if (property.count_type == PT_Invalid) {
+            if (static_cast<size_t>(end - p) < PlyTypeSize(property.type))
+                return 0;
+            p += PlyTypeSize(property.type);
+            continue;
+        }
+        if (static_cast<size_t>(end - p) < PlyTypeSize(property.count_type))
+            return 0;
+        size_t count = ReadPlyValue<size_t>(p, property.count_type);
+        p += PlyTypeSize(property.count_type);
+        if (count > static_cast<size_t>(end - p) / PlyTypeSize(property.type))
+            return 0;
+        p += count * PlyTypeSize(property.type);
+    }
+    return p - begin;
+}
+
+bool LoadPly(const std::string& file_name, MeshData& mesh, int thread_count, ELoadProfile profile)
+{
+    std::string func_name = fmt::format("LoadPly({})", file_name);
+    Timer timer(func_name);
+
+    mesh = MeshData();
+    MappedFile file(file_name);
+    if (!file.valid()) {
+        spdlog::error("{}: Cannot open the file!", func_name);
+        return false;
+    }
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+    const char* file_end = file.data() + file.size();
+
+    // The header is text, up to the line "end_header".
+    const char* header_end = nullptr;
+    for (const char* p = file.data(); p < file_end && !header_end;) {
+        const char* line_end = LineEnd(p, file_end);
+        if (line_end - p >= 10 && std::memcmp(p, "end_header", 10) == 0)
+            header_end = std::min(line_end + 1, file_end);
+        p = line_end + 1;
+    }
+    if (file.size() < 3 || std::memcmp(file.data(), "ply", 3) != 0 || !header_end) {
+        spdlog::error("{}: Not a PLY file!", func_name);
+        return false;
+    }
+    std::istringstream header(std::string(file.data(), header_end));
+    std::vector<PlyElement> elements;
+    std::string line, format;
+    while (std::getline(header, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            words >> format;
+        } else if (keyword == "element") {
+            elements.emplace_back();
+            words >> elements.back().name >> elements.back().count;
+        } else if (keyword == "property" && !elements.empty()) {
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            if (type == "list") {
+                std::string count_type;
+                words >> count_type >> type;
+                property.count_type = PlyType(count_type);
+                if (property.count_type == PT_Invalid)
+                    type.clear();
+            }
+            property.type = PlyType(type);
+            words >> property.name;
+            if (property.type == PT_Invalid) {
+                spdlog::error("{}: Unknown property type in \"{}\"!", func_name, line);
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+    if (format != "binary_little_endian") {
+        spdlog::error("{}: Only binary little-endian PLY is supported, not {}!", func_name, format);
+        return false;
+    }
+    for (PlyElement& element : elements) {
+        size_t size = 0;
+        for (PlyProperty& property : element.properties) {
+            property.offset = size;
+            size += PlyTypeSize(property.type);
+        }
+        bool fixed = std::none_of(element.properties.begin(), element.properties.end(), [](const PlyProperty& property) {
+            return property.count_type != PT_Invalid;
+        });
+        element.size = fixed ? size : 0;
+    }
+
+    std::vector<glm::vec3> vertex_normals;
+    std::vector<glm::vec2> vertex_uvs;
+    bool truncated = false, invalid = false;
+    const char* p = header_end;
+    for (const PlyElement& element : elements) {
+        if (element.name == "vertex") {
+            const PlyProperty* x = element.Find({ "x" });
+            const PlyProperty* y = element.Find({ "y" });
+            const PlyProperty* z = element.Find({ "z" });
+            const PlyProperty* nx = element.Find({ "nx" });
+            const PlyProperty* ny = element.Find({ "ny" });
+            const PlyProperty* nz = element.Find({ "nz" });
+            const PlyProperty* u = element.Find({ "u", "s", "texture_u", "texture_s" });
+            const PlyProperty* v = element.Find({ "v", "t", "texture_v", "texture_t" });
+            if (!element.size || !x || !y || !z) {
+                spdlog::error("{}: Vertexes must have fixed sizes and positions!", func_name);
+                return false;
+            }
+            if (element.count > static_cast<size_t>(file_end - p) / element.size) {
+                truncated = true;
+                break;
+            }
+            mesh.positions.resize(element.count);
+            if (nx && ny && nz && profile == LP_Full)
+                vertex_normals.resize(element.count);
+            if (u && v && profile == LP_Full)
+                vertex_uvs.resize(element.count);
+            ParallelFor(element.count, thread_count, [&](size_t begin, size_t end, int) {
+                for (size_t i = begin; i < end; ++i) {
+                    const char* q = p + i * element.size;
+                    mesh.positions[i] = glm::vec3(ReadPlyValue<float>(q + x->offset, x->type), ReadPlyValue<float>(q + y->offset, y->type), ReadPlyValue<float>(q + z->offset, z->type));
+                    if (!vertex_normals.empty())
+                        vertex_normals[i] = glm::vec3(ReadPlyValue<float>(q + nx->offset, nx->type), ReadPlyValue<float>(q + ny->offset, ny->type), ReadPlyValue<float>(q + nz->offset, nz->type));
+                    if (!vertex_uvs.empty())
+                        vertex_uvs[i] = glm::vec2(ReadPlyValue<float>(q + u->offset, u->type), ReadPlyValue<float>(q + v->offset, v->type));
+                }
+            });
+            p += element.count * element.size;
+        } else if (element.name == "face") {
+            const PlyProperty* list = element.Find({ "vertex_indices", "vertex_index" });
+            if (!list || list->count_type == PT_Invalid) {
+                spdlog::error("{}: Faces must have a list of vertex indexes!", func_name);
+                return false;
+            }
+            size_t vertex_count = mesh.positions.size();
+            size_t count_size = PlyTypeSize(list->count_type), index_size = PlyTypeSize(list->type);
+            // Faces of only triangles have a fixed size, so they can be read in parallel after checking the counts.
+            size_t triangle_size = count_size + 3 * index_size;
+            bool triangles = element.properties.size() == 1 && element.count <= static_cast<size_t>(file_end - p) / triangle_size;
+            if (triangles) {
+                std::vector<uint8_t> thread_triangles(thread_count, 1);
+                ParallelFor(element.count, thread_count, [&](size_t begin, size_t end, int tid) {
+                    for (size_t f = begin; f < end; ++f)
+                        if (ReadPlyValue<size_t>(p + f * triangle_size, list->count_type) != 3)
+                            thread_triangles[tid] = 0;
+                });
+                triangles = std::find(thread_triangles.begin(), thread_triangles.end(), 0) == thread_triangles.end();
+            }
+            if (triangles) {
+                mesh.indexes.resize(element.count * 3);
+                std::vector<uint8_t> thread_invalid(thread_count, 0);
+                ParallelFor(element.count, thread_count, [&](size_t begin, size_t end, int tid) {
+                    for (size_t f = begin; f < end; ++f)
+                        for (size_t j = 0; j < 3; ++j) {
+                            int64_t index = ReadPlyValue<int64_t>(p + f * triangle_size + count_size + j * index_size, list->type);
+                            if (index < 0 || index >= static_cast<int64_t>(vertex_count))
+                                thread_invalid[tid] = 1;
+                            mesh.indexes[f * 3 + j] = static_cast<uint32_t>(index);
+                        }
+                });
+                invalid |= std::find(thread_invalid.begin(), thread_invalid.end(), 1) != thread_invalid.end();
+                p += element.count * triangle_size;
+                continue;
+            }
+            mesh.indexes.reserve(element.count * 3);
+            for (size_t f = 0; f < element.count && !truncated; ++f) {
+                size_t size = PlyElementSize(element, p, file_end);
+                if (!size) {
+                    truncated = true;
+                    break;
+                }
+                // Offset of the list, as the properties before it may be lists too.
+                const char* q = p;
+                for (const PlyProperty& property : element.properties) {
+                    if (&property == list)
+                        break;
+                    q += property.count_type == PT_Invalid ? PlyTypeSize(property.type)
+                                                           : PlyTypeSize(property.count_type) + ReadPlyValue<size_t>(q, property.count_type) * PlyTypeSize(property.type);
+                }
+                size_t corner_count = ReadPlyValue<size_t>(q, list->count_type);
+                q += count_size;
+                // Fan of the corners: (first, previous, current).
+                for (size_t j = 2; j < corner_count; ++j)
+                    for (size_t k : { size_t(0), j - 1, j }) {
+                        int64_t index = ReadPlyValue<int64_t>(q + k * index_size, list->type);
+                        if (index < 0 || index >= static_cast<int64_t>(vertex_count))
+                            invalid = true;
+                        mesh.indexes.push_back(static_cast<uint32_t>(index));
+                    }
+                p += size;
+            }
+        } else {
+            // Skip the other elements.
+            if (element.size) {
+                if (element.count > static_cast<size_t>(file_end - p) / element.size) {
+                    truncated = true;
+                    break;
+                }
+                p += element.count * element.size;
+            } else {
+                for (size_t i = 0; i < element.count && !truncated; ++i) {
+                    size_t size = PlyElementSize(element, p, file_end);
+                    truncated = !size;
+                    p += size;
+                }
+            }
+        }
+        if (truncated)
+            break;
+    }
+    if (truncated || invalid) {
+        spdlog::error("{}: {}!", func_name, truncated ? "The file is truncated" : "A face refers to a missing vertex");
+        mesh = MeshData();
+        return false;
+    }
+
+    // Per-corner attributes from the vertexes.
+    mesh.normals.resize(vertex_normals.empty() ? 0 : mesh.indexes.size());
+    mesh.uvs.resize(vertex_uvs.empty() ? 0 : mesh.indexes.size());
+    ParallelFor(mesh.indexes.size(), thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!vertex_normals.empty())
+                mesh.normals[i] = vertex_normals[mesh.indexes[i]];
+            if (!vertex_uvs.empty())
+                mesh.uvs[i] = vertex_uvs[mesh.indexes[i]];
+        }
+    });
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, mesh.FaceCount(), mesh.positions.size());
+    return true;
+}
+
+bool LoadStl(const std::string& file_name, MeshData& mesh, int thread_count)
+{
+    std::string func_name = fmt::format("LoadStl({})", file_name);
+    Timer timer(func_name);
+
+    mesh = MeshData();
+    MappedFile file(file_name);
+    if (!file.valid()) {
+        spdlog::error("{}: Cannot open the file!", func_name);
+        return false;
+    }
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+
+    // An 80-byte header, the triangle count, then per triangle: the normal, 3 corners and a 2-byte attribute.
+    const size_t header_size = 84, triangle_size = 50;
+    uint32_t triangle_count = 0;
+    if (file.size() >= header_size)
+        std::memcpy(&triangle_count, file.data() + 80, sizeof(triangle_count));
+    if (file.size() < header_size || file.size() != header_size + triangle_size * static_cast<uint64_t>(triangle_count)) {
+        spdlog::error("{}: Not a binary STL file!", func_name);
+        return false;
+    }
+
+    std::vector<glm::vec3> corners(triangle_count * size_t(3));
+    ParallelFor(triangle_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t f = begin; f < end; ++f)
+            std::memcpy(&corners[f * 3], file.data() + header_size + f * triangle_size + sizeof(glm::vec3), 3 * sizeof(glm::vec3));
+    });
+
+    // Weld the corners at the same position, in the order of their first use. -0 and 0 are the same position.
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> position2index;
+    position2index.reserve(corners.size() / 2);
+    mesh.indexes.resize(corners.size());
+    for (size_t i = 0; i < corners.size(); ++i) {
+        glm::vec3 position = corners[i] + glm::vec3(0.f);
+        auto it = position2index.emplace(position, static_cast<uint32_t>(mesh.positions.size())).first;
+        if (it->second == mesh.positions.size())
+            mesh.positions.push_back(position);
+        mesh.indexes[i] = it->second;
+    }
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, mesh.FaceCount(), mesh.positions.size());
+    return true;
+}
+
+bool LoadMesh(const std::string& file_name, MeshData& mesh, int thread_count, ELoadProfile profile)
+{
+    auto has_extension = [&](const char* extension) {
+        size_t n = std::strlen(extension);
+        if (file_name.size() < n)
+            return false;
+        for (size_t i = 0; i < n; ++i)
+            if (std::tolower(static_cast<unsigned char>(file_name[file_name.size() - n + i])) != extension[i])
+                return false;
+        return true;
+    };
+    if (has_extension(".ply"))
+        return LoadPly(file_name, mesh, thread_count, profile);
+    if (has_extension(".stl"))
+        return LoadStl(file_name, mesh, thread_count);
+    if (has_extension(".sfz"))
+        return LoadCompressedMesh(file_name, mesh, thread_count, profile);
+    return LoadObj(file_name, mesh, thread_count, profile);
+}
+
+bool SaveBinaryMesh(const std::string& file_name, const MeshView& mesh)
+{
+    std::string func_name = fmt::format("SaveBinaryMesh({})", file_name);
+    Timer timer(func_name);
+
+    BinaryMeshHeader header {};
+    std::memcpy(header.magic, BinaryMeshHeader::magic_value, sizeof(header.magic));
+    header.version = BinaryMeshHeader::current_version;
+    header.flags = (mesh.normals ? uint32_t(BinaryMeshHeader::HasNormals) : 0u) | (mesh.uvs ? uint32_t(BinaryMeshHeader::HasUvs) : 0u);
+    header.position_count = mesh.position_count;
+    header.index_count = mesh.index_count;
+
+    struct Section {
+        const void* data;
+        uint64_t size;
+    };
+    Section sections[4] = {
+        { mesh.positions, mesh.position_count * sizeof(glm::vec3) },
+        { mesh.indexes, mesh.index_count * sizeof(uint32_t) },
+        { mesh.normals, mesh.normals ? mesh.index_count * sizeof(glm::vec3) : 0 },
+        { mesh.uvs, mesh.uvs ? mesh.index_count * sizeof(glm::vec2) : 0 },
+    };
+    uint64_t* offsets[4] = { &header.positions_offset, &header.indexes_offset, &header.normals_offset, &header.uvs_offset };
+    uint64_t offset = sizeof(header);
+    for (int i = 0; i < 4; ++i)
+        if (sections[i].data) {
+            offset = (offset + BinaryMeshHeader::alignment - 1) / BinaryMeshHeader::alignment * BinaryMeshHeader::alignment;
+            *offsets[i] = offset;
+            offset += sections[i].size;
+        }
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[BinaryMeshHeader::alignment] = {};
+    offset = sizeof(header);
+    for (int i = 0; i < 4; ++i)
+        if (sections[i].data) {
+            ofs.write(padding, *offsets[i] - offset);
+            ofs.write(static_cast<const char*>(sections[i].data), sections[i].size);
+            offset = *offsets[i] + sections[i].size;
+        }
+    if (!ofs) {
+        spdlog::error("{}: Failed to write the file!", func_name);
+        return false;
+    }
+
+    spdlog::info("{}: {} triangles, {} vertexes, {} bytes", func_name, mesh.index_count / 3, mesh.position_count, offset);
+    return true;
+}
+
+BinaryMesh::BinaryMesh() = default;
+BinaryMesh::~BinaryMesh() = default;
+
+bool BinaryMesh::Load(const std::string& file_name, int thread_count)
+{
+    std::string func_name = fmt::format("BinaryMesh::Load({})", file_name);
+    Timer timer(func_name);
+
+    view_ = MeshView();
+    file_ = std::make_unique<MappedFile>(file_name);
+    if (!file_->valid()) {
+        spdlog::error("{}: Cannot open the file!", func_name);
+        return false;
+    }
+    BinaryMeshHeader header;
+    if (file_->size() < sizeof(header)) {
+        spdlog::error("{}: Not a binary mesh!", func_name);
+        return false;
+    }
+    std::memcpy(&header, file_->data(), sizeof(header));
+    if (std::memcmp(header.magic, BinaryMeshHeader::magic_value, sizeof(header.magic)) != 0) {
+        spdlog::error("{}: Not a binary mesh!", func_name);
+        return false;
+    }
+    if (header.version != BinaryMeshHeader::current_version) {
+        spdlog::error("{}: Version {} isn't supported, expecting version {}!", func_name, header.version, BinaryMeshHeader::current_version);
+        return false;
+    }
+
+    // Sections must be aligned and inside the file, so that the mapping can be used as the arrays.
+    uint64_t file_size = file_->size();
+    auto section = [&](uint64_t offset, uint64_t count, uint64_t element_size) -> const char* {
+        if (offset % BinaryMeshHeader::alignment != 0 || offset < sizeof(header) || offset > file_size || count > (file_size - offset) / element_size)
+            return nullptr;
+        return file_->data() + offset;
+    };
+    bool has_normals = header.flags & BinaryMeshHeader::HasNormals, has_uvs = header.flags & BinaryMeshHeader::HasUvs;
+    const char* positions = header.position_count ? section(header.positions_offset, header.position_count, sizeof(glm::vec3)) : file_->data();
+    const char* indexes = header.index_count ? section(header.indexes_offset, header.index_count, sizeof(uint32_t)) : file_->data();
+    const char* normals = has_normals ? section(header.normals_offset, header.index_count, sizeof(glm::vec3)) : nullptr;
+    const char* uvs = has_uvs ? section(header.uvs_offset, header.index_count, sizeof(glm::vec2)) : nullptr;
+    if (!positions || !indexes || (has_normals && !normals) || (has_uvs && !uvs) || header.index_count % 3 != 0) {
+        spdlog::error("{}: The file is truncated or corrupted!", func_name);
+        return false;
+    }
+
+    // Not parsing, but a bad index would crash the topology construction.
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+    const uint32_t* index_data = reinterpret_cast<const uint32_t*>(indexes);
+    std::vector<uint8_t> thread_invalid(thread_count, 0);
+    ParallelFor(header.index_count, thread_count, [&](size_t begin, size_t end, int tid) {
+        for (size_t i = begin; i < end; ++i)
+            if (index_data[i] >= header.position_count)
+                thread_invalid[tid] = 1;
+    });
+    if (std::find(thread_invalid.begin(), thread_invalid.end(), 1) != thread_invalid.end()) {
+        spdlog::error("{}: A face refers to a missing vertex!", func_name);
+        return false;
+    }
+
+    view_.positions = reinterpret_cast<const glm::vec3*>(positions);
+    view_.position_count = header.position_count;
+    view_.indexes = index_data;
+    view_.index_count = header.index_count;
+    view_.normals = reinterpret_cast<const glm::vec3*>(normals);
+    view_.uvs = reinterpret_cast<const glm::vec2*>(uvs);
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, view_.index_count / 3, view_.position_count);
+    return true;
+}
+
+bool SaveCompressedMesh(const std::string& file_name, const MeshView& mesh, int thread_count)
+{
+    std::string func_name = fmt::format("SaveCompressedMesh({})", file_name);
+    Timer timer(func_name);
+
+    CompressedMeshHeader header {};
+    std::memcpy(header.magic, CompressedMeshHeader::magic_value, sizeof(header.magic));
+    header.version = CompressedMeshHeader::current_version;
+    header.flags = (mesh.normals ? uint32_t(BinaryMeshHeader::HasNormals) : 0u) | (mesh.uvs ? uint32_t(BinaryMeshHeader::HasUvs) : 0u);
+    header.position_count = mesh.position_count;
+    header.index_count = mesh.index_count;
+
+    std::vector<uint8_t> sections[4] = {
+        EncodeVertexStream(mesh.positions, mesh.position_count, sizeof(glm::vec3), thread_count),
+        EncodeIndexStream(mesh.indexes, mesh.index_count, thread_count),
+        mesh.normals ? EncodeVertexStream(mesh.normals, mesh.index_count, sizeof(glm::vec3), thread_count) : std::vector<uint8_t>(),
+        mesh.uvs ? EncodeVertexStream(mesh.uvs, mesh.index_count, sizeof(glm::vec2), thread_count) : std::vector<uint8_t>(),
+    };
+    header.positions_size = sections[0].size();
+    header.indexes_size = sections[1].size();
+    header.normals_size = sections[2].size();
+    header.uvs_size = sections[3].size();
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t size = sizeof(header);
+    for (const std::vector<uint8_t>& section : sections) {
+        ofs.write(reinterpret_cast<const char*>(section.data()), section.size());
+        size += section.size();
+    }
+    if (!ofs) {
+        spdlog::error("{}: Failed to write the file!", func_name);
+        return false;
+    }
+
+    uint64_t raw_size = mesh.position_count * sizeof(glm::vec3) + mesh.index_count * sizeof(uint32_t)
+        + (mesh.normals ? mesh.index_count * sizeof(glm::vec3) : 0) + (mesh.uvs ? mesh.index_count * sizeof(glm::vec2) : 0);
+    spdlog::info("{}: {} triangles, {} vertexes, {} bytes, {:.2f}x smaller than the arrays", func_name, mesh.index_count / 3, mesh.position_count,
+        size, size ? double(raw_size) / size : 0.0);
+    return true;
+}
+
+bool LoadCompressedMesh(const std::string& file_name, MeshData& mesh, int thread_count, ELoadProfile profile)
+{
+    std::string func_name = fmt::format("LoadCompressedMesh({})", file_name);
+    Timer timer(func_name);
+
+    mesh = MeshData();
+    MappedFile file(file_name);
+    if (!file.valid()) {
+        spdlog::error("{}: Cannot open the file!", func_name);
+        return false;
+    }
+    CompressedMeshHeader header;
+    if (file.size() < sizeof(header)) {
+        spdlog::error("{}: Not a compressed mesh!", func_name);
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CompressedMeshHeader::magic_value, sizeof(header.magic)) != 0) {
+        spdlog::error("{}: Not a compressed mesh!", func_name);
+        return false;
+    }
+    if (header.version != CompressedMeshHeader::current_version) {
+        spdlog::error("{}: Version {} isn't supported, expecting version {}!", func_name, header.version, CompressedMeshHeader::current_version);
+        return false;
+    }
+
+    // The counts size the arrays before anything is decoded, so they must fit in the section sizes. The widths of the byte planes
+    // alone take a byte per 16 words of a vertex stream, and the triangle codes a byte per triangle.
+    uint64_t file_size = file.size() - sizeof(header);
+    bool has_normals = header.flags & BinaryMeshHeader::HasNormals, has_uvs = header.flags & BinaryMeshHeader::HasUvs;
+    uint64_t sizes[4] = { header.positions_size, header.indexes_size, header.normals_size, header.uvs_size };
+    bool valid = header.index_count % 3 == 0
+        && header.position_count / 16 * 3 <= sizes[0]
+        && header.index_count / 3 <= sizes[1]
+        && (has_normals ? header.index_count / 16 * 3 <= sizes[2] : sizes[2] == 0)
+        && (has_uvs ? header.index_count / 16 * 2 <= sizes[3] : sizes[3] == 0);
+    uint64_t total_size = 0;
+    for (uint64_t size : sizes) {
+        valid = valid && size <= file_size - total_size;
+        total_size += valid ? size : 0;
+    }
+    if (!valid) {
+        spdlog::error("{}: The file is truncated or corrupted!", func_name);
+        return false;
+    }
+
+    mesh.positions.resize(header.position_count);
+    mesh.indexes.resize(header.index_count);
+    // Sections that aren't read are skipped undecoded.
+    has_normals = has_normals && profile == LP_Full;
+    has_uvs = has_uvs && profile == LP_Full;
+    mesh.normals.resize(has_normals ? header.index_count : 0);
+    mesh.uvs.resize(has_uvs ? header.index_count : 0);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(file.data()) + sizeof(header);
+    valid = DecodeVertexStream(p, sizes[0], mesh.positions.data(), mesh.positions.size(), sizeof(glm::vec3), thread_count);
+    p += sizes[0];
+    valid = valid && DecodeIndexStream(p, sizes[1], mesh.indexes.data(), mesh.indexes.size(), mesh.positions.size(), thread_count);
+    p += sizes[1];
+    valid = valid && (!has_normals || DecodeVertexStream(p, sizes[2], mesh.normals.data(), mesh.normals.size(), sizeof(glm::vec3), thread_count));
+    p += sizes[2];
+    valid = valid && (!has_uvs || DecodeVertexStream(p, sizes[3], mesh.uvs.data(), mesh.uvs.size(), sizeof(glm::vec2), thread_count));
+    if (!valid) {
+        mesh = MeshData();
+        spdlog::error("{}: The file is truncated or corrupted!", func_name);
+        return false;
+    }
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, mesh.FaceCount(), mesh.positions.size());
+    return true;
+}
+
+int GlbBuilder::AddBufferView(size_t size, size_t stride)
+{
+    // Views begin at multiples of 4, which aligns the accessors of all the component types.
+    size_t offset = bin_.size();
+    bin_.resize(offset + (size + 3) / 4 * 4);
+    buffer_view_offsets_.push_back(offset);
+    buffer_views_.push_back(fmt::format("{{\"buffer\":0,\"byteOffset\":{},\"byteLength\":{},{}}}", offset, size,
+        stride ? fmt::format("\"byteStride\":{},\"target\":34962", stride) : std::string("\"target\":34963")));
+    return static_cast<int>(buffer_views_.size() - 1);
+}
+
+char* GlbBuilder::BufferViewData(int buffer_view)
+{
+    return bin_.data() + buffer_view_offsets_[buffer_view];
+}
+
+// JSON array of `values`, e.g. "[1,2.5,3]".
+static std::string JsonArray(const std::vector<double>& values)
+{
+    std::string json = "[";
+    for (size_t i = 0; i < values.size(); ++i)
+        json += fmt::format("{}{}", i ? "," : "", values[i]);
+    return json + "]";
+}
+
+int GlbBuilder::AddAccessor(int buffer_view, size_t offset, EGltfComponentType component_type, bool normalized, size_t count, const char* type,
+    const std::vector<double>& min, const std::vector<double>& max)
+{
+    std::string json = fmt::format("{{\"bufferView\":{},\"byteOffset\":{},\"componentType\":{},\"count\":{},\"type\":\"{}\"",
+        buffer_view, offset, static_cast<int>(component_type), count, type);
+    if (normalized)
+        json += ",\"normalized\":true";
+    if (!min.empty())
+        json += ",\"min\":" + JsonArray(min) + ",\"max\":" + JsonArray(max);
+    accessors_.push_back(json + "}");
+    return static_cast<int>(accessors_.size() - 1);
+}
+
+int GlbBuilder::AddMesh(const std::vector<std::pair<std::string, int>>& attributes, int indexes)
+{
+    std::string json = "{\"primitives\":[{\"attributes\":{";
+    for (size_t i = 0; i < attributes.size(); ++i)
+        json += fmt::format("{}\"{}\":{}", i ? "," : "", attributes[i].first, attributes[i].second);
+    meshes_.push_back(json + fmt::format("}},\"indices\":{}}}]}}", indexes));
+    return static_cast<int>(meshes_.size() - 1);
+}
+
+int GlbBuilder::AddNode(int mesh, const glm::vec3& translation, const glm::vec3& scale, bool in_scene, const std::string& extensions)
+{
+    std::string json = fmt::format("{{\"mesh\":{}", mesh);
+    if (translation != glm::vec3(0.f))
+        json += ",\"translation\":" + JsonArray({ translation.x, translation.y, translation.z });
+    if (scale != glm::vec3(1.f))
+        json += ",\"scale\":" + JsonArray({ scale.x, scale.y, scale.z });
+    if (!extensions.empty())
+        json += ",\"extensions\":{" + extensions + "}";
+    nodes_.push_back(json + "}");
+    int node = static_cast<int>(nodes_.size() - 1);
+    if (in_scene)
+        scene_nodes_.push_back(node);
+    return node;
+}
+
+void GlbBuilder::UseExtension(const std::string& name, bool required)
+{
+    if (std::find(extensions_used_.begin(), extensions_used_.end(), name) == extensions_used_.end())
+        extensions_used_.push_back(name);
+    if (required && std::find(extensions_required_.begin(), extensions_required_.end(), name) == extensions_required_.end())
+        extensions_required_.push_back(name);
+}
+
+bool GlbBuilder::Save(const std::string& file_name) const
+{
+    std::string func_name = fmt::format("GlbBuilder::Save({})", file_name);
+    Timer timer(func_name);
+
+    // glTF doesn't allow empty arrays, so they are left out.
+    auto add_array = [](std::string& json, const char* name, const std::vector<std::string>& items, bool quote) {
+        if (items.empty())
+            return;
+        json += fmt::format(",\"{}\":[", name);
+        for (size_t i = 0; i < items.size(); ++i)
+            json += fmt::format(quote ? "{}\"{}\"" : "{}{}", i ? "," : "", items[i]);
+        json += "]";
+    };
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"subface\"},\"scene\":0,\"scenes\":[{";
+    for (size_t i = 0; i < scene_nodes_.size(); ++i)
+        json += fmt::format("{}{}", i ? "," : "\"nodes\":[", scene_nodes_[i]);
+    json += scene_nodes_.empty() ? "}]" : "]}]";
+    add_array(json, "nodes", nodes_, false);
+    add_array(json, "meshes", meshes_, false);
+    add_array(json, "accessors", accessors_, false);
+    add_array(json, "bufferViews", buffer_views_, false);
+    if (!bin_.empty())
+        json += fmt::format(",\"buffers\":[{{\"byteLength\":{}}}]", bin_.size());
+    add_array(json, "extensionsUsed", extensions_used_, true);
+    add_array(json, "extensionsRequired", extensions_required_, true);
+    json += "}";
+    // Chunks are 4-byte aligned, the JSON one padded with spaces. The buffer views already are.
+    json.resize((json.size() + 3) / 4 * 4, ' ');
+
+    // The header, then the JSON and BIN chunks, each after its length and type.
+    uint64_t file_size = 12 + 8 + json.size() + (bin_.empty() ? 0 : 8 + bin_.size());
+    if (file_size > UINT32_MAX) {
+        spdlog::error("{}: {} bytes exceed the 4 GB limit of the format!", func_name, file_size);
+        return false;
+    }
+    std::vector<char> file(file_size);
+    char* p = file.data();
+    auto write_uint32 = [&](uint32_t value) {
+        std::memcpy(p, &value, sizeof(value));
+        p += sizeof(value);
+    };
+    write_uint32(0x46546C67); // "glTF"
+    write_uint32(2);
+    write_uint32(static_cast<uint32_t>(file_size));
+    write_uint32(static_cast<uint32_t>(json.size()));
+    write_uint32(0x4E4F534A); // "JSON"
+    p = std::copy(json.begin(), json.end(), p);
+    if (!bin_.empty()) {
+        write_uint32(static_cast<uint32_t>(bin_.size()));
+        write_uint32(0x004E4942); // "BIN\0"
+        std::copy(bin_.begin(), bin_.end(), p);
+    }
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    ofs.write(file.data(), file.size());
+    if (!ofs) {
+        spdlog::error("{}: Failed to write the file!", func_name);
+        return false;
+    }
+
+    spdlog::info("{}: {} meshes, {} bytes", func_name, meshes_.size(), file_size);
+    return true;
+}
+
+}
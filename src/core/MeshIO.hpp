@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace subface {
+
+class MappedFile;
+
+// Non-owning view of the arrays of a mesh, e.g. in a `MeshData` or in a memory-mapped `BinaryMesh`.
+struct MeshView {
+    const glm::vec3* positions = nullptr;
+    size_t position_count = 0;
+    const uint32_t* indexes = nullptr;
+    size_t index_count = 0;
+    // Per index, or `nullptr` if there are none.
+    const glm::vec3* normals = nullptr;
+    const glm::vec2* uvs = nullptr;
+};
+
+// Geometry of a mesh file as `Subface::BuildTopology()` consumes it, with no windowing or GL involved.
+struct MeshData {
+    std::vector<glm::vec3> positions;
+    // 3 per triangle, indexing `positions`.
+    std::vector<uint32_t> indexes;
+    // Per index, i.e. per face corner. Empty if the file doesn't have them. Corners without one are zero.
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+
+    size_t FaceCount() const
+    {
+        return indexes.size() / 3;
+    }
+    MeshView View() const;
+};
+
+// What the loaders read. The per-corner attributes take more memory than the rest of the mesh, so they are only read for consumers
+// of them, e.g. `Subface` carrying attributes.
+enum ELoadProfile {
+    // Positions and indexes. `MeshData::normals` and `MeshData::uvs` are left empty.
+    LP_Geometry = 0,
+    // Also the per-corner normals and UVs of the file.
+    LP_Full = 1,
+};
+
+// Reads the positions, normals, UVs and faces of an OBJ file, triangulating polygons as fans. Other statements are ignored.
+// The file is memory-mapped and split into line-aligned chunks parsed by `thread_count` threads, 0 for all the hardware threads.
+// Returns false if the file can't be read or a face refers to a missing element, leaving `mesh` empty.
+bool LoadObj(const std::string& file_name, MeshData& mesh, int thread_count = 0, ELoadProfile profile = LP_Full);
+
+// Reads the vertexes and faces of a binary little-endian PLY file, triangulating polygons as fans.
+// Vertex normals (nx, ny, nz) and UVs (u, v or s, t) are read as per-corner attributes. Other elements and properties are skipped.
+// Returns false if the file can't be read, isn't binary little-endian or a face refers to a missing vertex, leaving `mesh` empty.
+bool LoadPly(const std::string& file_name, MeshData& mesh, int thread_count = 0, ELoadProfile profile = LP_Full);
+// Reads a binary STL file. Its triangles don't share corners, so corners at the same position are welded into 1 vertex.
+// The facet normals are skipped. Returns false if the file can't be read or isn't a binary STL, leaving `mesh` empty.
+bool LoadStl(const std::string& file_name, MeshData& mesh, int thread_count = 0);
+// `LoadPly()`, `LoadStl()` or `LoadCompressedMesh()` by the extension of `file_name`, else `LoadObj()`.
+bool LoadMesh(const std::string& file_name, MeshData& mesh, int thread_count = 0, ELoadProfile profile = LP_Full);
+
+// Binary mesh file (.sfm), little-endian:
+//     BinaryMeshHeader
+//     sections of positions, indexes, normals and UVs, each at an offset aligned to `BinaryMeshHeader::alignment`
+// so that a memory map of the file can be used as the arrays as they are.
+struct BinaryMeshHeader {
+    static constexpr char magic_value[8] = { 'S', 'U', 'B', 'F', 'M', 'E', 'S', 'H' };
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint64_t alignment = 64;
+
+    char magic[8];
+    uint32_t version;
+    // `Flags`.
+    uint32_t flags;
+    uint64_t position_count;
+    uint64_t index_count;
+    // Byte offsets of the sections from the beginning of the file. 0 for absent optional sections.
+    uint64_t positions_offset;
+    uint64_t indexes_offset;
+    uint64_t normals_offset;
+    uint64_t uvs_offset;
+
+    enum Flags : uint32_t {
+        HasNormals = 1 << 0,
+        HasUvs = 1 << 1,
+    };
+};
+
+// Returns false if the file can't be written.
+bool SaveBinaryMesh(const std::string& file_name, const MeshView& mesh);
+
+// A binary mesh file memory-mapped for reading. `View()` points into the mapping, so loading parses and copies nothing.
+class BinaryMesh {
+    std::unique_ptr<MappedFile> file_;
+    MeshView view_;
+
+public:
+    BinaryMesh();
+    ~BinaryMesh();
+    // Returns false if the file can't be read or isn't a valid binary mesh of the current version.
+    bool Load(const std::string& file_name, int thread_count = 0);
+    // Valid until the next `Load()` or the destruction.
+    const MeshView& View() const
+    {
+        return view_;
+    }
+};
+
+// Compressed binary mesh file (.sfz), little-endian:
+//     CompressedMeshHeader
+//     the positions and the normals and UVs, if any, by `EncodeVertexStream()`, and the indexes by `EncodeIndexStream()`
+// in that order, back to back. The mesh is the same as in a binary mesh, at a fraction of the size, and decoded in parallel blocks.
+struct CompressedMeshHeader {
+    static constexpr char magic_value[8] = { 'S', 'U', 'B', 'F', 'M', 'S', 'H', 'Z' };
+    static constexpr uint32_t current_version = 1;
+
+    char magic[8];
+    uint32_t version;
+    // `BinaryMeshHeader::Flags`.
+    uint32_t flags;
+    uint64_t position_count;
+    uint64_t index_count;
+    // Byte sizes of the encoded sections. 0 for absent optional sections.
+    uint64_t positions_size;
+    uint64_t indexes_size;
+    uint64_t normals_size;
+    uint64_t uvs_size;
+};
+
+// Returns false if the file can't be written.
+bool SaveCompressedMesh(const std::string& file_name, const MeshView& mesh, int thread_count = 0);
+// Returns false if the file can't be read or isn't a valid compressed mesh of the current version, leaving `mesh` empty.
+bool LoadCompressedMesh(const std::string& file_name, MeshData& mesh, int thread_count = 0, ELoadProfile profile = LP_Full);
+
+// Component types of glTF accessors.
+enum EGltfComponentType {
+    GCT_Byte = 5120,
+    GCT_UnsignedByte = 5121,
+    GCT_Short = 5122,
+    GCT_UnsignedShort = 5123,
+    GCT_UnsignedInt = 5125,
+    GCT_Float = 5126,
+};
+
+// glTF 2.0 binary (.glb) built in memory and saved with a single write. All the buffer views are in one buffer, the BIN chunk,
+// and each mesh is a single triangle list primitive.
+class GlbBuilder {
+    std::vector<char> bin_;
+    std::vector<size_t> buffer_view_offsets_;
+    // JSON objects of the arrays of the same names.
+    std::vector<std::string> buffer_views_;
+    std::vector<std::string> accessors_;
+    std::vector<std::string> meshes_;
+    std::vector<std::string> nodes_;
+    std::vector<int> scene_nodes_;
+    std::vector<std::string> extensions_used_;
+    std::vector<std::string> extensions_required_;
+
+public:
+    // Append a buffer view of `size` bytes to the buffer. The view is of vertexes interleaved by `stride` bytes if `stride > 0`,
+    // else of indexes. Fill it through `BufferViewData()` before adding the next one.
+    int AddBufferView(size_t size, size_t stride);
+    char* BufferViewData(int buffer_view);
+    // `count` elements of `type`, e.g. "SCALAR" or "VEC3", from `offset` in `buffer_view`. `min` and `max` are written if not empty.
+    int AddAccessor(int buffer_view, size_t offset, EGltfComponentType component_type, bool normalized, size_t count, const char* type,
+        const std::vector<double>& min = {}, const std::vector<double>& max = {});
+    // `attributes` are (semantic, accessor) pairs, e.g. ("POSITION", 0).
+    int AddMesh(const std::vector<std::pair<std::string, int>>& attributes, int indexes);
+    // Node of `mesh`, placed by `translation` and `scale`, e.g. to dequantize positions, and added to the scene if `in_scene==true`.
+    // `extensions` is the content of the node's "extensions" object, if not empty.
+    int AddNode(int mesh, const glm::vec3& translation, const glm::vec3& scale, bool in_scene, const std::string& extensions = "");
+    void UseExtension(const std::string& name, bool required);
+    // Returns false if the file can't be written.
+    bool Save(const std::string& file_name) const;
+};
+
+}
@@ -0,0 +1,243 @@
+#include "ProgressiveMesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace subface {
+
+ProgressiveMesh::ProgressiveMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+    const std::vector<uint32_t>& corner_attributes)
+    : face_count_(indexes.size() / 3)
+    , face_slots_(indexes.size() / 3)
+    , slot_faces_(indexes.size() / 3)
+    , positions_(positions)
+    , indexes_(indexes)
+    , corner_attributes_(corner_attributes)
+{
+    for (size_t f = 0; f < face_count_; ++f)
+        face_slots_[f] = slot_faces_[f] = static_cast<uint32_t>(f);
+}
+
+void ProgressiveMesh::Record(uint32_t v0, uint32_t v1, const glm::vec3& p0_new, const std::vector<uint32_t>& removed_faces,
+    const std::vector<uint32_t>& corners, const std::vector<uint32_t>& moved_faces,
+    const std::vector<std::pair<uint32_t, uint32_t>>& attribute_corners)
+{
+    // Move the removed faces behind the remaining ones, so applying the record only shortens the remaining slots.
+    size_t end = FaceCount(collapses_.size());
+    for (uint32_t f : removed_faces) {
+        uint32_t slot = face_slots_[f];
+        uint32_t last = static_cast<uint32_t>(--end);
+        if (slot == last)
+            continue;
+        uint32_t g = slot_faces_[last];
+        std::swap_ranges(&indexes_[slot * 3], &indexes_[slot * 3] + 3, &indexes_[last * 3]);
+        if (!corner_attributes_.empty())
+            std::swap_ranges(&corner_attributes_[slot * 3], &corner_attributes_[slot * 3] + 3, &corner_attributes_[last * 3]);
+        std::swap(face_slots_[f], face_slots_[g]);
+        std::swap(slot_faces_[slot], slot_faces_[last]);
+        // The face moved in stays remaining.
+        if (track_changes_)
+            for (uint32_t k = 0; k < 3; ++k)
+                changed_corners_.push_back(slot * 3 + k);
+    }
+
+    removed_faces_.insert(removed_faces_.end(), removed_faces.begin(), removed_faces.end());
+    corners_.insert(corners_.end(), corners.begin(), corners.end());
+    // Faces keep their shapes around a vertex that stays in place.
+    if (p0_new != positions_[v0])
+        moved_faces_.insert(moved_faces_.end(), moved_faces.begin(), moved_faces.end());
+    if (!corner_attributes_.empty())
+        for (const auto& corner : attribute_corners)
+            attribute_changes_.push_back({ corner.first, corner_attributes_[face_slots_[corner.first / 3] * 3 + corner.first % 3], corner.second });
+
+    Collapse c;
+    c.v0 = v0;
+    c.v1 = v1;
+    c.p0_old = positions_[v0];
+    c.p0_new = p0_new;
+    c.removed_end = static_cast<uint32_t>(removed_faces_.size());
+    c.corner_end = static_cast<uint32_t>(corners_.size());
+    c.moved_end = static_cast<uint32_t>(moved_faces_.size());
+    c.attribute_end = static_cast<uint32_t>(attribute_changes_.size());
+    c.face_count = FaceCount(collapses_.size()) - removed_faces.size();
+    collapses_.push_back(c);
+
+    Step(collapses_.size() - 1, true);
+    current_ = collapses_.size();
+}
+
+void ProgressiveMesh::Step(size_t i, bool apply)
+{
+    if (!track_changes_) {
+        apply ? Apply(i) : Undo(i);
+        return;
+    }
+
+    // Take the faces the step changes out of the normals as they are, and add them back as they become.
+    AddFaceNormals(i, apply, -1.f);
+    apply ? Apply(i) : Undo(i);
+    AddFaceNormals(i, !apply, 1.f);
+
+    const Collapse& c = collapses_[i];
+    changed_vertexes_.push_back(c.v0);
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].corner_end; k < c.corner_end; ++k)
+        changed_corners_.push_back(face_slots_[corners_[k] / 3] * 3 + corners_[k] % 3);
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].attribute_end; k < c.attribute_end; ++k)
+        changed_corners_.push_back(face_slots_[attribute_changes_[k].corner / 3] * 3 + attribute_changes_[k].corner % 3);
+    // The split faces are remaining again.
+    if (!apply)
+        for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].removed_end; k < c.removed_end; ++k)
+            for (uint32_t j = 0; j < 3; ++j)
+                changed_corners_.push_back(face_slots_[removed_faces_[k]] * 3 + j);
+}
+
+void ProgressiveMesh::Apply(size_t i)
+{
+    const Collapse& c = collapses_[i];
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].corner_end; k < c.corner_end; ++k)
+        indexes_[face_slots_[corners_[k] / 3] * 3 + corners_[k] % 3] = c.v0;
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].attribute_end; k < c.attribute_end; ++k) {
+        const AttributeChange& change = attribute_changes_[k];
+        corner_attributes_[face_slots_[change.corner / 3] * 3 + change.corner % 3] = change.attribute_new;
+    }
+    positions_[c.v0] = c.p0_new;
+}
+
+void ProgressiveMesh::Undo(size_t i)
+{
+    const Collapse& c = collapses_[i];
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].corner_end; k < c.corner_end; ++k)
+        indexes_[face_slots_[corners_[k] / 3] * 3 + corners_[k] % 3] = c.v1;
+    // Undo in reverse in case a corner changes more than once.
+    for (uint32_t k = c.attribute_end; k-- > (i == 0 ? 0 : collapses_[i - 1].attribute_end);) {
+        const AttributeChange& change = attribute_changes_[k];
+        corner_attributes_[face_slots_[change.corner / 3] * 3 + change.corner % 3] = change.attribute_old;
+    }
+    positions_[c.v0] = c.p0_old;
+}
+
+void ProgressiveMesh::AddFaceNormals(size_t i, bool removed, float sign)
+{
+    const Collapse& c = collapses_[i];
+    if (removed)
+        for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].removed_end; k < c.removed_end; ++k)
+            AddFaceNormal(removed_faces_[k], sign);
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].corner_end; k < c.corner_end; ++k)
+        AddFaceNormal(corners_[k] / 3, sign);
+    for (uint32_t k = i == 0 ? 0 : collapses_[i - 1].moved_end; k < c.moved_end; ++k)
+        AddFaceNormal(moved_faces_[k], sign);
+}
+
+void ProgressiveMesh::AddFaceNormal(uint32_t face, float sign)
+{
+    // Same weights as `ScatterVertexNormals()`.
+    const uint32_t* v = &indexes_[face_slots_[face] * 3];
+    for (int j = 0; j < 3; ++j)
+        changed_vertexes_.push_back(v[j]);
+    glm::vec3 e[3] = { positions_[v[1]] - positions_[v[0]], positions_[v[2]] - positions_[v[1]], positions_[v[0]] - positions_[v[2]] };
+    glm::vec3 n = glm::cross(e[0], -e[2]);
+    float length = glm::length(n);
+    if (length == 0.f)
+        return;
+    n /= length;
+    for (int j = 0; j < 3; ++j) {
+        float angle = std::atan2(glm::length(glm::cross(e[j], e[(j + 2) % 3])), -glm::dot(e[j], e[(j + 2) % 3]));
+        normal_sums_[v[j]] += glm::dvec3(n * (angle * sign));
+    }
+}
+
+size_t ProgressiveMesh::Find(size_t target_face_count, bool round_down) const
+{
+    // Face counts are non-increasing. Find the first state with no more than `target_face_count` faces.
+    size_t lo = 0, hi = collapses_.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (FaceCount(mid) <= target_face_count)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    if (!round_down && lo > 0 && FaceCount(lo) < target_face_count)
+        --lo;
+    return lo;
+}
+
+void ProgressiveMesh::Seek(size_t collapse)
+{
+    collapse = std::min(collapse, collapses_.size());
+    for (; current_ < collapse; ++current_)
+        Step(current_, true);
+    for (; current_ > collapse; --current_)
+        Step(current_ - 1, false);
+}
+
+void ProgressiveMesh::Extract(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indexes, std::vector<uint32_t>* corner_attributes) const
+{
+    // Keep the vertexes and the faces in their original order.
+    size_t slot_count = FaceCount(current_);
+    std::vector<uint32_t> remap(positions_.size(), 0);
+    for (size_t s = 0; s < slot_count * 3; ++s)
+        remap[indexes_[s]] = 1;
+    positions.clear();
+    for (size_t v = 0; v < positions_.size(); ++v)
+        if (remap[v]) {
+            remap[v] = static_cast<uint32_t>(positions.size());
+            positions.push_back(positions_[v]);
+        }
+
+    indexes.clear();
+    indexes.reserve(slot_count * 3);
+    for (size_t f = 0; f < face_count_; ++f)
+        if (face_slots_[f] < slot_count)
+            for (size_t j = 0; j < 3; ++j)
+                indexes.push_back(remap[indexes_[face_slots_[f] * 3 + j]]);
+
+    if (corner_attributes) {
+        corner_attributes->clear();
+        if (!corner_attributes_.empty())
+            for (size_t f = 0; f < face_count_; ++f)
+                if (face_slots_[f] < slot_count)
+                    corner_attributes->insert(corner_attributes->end(), &corner_attributes_[face_slots_[f] * 3], &corner_attributes_[face_slots_[f] * 3] + 3);
+    }
+}
+
+void ProgressiveMesh::AppendIndexes(std::vector<uint32_t>& indexes) const
+{
+    size_t slot_count = FaceCount(current_);
+    indexes.reserve(indexes.size() + slot_count * 3);
+    for (size_t f = 0; f < face_count_; ++f)
+        if (face_slots_[f] < slot_count)
+            indexes.insert(indexes.end(), &indexes_[face_slots_[f] * 3], &indexes_[face_slots_[f] * 3] + 3);
+}
+
+void ProgressiveMesh::TrackChanges(bool track)
+{
+    track_changes_ = track;
+    std::vector<uint32_t>().swap(changed_vertexes_);
+    std::vector<uint32_t>().swap(changed_corners_);
+    if (!track) {
+        std::vector<glm::dvec3>().swap(normal_sums_);
+        return;
+    }
+
+    normal_sums_.assign(positions_.size(), glm::dvec3(0.));
+    for (size_t s = 0; s < FaceCount(current_); ++s)
+        AddFaceNormal(slot_faces_[s], 1.f);
+    changed_vertexes_.clear();
+}
+
+glm::vec3 ProgressiveMesh::Normal(uint32_t v) const
+{
+    double length = glm::length(normal_sums_[v]);
+    return length > 0. ? glm::vec3(normal_sums_[v] / length) : glm::vec3(0.f);
+}
+
+void ProgressiveMesh::TakeChanges(std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners)
+{
+    vertexes.swap(changed_vertexes_);
+    corners.swap(changed_corners_);
+    changed_vertexes_.clear();
+    changed_corners_.clear();
+}
+
+}
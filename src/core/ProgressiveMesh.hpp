@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace subface {
+
+// Edge collapse sequence of a decimation, recorded as collapse / vertex split records (Hoppe, "Progressive Meshes", 1996).
+// The mesh is kept as flat position and index buffers, with the faces in the order of their removal, the latest first, so the
+// remaining faces of any state are the first `FaceCount()` faces of the index buffer. Applying a record drops its faces off the
+// end, re-targets the corners of v1 to v0 and moves v0. Undoing it is the vertex split. Any state of the sequence is reached by
+// replaying or undoing records from the current state, so stepping by a single face costs O(valence) instead of a whole decimation.
+// Records are appended to the last state, so a sequence only needs to be recorded as far as it is used.
+// Optionally, per-corner attribute indexes are tracked along, each record re-targeting some corners to other attributes.
+class ProgressiveMesh {
+    struct Collapse {
+        uint32_t v0, v1;
+        glm::vec3 p0_old, p0_new;
+        // Ends of the ranges in `removed_faces_`, `corners_`, `moved_faces_` and `attribute_changes_`. The ranges begin at the ends
+        // of the previous record.
+        uint32_t removed_end, corner_end, moved_end, attribute_end;
+        // Face count after this collapse.
+        size_t face_count;
+    };
+    struct AttributeChange {
+        uint32_t corner;
+        uint32_t attribute_old, attribute_new;
+    };
+
+    size_t face_count_ = 0;
+    std::vector<Collapse> collapses_;
+    std::vector<uint32_t> removed_faces_;
+    std::vector<uint32_t> corners_;
+    std::vector<uint32_t> moved_faces_;
+    std::vector<AttributeChange> attribute_changes_;
+
+    // Slot of each face in `indexes_`, and the face in each slot. The faces the i-th collapse removes are in the slots from
+    // `FaceCount(i + 1)` to `FaceCount(i)`, and the faces the last state keeps are in the slots before.
+    std::vector<uint32_t> face_slots_;
+    std::vector<uint32_t> slot_faces_;
+
+    // Current state, after the first `current_` collapses.
+    size_t current_ = 0;
+    std::vector<glm::vec3> positions_;
+    // Per slot. The removed faces keep their indexes from the time of their removal.
+    std::vector<uint32_t> indexes_;
+    // Per slot. Empty if attributes aren't tracked.
+    std::vector<uint32_t> corner_attributes_;
+
+    // Angle-weighted sums of the face normals around each vertex, and the vertexes and slot corners changed since the last
+    // `TakeChanges()`, while tracking changes.
+    bool track_changes_ = false;
+    std::vector<glm::dvec3> normal_sums_;
+    std::vector<uint32_t> changed_vertexes_;
+    std::vector<uint32_t> changed_corners_;
+
+    // Apply or undo collapse `i` and track the changes. `Apply()` and `Undo()` change the buffers only.
+    void Step(size_t i, bool apply);
+    void Apply(size_t i);
+    void Undo(size_t i);
+    // Add the normals of the faces changed by collapse `i` to `normal_sums_` with `sign` and track their vertexes. The removed faces
+    // count if `removed==true`.
+    void AddFaceNormals(size_t i, bool removed, float sign);
+    void AddFaceNormal(uint32_t face, float sign);
+
+public:
+    // `corner_attributes` are the attribute indexes of the corners of `indexes`, or empty to track no attributes.
+    ProgressiveMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+        const std::vector<uint32_t>& corner_attributes = {});
+
+    // Append the collapse of v1 into v0, which moves v0 to `p0_new`, removes `removed_faces`, and re-targets `corners`
+    // (`face * 3 + vertex_id`) from v1 to v0. `moved_faces` are the other faces around v0, which only matter if v0 moves.
+    // The record is applied to the current state, which must be the last one.
+    // `attribute_corners` are the (corner, new attribute index) pairs the collapse changes.
+    void Record(uint32_t v0, uint32_t v1, const glm::vec3& p0_new, const std::vector<uint32_t>& removed_faces,
+        const std::vector<uint32_t>& corners, const std::vector<uint32_t>& moved_faces,
+        const std::vector<std::pair<uint32_t, uint32_t>>& attribute_corners = {});
+
+    size_t CollapseCount() const
+    {
+        return collapses_.size();
+    }
+    size_t Current() const
+    {
+        return current_;
+    }
+    // Face count after the first `collapse` collapses.
+    size_t FaceCount(size_t collapse) const
+    {
+        return collapse == 0 ? face_count_ : collapses_[collapse - 1].face_count;
+    }
+    // The state a greedy decimation toward `target_face_count` stops at, among the recorded ones.
+    // if `round_down==true`:
+    //     The first state with no more than `target_face_count` faces.
+    // else:
+    //     The last state with no less than `target_face_count` faces.
+    size_t Find(size_t target_face_count, bool round_down) const;
+    // Move the current state to after the first `collapse` collapses.
+    void Seek(size_t collapse);
+    // Remaining faces and the vertexes they use, compacted, in the original order. Also the attribute indexes of their corners
+    // if `corner_attributes` isn't `nullptr`.
+    void Extract(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indexes, std::vector<uint32_t>* corner_attributes = nullptr) const;
+    // Append the indexes of the remaining faces to `indexes` in the original order, without compacting the vertexes.
+    void AppendIndexes(std::vector<uint32_t>& indexes) const;
+
+    // Buffers of the current state. The indexes of the remaining faces are the first `FaceCount(Current()) * 3` ones, and the
+    // positions are of all the vertexes, including the removed ones.
+    const std::vector<glm::vec3>& Positions() const
+    {
+        return positions_;
+    }
+    const std::vector<uint32_t>& Indexes() const
+    {
+        return indexes_;
+    }
+    const std::vector<uint32_t>& CornerAttributes() const
+    {
+        return corner_attributes_;
+    }
+
+    // Start or stop tracking the vertex normals of the current state, and the vertexes and the corners of `Indexes()` the steps
+    // change, for updating copies of the buffers in place. Starting takes O(n), and each step then takes O(valence^2).
+    void TrackChanges(bool track);
+    // Normalized angle-weighted vertex normal, as `ScatterVertexNormals()` computes, while tracking changes.
+    glm::vec3 Normal(uint32_t v) const;
+    // Move the vertexes whose position or normal changed, and the corners whose index or attribute changed or which became
+    // remaining, to `vertexes` and `corners`. Both may repeat and include corners past the remaining faces.
+    void TakeChanges(std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners);
+};
+
+}
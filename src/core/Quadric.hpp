@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+namespace subface {
+
+// Quadric error metric of Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997.
+// The symmetric 4x4 matrix is stored as its upper triangle
+//     a[0] a[1] a[2] a[3]
+//          a[4] a[5] a[6]
+//               a[7] a[8]
+//                    a[9]
+// padded to 12 doubles so that accumulation compiles to aligned vector adds.
+struct Quadric {
+    alignas(32) double a[12] {};
+
+    // Quadric of the squared distance to plane `dot(n, p) + d == 0` with weight `w`. `n` must be normalized.
+    static Quadric Plane(const glm::dvec3& n, double d, double w)
+    {
+        Quadric q;
+        q.a[0] = w * n.x * n.x;
+        q.a[1] = w * n.x * n.y;
+        q.a[2] = w * n.x * n.z;
+        q.a[3] = w * n.x * d;
+        q.a[4] = w * n.y * n.y;
+        q.a[5] = w * n.y * n.z;
+        q.a[6] = w * n.y * d;
+        q.a[7] = w * n.z * n.z;
+        q.a[8] = w * n.z * d;
+        q.a[9] = w * d * d;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        for (int i = 0; i < 12; ++i)
+            a[i] += q.a[i];
+        return *this;
+    }
+    Quadric operator+(const Quadric& q) const
+    {
+        Quadric r = *this;
+        return r += q;
+    }
+
+    double Error(const glm::dvec3& p) const
+    {
+        double e = a[0] * p.x * p.x + a[4] * p.y * p.y + a[7] * p.z * p.z
+            + 2.0 * (a[1] * p.x * p.y + a[2] * p.x * p.z + a[5] * p.y * p.z)
+            + 2.0 * (a[3] * p.x + a[6] * p.y + a[8] * p.z)
+            + a[9];
+        // Rounding may give tiny negative errors.
+        return e > 0.0 ? e : 0.0;
+    }
+
+    // Position minimizing the error, i.e. the solution of `A * p == -b`.
+    // Returns false if the system is ill-conditioned, e.g. for planar or linear neighborhoods.
+    bool Optimal(glm::dvec3& p) const
+    {
+        // Cofactors of the symmetric 3x3 matrix A.
+        double c00 = a[4] * a[7] - a[5] * a[5];
+        double c01 = a[2] * a[5] - a[1] * a[7];
+        double c02 = a[1] * a[5] - a[2] * a[4];
+        double c11 = a[0] * a[7] - a[2] * a[2];
+        double c12 = a[1] * a[2] - a[0] * a[5];
+        double c22 = a[0] * a[4] - a[1] * a[1];
+        double det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+
+        // Compare to the scale of A so that the check doesn't depend on the model size.
+        double scale = a[0] + a[4] + a[7];
+        if (std::abs(det) <= 1e-6 * scale * scale * scale)
+            return false;
+
+        double inv = -1.0 / det;
+        p.x = inv * (c00 * a[3] + c01 * a[6] + c02 * a[8]);
+        p.y = inv * (c01 * a[3] + c11 * a[6] + c12 * a[8]);
+        p.z = inv * (c02 * a[3] + c12 * a[6] + c22 * a[8]);
+        return true;
+    }
+};
+
+}
@@ -2,15 +2,26 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 
 #include <meshoptimizer/meshoptimizer.h>
 #include <spdlog/spdlog.h>
 
+#include "EdgeQueue.hpp"
+#include "Parallel.hpp"
+#include "ProgressiveMesh.hpp"
+#include "Quadric.hpp"
 #include "Timer.hpp"
+#include "TriangleBvh.hpp"
 
 namespace subface {
 
@@ -202,6 +213,7 @@ Face::Face()
     for (int i = 0; i < 3; ++i) {
         v[i] = nullptr;
         neighbors[i] = nullptr;
+        attributes[i] = 0;
     }
     for (int i = 0; i < 4; ++i)
         children[i] = nullptr;
@@ -220,6 +232,7 @@ void Face::Shift(int k)
     k %= 3;
     std::rotate(v, v + k, v + 3);
     std::rotate(neighbors, neighbors + k, neighbors + 3);
+    std::rotate(attributes, attributes + k, attributes + 3);
 }
 
 bool Face::OppositeNeighbor(int k) const
@@ -235,11 +248,62 @@ bool Face::OppositeNeighbor(int k) const
     return fn ? fn->VertexId(v[NEXT(k)]) == NEXT(fn->VertexId(v[k])) : false;
 }
 
+struct EdgeCollapse;
+
+// Collapse sequence of an edge collapse decimation, recorded as far as the decimations ask for. The topology, the queue and the
+// attributes are kept where the recording stopped, so a target past the recorded states continues from there.
+class Subface::EdgeCollapseRecorder {
+    EDecimatePlacement placement_;
+    bool carry_attributes_;
+    std::vector<Vertex> vertexes_;
+    std::vector<Face> faces_;
+    std::vector<Quadric> quadrics_;
+    // `origin_attributes_` and the attributes merged by the recorded collapses.
+    std::vector<CornerAttribute> attributes_;
+    // Attribute of one of the corners of each vertex for the costs, which are updated while the faces are half collapsed.
+    std::vector<uint32_t> vertex_attributes_;
+    // Attributes of the collapse `allow` accepted last, for `record`.
+    struct {
+        uint32_t attribute0, attribute1;
+        glm::vec3 p0;
+    } allowed_ {};
+    std::unique_ptr<EdgeCollapse> collapse_;
+    std::unique_ptr<EdgeQueue> queue_;
+    size_t face_count_;
+    ProgressiveMesh mesh_;
+    std::vector<uint32_t> removed_faces_, corners_, moved_faces_;
+    std::vector<std::pair<uint32_t, uint32_t>> attribute_corners_;
+
+    void Record(const Vertex* v0, const Vertex* v1, const std::vector<Face*>& removed, const std::vector<const Face*>& sweep);
+
+public:
+    EdgeCollapseRecorder(const Subface& sf, EDecimatePlacement placement);
+    ~EdgeCollapseRecorder();
+
+    EDecimatePlacement Placement() const
+    {
+        return placement_;
+    }
+    ProgressiveMesh& Mesh()
+    {
+        return mesh_;
+    }
+    const std::vector<CornerAttribute>& Attributes() const
+    {
+        return attributes_;
+    }
+    // Record collapses until the last state has no more than `target_face_count` faces or no edge is left. Recording moves the
+    // current state to the last one.
+    void RecordTo(size_t target_face_count);
+};
+
 Subface::Subface()
 {
     std::string func_name = fmt::format("LoopSubface::Subface()");
     Timer timer(func_name);
 
+    thread_count_ = DefaultThreadCount();
+
 #ifdef USE_SIMPLYGON
     // Initialize the SDK.
     Simplygon::EErrorCodes init_error_code = Simplygon::Initialize(&simplygon_);
@@ -308,10 +372,106 @@ void Subface::BuildTopology(const std::vector<glm::vec3>& positions, const std::
 
 void Subface::BuildTopology(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes)
 {
-    origin_positions_ = positions;
-    origin_indexes_ = indexes;
+    BuildTopology(positions, indexes, {}, {});
+}
+
+void Subface::BuildTopology(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+    const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& uvs)
+{
+    MeshView mesh;
+    mesh.positions = positions.data();
+    mesh.position_count = positions.size();
+    mesh.indexes = indexes.data();
+    mesh.index_count = indexes.size();
+    mesh.normals = !indexes.empty() && normals.size() == indexes.size() ? normals.data() : nullptr;
+    mesh.uvs = !indexes.empty() && uvs.size() == indexes.size() ? uvs.data() : nullptr;
+    BuildTopology(mesh);
+}
+
+void Subface::BuildTopology(const MeshView& mesh)
+{
+    origin_positions_.assign(mesh.positions, mesh.positions + mesh.position_count);
+    origin_indexes_.assign(mesh.indexes, mesh.indexes + mesh.index_count);
+    edge_collapses_.reset();
+    live_decimation_ = false;
+    origin_bvh_.reset();
+
+    BuildTopology(origin_positions_, origin_indexes_, origin_vertexes_, origin_faces_);
+
+    const std::vector<uint32_t>& indexes = origin_indexes_;
+    const glm::vec3* normals = mesh.normals;
+    const glm::vec2* uvs = mesh.uvs;
+    carry_normals_ = !indexes.empty() && normals;
+    carry_uvs_ = !indexes.empty() && uvs;
+    origin_attributes_.clear();
+    origin_attribute_indexes_.clear();
+    if (carry_normals_ || carry_uvs_) {
+        struct CornerAttributeHash {
+            size_t operator()(const CornerAttribute& a) const
+            {
+                const float* f = &a.normal.x;
+                size_t h = std::hash<float>()(a.uv.x) ^ std::hash<float>()(a.uv.y) * 0x9e3779b97f4a7c15ull;
+                for (int i = 0; i < 3; ++i)
+                    h = h * 0x9e3779b97f4a7c15ull ^ std::hash<float>()(f[i]);
+                return h;
+            }
+        };
+        std::unordered_map<CornerAttribute, uint32_t, CornerAttributeHash> attribute2index;
+        origin_attribute_indexes_.resize(indexes.size());
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            CornerAttribute a { carry_normals_ ? normals[i] : glm::vec3(0.f), carry_uvs_ ? uvs[i] : glm::vec2(0.f) };
+            auto it = attribute2index.emplace(a, static_cast<uint32_t>(origin_attributes_.size())).first;
+            if (it->second == origin_attributes_.size())
+                origin_attributes_.push_back(a);
+            origin_attribute_indexes_[i] = it->second;
+        }
+        for (size_t i = 0; i < origin_faces_.size(); ++i)
+            for (int j = 0; j < 3; ++j)
+                origin_faces_[i].attributes[j] = origin_attribute_indexes_[i * 3 + j];
+    }
+    attributes_ = origin_attributes_;
+
+    CloneTopology(origin_vertexes_, origin_faces_, vertexes_, faces_);
+}
+
+void Subface::CloneTopology(const std::vector<Vertex>& vertexes_src, const std::vector<Face>& faces_src,
+    std::vector<Vertex>& vertexes, std::vector<Face>& faces)
+{
+    static_assert(std::is_trivially_copyable<Vertex>::value && std::is_trivially_copyable<Face>::value,
+        "Topology clones are plain memory copies");
+    vertexes = vertexes_src;
+    faces = faces_src;
+
+    auto vertex = [&](const Vertex* v) {
+        return v ? vertexes.data() + (v - vertexes_src.data()) : nullptr;
+    };
+    auto face = [&](const Face* f) {
+        return f ? faces.data() + (f - faces_src.data()) : nullptr;
+    };
+    for (Vertex& v : vertexes) {
+        v.start_face = face(v.start_face);
+        v.child = nullptr;
+    }
+    for (Face& f : faces) {
+        for (int i = 0; i < 3; ++i) {
+            f.v[i] = vertex(f.v[i]);
+            f.neighbors[i] = face(f.neighbors[i]);
+        }
+        for (int i = 0; i < 4; ++i)
+            f.children[i] = nullptr;
+    }
+}
 
-    BuildTopology(origin_positions_, origin_indexes_, vertexes_, faces_);
+void Subface::ResetBase(std::vector<Vertex*>& vertexes_base, std::vector<Face*>& faces_base)
+{
+    // A subdivision links the base to its children, and `Tessellate4_1()` also rotates the base faces.
+    CloneTopology(origin_vertexes_, origin_faces_, vertexes_, faces_);
+    vertexes_base.resize(vertexes_.size());
+    faces_base.resize(faces_.size());
+    for (size_t i = 0; i < vertexes_.size(); i++)
+        vertexes_base[i] = &vertexes_[i];
+    for (size_t i = 0; i < faces_.size(); i++)
+        faces_base[i] = &faces_[i];
 }
 
 float Subface::Beta(int valence)
@@ -346,79 +506,597 @@ glm::vec3 Subface::WeightBoundary(Vertex* v, float beta)
     return p;
 }
 
-void Subface::ComputeNormalsAndPositions(const std::vector<Vertex*>& vertexes, const std::vector<Face*>& faces)
+void Subface::ComputeNormalsAndPositions(const std::vector<Vertex*>& vertexes, const std::vector<Face*>& faces, bool carry_attributes)
 {
+    // Vertex indexes, so that the faces index the vertexes without a lookup.
+    indexed_positions_.resize(vertexes.size());
+    ParallelFor(vertexes.size(), thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            vertexes[i]->index = static_cast<uint32_t>(i);
+            indexed_positions_[i] = vertexes[i]->p;
+        }
+    });
+
     // Compute vertexes' smooth normals.
     std::vector<glm::vec3> smooth_normals(vertexes.size());
-    for (size_t vi = 0; vi < vertexes.size(); ++vi) {
-        const Vertex* v = vertexes[vi];
-
-        glm::vec3 S(0, 0, 0), T(0, 0, 0);
-        size_t valence = v->valence;
-        std::vector<const Vertex*> ring = v->OneRing();
-        if (!v->boundary) {
-            for (size_t i = 0; i < valence; ++i) {
-                T += std::cos(2.f * PI * i / valence) * ring[i]->p;
-                S += std::sin(2.f * PI * i / valence) * ring[i]->p;
-            }
-        } else {
-            S = ring[valence - 1]->p - ring[0]->p;
-            if (valence == 2)
-                T = -v->p * 2.f + ring[0]->p + ring[1]->p;
-            else if (valence == 3)
-                T = -v->p + ring[1]->p;
-            else if (valence == 4)
-                T = -v->p * 2.f - ring[0]->p + ring[1]->p * 2.f + ring[2]->p * 2.f - ring[3]->p;
-            else {
-                float theta = PI / float(valence - 1);
-                T = std::sin(theta) * (ring[0]->p + ring[valence - 1]->p);
-                for (size_t i = 1; i < valence - 1; ++i) {
-                    float weight = (std::cos(theta) * 2.f - 2.f) * std::sin(theta * i);
-                    T += ring[i]->p * weight;
+    ParallelFor(vertexes.size(), thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t vi = begin; vi < end; ++vi) {
+            const Vertex* v = vertexes[vi];
+
+            glm::vec3 S(0, 0, 0), T(0, 0, 0);
+            size_t valence = v->valence;
+            std::vector<const Vertex*> ring = v->OneRing();
+            if (!v->boundary) {
+                for (size_t i = 0; i < valence; ++i) {
+                    T += std::cos(2.f * PI * i / valence) * ring[i]->p;
+                    S += std::sin(2.f * PI * i / valence) * ring[i]->p;
+                }
+            } else {
+                S = ring[valence - 1]->p - ring[0]->p;
+                if (valence == 2)
+                    T = -v->p * 2.f + ring[0]->p + ring[1]->p;
+                else if (valence == 3)
+                    T = -v->p + ring[1]->p;
+                else if (valence == 4)
+                    T = -v->p * 2.f - ring[0]->p + ring[1]->p * 2.f + ring[2]->p * 2.f - ring[3]->p;
+                else {
+                    float theta = PI / float(valence - 1);
+                    T = std::sin(theta) * (ring[0]->p + ring[valence - 1]->p);
+                    for (size_t i = 1; i < valence - 1; ++i) {
+                        float weight = (std::cos(theta) * 2.f - 2.f) * std::sin(theta * i);
+                        T += ring[i]->p * weight;
+                    }
+                    T = -T;
                 }
-                T = -T;
             }
+            smooth_normals[vi] = glm::normalize(glm::cross(S, T));
         }
-        smooth_normals[vi] = glm::normalize(glm::cross(S, T));
+    });
+
+    vertex_indexes_.resize(faces.size() * 3);
+    ParallelFor(faces.size(), thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; i++)
+            for (int j = 0; j < 3; j++)
+                vertex_indexes_[i * 3 + j] = static_cast<int>(faces[i]->v[j]->index);
+    });
+
+    indexed_smooth_normals_ = std::move(smooth_normals);
+
+    std::vector<uint32_t> corner_attributes;
+    if (carry_attributes) {
+        corner_attributes.resize(faces.size() * 3);
+        for (size_t i = 0; i < faces.size(); ++i)
+            std::copy(faces[i]->attributes, faces[i]->attributes + 3, &corner_attributes[i * 3]);
     }
+    FinishOutputs(vertexes, corner_attributes);
+}
 
-    // Vertex indexes.
-    std::map<const Vertex*, int> vertex2index;
-    for (size_t i = 0; i < vertexes.size(); ++i)
-        vertex2index[vertexes[i]] = static_cast<int>(i);
+// Angle weighted vertex normals (Thürmer and Wüthrich, "Computing Vertex Normals from Polygonal Facets", 1998), scattered from the faces.
+// Each thread accumulates its range of faces into its own normals, which are then summed in thread order, so the result is deterministic.
+std::vector<glm::vec3> ScatterVertexNormals(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, int thread_count)
+{
+    size_t face_count = indexes.size() / 3;
+    thread_count = std::max(1, std::min(thread_count, static_cast<int>(face_count)));
+    // Thread 0 accumulates into the result.
+    std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.f));
+    std::vector<std::vector<glm::vec3>> thread_normals(thread_count - 1);
+    ParallelFor(face_count, thread_count, [&](size_t begin, size_t end, int tid) {
+        std::vector<glm::vec3>& accumulator = tid == 0 ? normals : thread_normals[tid - 1];
+        if (tid != 0)
+            accumulator.assign(positions.size(), glm::vec3(0.f));
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t* v = &indexes[i * 3];
+            glm::vec3 e[3] = { positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[1]], positions[v[0]] - positions[v[2]] };
+            glm::vec3 n = glm::cross(e[0], -e[2]);
+            float length = glm::length(n);
+            // Degenerate faces have no normal.
+            if (length == 0.f)
+                continue;
+            n /= length;
+            for (int j = 0; j < 3; ++j) {
+                // The angle at corner j, between its outgoing edge and the reversed incoming one.
+                float angle = std::atan2(glm::length(glm::cross(e[j], e[PREV(j)])), -glm::dot(e[j], e[PREV(j)]));
+                accumulator[v[j]] += n * angle;
+            }
+        }
+    });
 
-    indexed_positions_.resize(vertexes.size());
-    for (size_t i = 0; i < vertexes.size(); ++i)
-        indexed_positions_[i] = vertexes[i]->p;
+    ParallelFor(positions.size(), thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t vi = begin; vi < end; ++vi) {
+            glm::vec3 n = normals[vi];
+            for (const std::vector<glm::vec3>& accumulator : thread_normals)
+                n += accumulator[vi];
+            float length = glm::length(n);
+            normals[vi] = length > 0.f ? n / length : n;
+        }
+    });
+    return normals;
+}
 
-    vertex_indexes_.resize(faces.size() * 3);
-    smooth_normal_indexes_.resize(faces.size() * 3);
-    flat_normal_indexes_.resize(faces.size() * 3);
-    for (size_t i = 0; i < faces.size(); ++i)
+void Subface::ComputeIndexedOutputs(std::vector<glm::vec3>&& positions, const std::vector<uint32_t>& indexes, const std::vector<uint32_t>& corner_attributes)
+{
+    indexed_smooth_normals_ = ScatterVertexNormals(positions, indexes, thread_count_);
+    indexed_positions_ = std::move(positions);
+    vertex_indexes_.resize(indexes.size());
+    ParallelFor(indexes.size(), thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            vertex_indexes_[i] = static_cast<int>(indexes[i]);
+    });
+
+    FinishOutputs({}, corner_attributes);
+}
+
+void Subface::FreeDerivedOutputs()
+{
+    // Free them rather than keeping their capacity.
+    for (std::vector<glm::vec3>* v : { &indexed_flat_normals_, &unindexed_positions_, &unindexed_smooth_normals_,
+             &unindexed_flat_normals_, &unindexed_attribute_normals_ })
+        std::vector<glm::vec3>().swap(*v);
+    std::vector<glm::vec2>().swap(unindexed_uvs_);
+}
+
+void Subface::FinishOutputs(const std::vector<Vertex*>& vertexes, const std::vector<uint32_t>& corner_attributes)
+{
+    FreeDerivedOutputs();
+    live_decimation_ = false;
+    outputs_replaced_ = true;
+    std::vector<uint32_t>().swap(changed_vertexes_);
+    std::vector<uint32_t>().swap(changed_corners_);
+
+    // Carried attributes. Only export the ones in use.
+    indexed_attributes_.clear();
+    attribute_indexes_.clear();
+    if (!corner_attributes.empty() && (carry_normals_ || carry_uvs_)) {
+        std::vector<int> remap(attributes_.size(), -1);
+        attribute_indexes_.resize(corner_attributes.size());
+        for (size_t i = 0; i < corner_attributes.size(); ++i) {
+            int& index = remap[corner_attributes[i]];
+            if (index == -1) {
+                index = static_cast<int>(indexed_attributes_.size());
+                indexed_attributes_.push_back(attributes_[corner_attributes[i]]);
+            }
+            attribute_indexes_[i] = index;
+        }
+    }
+
+    if (optimize_vertex_order_ && !vertex_indexes_.empty())
+        ReorderOutputs(vertexes);
+}
+
+// Average cache miss ratio, i.e. vertex shader invocations per face, of `indexes` on a FIFO post-transform cache of `cache_size` vertexes.
+float AverageCacheMissRatio(const std::vector<int>& indexes, size_t vertex_count, size_t cache_size)
+{
+    if (indexes.empty())
+        return 0.f;
+    // A vertex is in the cache while less than `cache_size` vertexes have been inserted after it.
+    std::vector<size_t> inserted(vertex_count, 0);
+    size_t time = cache_size + 1, misses = 0;
+    for (int v : indexes)
+        if (time - inserted[v] > cache_size) {
+            inserted[v] = time++;
+            ++misses;
+        }
+    return static_cast<float>(misses) / static_cast<float>(indexes.size() / 3);
+}
+
+// Face order of `indexes` for a post-transform vertex cache, with Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006.
+// Vertexes are scored by their positions in a simulated LRU cache and by how few of their faces are left, and the face with
+// the highest summed score among the faces of the cached vertexes is emitted next. Fewer faces left boosts a vertex,
+// so vertexes of high valence don't get fanned around all at once and thrash the cache.
+// `cluster_starts` gets the positions in the order where no cached vertex had faces left, so it restarted from the next face
+// in the input order. The clusters between them can be reordered without hurting the cache much.
+std::vector<uint32_t> OptimizeFaceOrderForCache(const std::vector<int>& indexes, size_t vertex_count, std::vector<uint32_t>& cluster_starts)
+{
+    const int cache_size = 32;
+    size_t face_count = indexes.size() / 3;
+
+    // Faces around each vertex. The first `live[v]` of them are left.
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (int v : indexes)
+        ++offsets[v + 1];
+    for (size_t v = 0; v < vertex_count; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(indexes.size());
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < indexes.size(); ++i)
+        adjacency[offsets[indexes[i]] + live[indexes[i]]++] = static_cast<uint32_t>(i / 3);
+
+    auto vertex_score = [&](int cache_position, uint32_t live_count) {
+        if (live_count == 0)
+            return -1.f;
+        float score = 0.f;
+        if (cache_position >= 0) {
+            // The vertexes of the last face get a fixed score, so that the faces in a strip don't prefer going back.
+            if (cache_position < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.f - float(cache_position - 3) / float(cache_size - 3), 1.5f);
+        }
+        return score + 2.f / std::sqrt(float(live_count));
+    };
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        vertex_scores[v] = vertex_score(-1, live[v]);
+
+    std::vector<uint8_t> emitted(face_count, 0);
+    std::vector<int> cache, cache_new;
+    cache.reserve(cache_size + 3);
+    cache_new.reserve(cache_size + 3);
+    std::vector<uint32_t> order;
+    order.reserve(face_count);
+    cluster_starts.clear();
+    size_t cursor = 0;
+    int64_t best = face_count ? 0 : -1;
+    if (best != -1)
+        cluster_starts.push_back(0);
+    while (best != -1) {
+        uint32_t f = static_cast<uint32_t>(best);
+        emitted[f] = 1;
+        order.push_back(f);
+
+        // Move the vertexes of the face to the front of the cache, and remove the face from their lists.
+        cache_new.clear();
+        for (int j = 0; j < 3; ++j) {
+            int v = indexes[f * 3 + j];
+            if (std::find(cache_new.begin(), cache_new.end(), v) == cache_new.end())
+                cache_new.push_back(v);
+            uint32_t* faces = &adjacency[offsets[v]];
+            for (uint32_t k = 0; k < live[v]; ++k)
+                if (faces[k] == f) {
+                    std::swap(faces[k], faces[--live[v]]);
+                    break;
+                }
+        }
+        for (int v : cache)
+            if (std::find(cache_new.begin(), cache_new.end(), v) == cache_new.end())
+                cache_new.push_back(v);
+        // Vertexes beyond the cache size are evicted, but their scores are updated once more.
+        for (size_t k = 0; k < cache_new.size(); ++k) {
+            int v = cache_new[k];
+            cache_positions[v] = k < size_t(cache_size) ? static_cast<int>(k) : -1;
+            vertex_scores[v] = vertex_score(cache_positions[v], live[v]);
+        }
+
+        // The best face around the cached vertexes.
+        best = -1;
+        float best_score = -1.f;
+        for (int v : cache_new)
+            for (uint32_t k = 0; k < live[v]; ++k) {
+                uint32_t g = adjacency[offsets[v] + k];
+                float score = vertex_scores[indexes[g * 3 + 0]] + vertex_scores[indexes[g * 3 + 1]] + vertex_scores[indexes[g * 3 + 2]];
+                if (score > best_score) {
+                    best = g;
+                    best_score = score;
+                }
+            }
+        if (cache_new.size() > size_t(cache_size))
+            cache_new.resize(cache_size);
+        cache.swap(cache_new);
+
+        if (best == -1) {
+            while (cursor < face_count && emitted[cursor])
+                ++cursor;
+            if (cursor < face_count) {
+                best = static_cast<int64_t>(cursor);
+                cluster_starts.push_back(static_cast<uint32_t>(order.size()));
+            }
+        }
+    }
+    return order;
+}
+
+// Move the clusters of `order` that face away from the center of the mesh to the front, since they are likely to occlude
+// the others. This is the overdraw pass of Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw",
+// 2007, which keeps the order inside each cluster. Clusters are split further wherever the faces so far, drawn from a cold
+// FIFO cache of `cache_size` vertexes, miss at most 5% more often than the whole cluster does, so reordering them costs
+// little vertex reuse. Returns the cluster count.
+size_t SortClustersForOverdraw(std::vector<uint32_t>& order, const std::vector<uint32_t>& hard_cluster_starts,
+    const std::vector<int>& indexes, const std::vector<glm::vec3>& positions, size_t cache_size)
+{
+    const float threshold = 1.05f;
+    std::vector<size_t> inserted(positions.size(), 0);
+    size_t time = cache_size + 1;
+    auto misses = [&](uint32_t f) {
+        size_t count = 0;
         for (int j = 0; j < 3; ++j) {
-            vertex_indexes_[i * 3 + j] = vertex2index[faces[i]->v[j]];
-            smooth_normal_indexes_[i * 3 + j] = vertex2index[faces[i]->v[j]];
+            int v = indexes[f * 3 + j];
+            if (time - inserted[v] > cache_size) {
+                inserted[v] = time++;
+                ++count;
+            }
         }
-    indexed_flat_normals_.resize(faces.size());
+        return count;
+    };
+    std::vector<uint32_t> cluster_starts;
+    for (size_t c = 0; c < hard_cluster_starts.size(); ++c) {
+        size_t begin = hard_cluster_starts[c];
+        size_t end = c + 1 < hard_cluster_starts.size() ? hard_cluster_starts[c + 1] : order.size();
+        // Flushing the cache is skipping its size in time.
+        time += cache_size + 1;
+        size_t cluster_misses = 0;
+        for (size_t k = begin; k < end; ++k)
+            cluster_misses += misses(order[k]);
+        float limit = threshold * float(cluster_misses) / float(end - begin);
+
+        time += cache_size + 1;
+        cluster_starts.push_back(static_cast<uint32_t>(begin));
+        size_t start = begin, start_misses = 0;
+        for (size_t k = begin; k + 1 < end; ++k) {
+            start_misses += misses(order[k]);
+            if (float(start_misses) <= limit * float(k + 1 - start)) {
+                cluster_starts.push_back(static_cast<uint32_t>(k + 1));
+                start = k + 1;
+                start_misses = 0;
+                time += cache_size + 1;
+            }
+        }
+    }
 
-    // Unindexd vertexes and normals.
-    unindexed_positions_.resize(faces.size() * 3);
-    unindexed_smooth_normals_.resize(faces.size() * 3);
-    unindexed_flat_normals_.resize(faces.size() * 3);
-    for (size_t i = 0; i < faces.size(); i++) {
-        glm::vec3 normal_flat = glm::normalize(glm::cross(
-            faces[i]->v[1]->p - faces[i]->v[0]->p,
-            faces[i]->v[2]->p - faces[i]->v[1]->p));
-        for (int j = 0; j < 3; j++) {
-            unindexed_positions_[i * 3 + j] = faces[i]->v[j]->p;
-            unindexed_smooth_normals_[i * 3 + j] = smooth_normals[vertex2index[faces[i]->v[j]]];
-            unindexed_flat_normals_[i * 3 + j] = normal_flat;
-            flat_normal_indexes_[i * 3 + j] = static_cast<int>(i);
+    size_t cluster_count = cluster_starts.size();
+    if (cluster_count < 2)
+        return cluster_count;
+
+    // Area weighted centroids and normals.
+    std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.f)), normals(cluster_count, glm::vec3(0.f));
+    std::vector<float> areas(cluster_count, 0.f);
+    glm::vec3 mesh_centroid(0.f);
+    float mesh_area = 0.f;
+    for (size_t c = 0; c < cluster_count; ++c) {
+        size_t end = c + 1 < cluster_count ? cluster_starts[c + 1] : order.size();
+        for (size_t k = cluster_starts[c]; k < end; ++k) {
+            const glm::vec3& p0 = positions[indexes[order[k] * 3 + 0]];
+            const glm::vec3& p1 = positions[indexes[order[k] * 3 + 1]];
+            const glm::vec3& p2 = positions[indexes[order[k] * 3 + 2]];
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(n);
+            centroids[c] += (p0 + p1 + p2) * (area / 3.f);
+            normals[c] += n;
+            areas[c] += area;
         }
-        indexed_flat_normals_[i] = normal_flat;
+        mesh_centroid += centroids[c];
+        mesh_area += areas[c];
+        if (areas[c] > 0.f)
+            centroids[c] /= areas[c];
     }
+    if (mesh_area > 0.f)
+        mesh_centroid /= mesh_area;
+
+    std::vector<float> keys(cluster_count);
+    std::vector<uint32_t> clusters(cluster_count);
+    for (size_t c = 0; c < cluster_count; ++c) {
+        keys[c] = glm::dot(centroids[c] - mesh_centroid, normals[c]);
+        clusters[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [&](uint32_t a, uint32_t b) {
+        return keys[a] > keys[b];
+    });
 
-    indexed_smooth_normals_ = std::move(smooth_normals);
+    std::vector<uint32_t> sorted;
+    sorted.reserve(order.size());
+    for (uint32_t c : clusters) {
+        size_t end = c + 1 < cluster_count ? cluster_starts[c + 1] : order.size();
+        sorted.insert(sorted.end(), order.begin() + cluster_starts[c], order.begin() + end);
+    }
+    order.swap(sorted);
+    return cluster_count;
+}
+
+void Subface::ReorderOutputs(const std::vector<Vertex*>& vertexes)
+{
+    std::string func_name = fmt::format("LoopSubface::ReorderOutputs(faces={})", vertex_indexes_.size() / 3);
+    Timer timer(func_name);
+
+    // Measured on a typical FIFO post-transform cache.
+    const size_t cache_size = 16;
+    size_t vertex_count = indexed_positions_.size();
+    float acmr_old = AverageCacheMissRatio(vertex_indexes_, vertex_count, cache_size);
+
+    std::vector<uint32_t> cluster_starts;
+    std::vector<uint32_t> order = OptimizeFaceOrderForCache(vertex_indexes_, vertex_count, cluster_starts);
+    size_t cluster_count = SortClustersForOverdraw(order, cluster_starts, vertex_indexes_, indexed_positions_, cache_size);
+    auto reorder_faces = [&](std::vector<int>& indexes) {
+        std::vector<int> reordered(indexes.size());
+        ParallelFor(order.size(), thread_count_, [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; ++i)
+                for (int j = 0; j < 3; ++j)
+                    reordered[i * 3 + j] = indexes[order[i] * 3 + j];
+        });
+        indexes.swap(reordered);
+    };
+    reorder_faces(vertex_indexes_);
+    if (!attribute_indexes_.empty())
+        reorder_faces(attribute_indexes_);
+
+    // Renumber the vertexes and the attributes in the order the faces first use them. Unused ones are dropped.
+    auto fetch_remap = [](std::vector<int>& indexes, size_t count, std::vector<unsigned int>& remap) {
+        remap.resize(count);
+        // `int` and `unsigned int` may alias each other.
+        size_t unique_count = meshopt_optimizeVertexFetchRemap(remap.data(), reinterpret_cast<const unsigned int*>(indexes.data()), indexes.size(), count);
+        for (int& index : indexes)
+            index = static_cast<int>(remap[index]);
+        return unique_count;
+    };
+    auto apply_remap = [](const std::vector<unsigned int>& remap, size_t unique_count, auto& values) {
+        std::remove_reference_t<decltype(values)> remapped(unique_count);
+        for (size_t i = 0; i < remap.size(); ++i)
+            if (remap[i] != ~0u)
+                remapped[remap[i]] = values[i];
+        values.swap(remapped);
+    };
+    std::vector<unsigned int> remap;
+    size_t unique_count = fetch_remap(vertex_indexes_, vertex_count, remap);
+    apply_remap(remap, unique_count, indexed_positions_);
+    apply_remap(remap, unique_count, indexed_smooth_normals_);
+    for (size_t v = 0; v < vertexes.size(); ++v)
+        vertexes[v]->index = remap[v];
+    if (!attribute_indexes_.empty()) {
+        unique_count = fetch_remap(attribute_indexes_, indexed_attributes_.size(), remap);
+        apply_remap(remap, unique_count, indexed_attributes_);
+    }
+
+    spdlog::info("{}: ACMR {:.3f} -> {:.3f}, {} clusters sorted for overdraw, {} -> {} vertexes", func_name,
+        acmr_old, AverageCacheMissRatio(vertex_indexes_, indexed_positions_.size(), cache_size), cluster_count,
+        vertex_count, indexed_positions_.size());
+}
+
+// Expand per-vertex or per-attribute values to per-corner `result`, as `result[i] = value(i, indexes[i])`.
+template <typename T, typename Index, typename Func>
+void ExpandCorners(T* result, const std::vector<Index>& indexes, int thread_count, const Func& value)
+{
+    ParallelFor(indexes.size(), thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            result[i] = value(i, indexes[i]);
+    });
+}
+
+template <typename T, typename Index, typename Func>
+void ExpandCorners(std::vector<T>& result, const std::vector<Index>& indexes, int thread_count, const Func& value)
+{
+    result.resize(indexes.size());
+    ExpandCorners(result.data(), indexes, thread_count, value);
+}
+
+// Expand into the memory mapped by `sink`. Returns false if the sink refuses the output.
+template <typename T, typename Index, typename Func>
+bool ExpandCorners(OutputSink<T>& sink, const std::vector<Index>& indexes, int thread_count, const Func& value)
+{
+    T* result = sink.Map(indexes.size());
+    if (!result && !indexes.empty())
+        return false;
+    ExpandCorners(result, indexes, thread_count, value);
+    sink.Unmap();
+    return true;
+}
+
+const std::vector<glm::vec3>& Subface::Position() const
+{
+    if (unindexed_positions_.empty())
+        ExpandCorners(unindexed_positions_, vertex_indexes_, thread_count_, [&](size_t, int v) {
+            return indexed_positions_[v];
+        });
+    return unindexed_positions_;
+}
+
+const std::vector<glm::vec3>& Subface::NormalSmooth() const
+{
+    if (unindexed_smooth_normals_.empty())
+        ExpandCorners(unindexed_smooth_normals_, vertex_indexes_, thread_count_, [&](size_t, int v) {
+            return indexed_smooth_normals_[v];
+        });
+    return unindexed_smooth_normals_;
+}
+
+const std::vector<glm::vec3>& Subface::IndexedNormalFlat() const
+{
+    if (indexed_flat_normals_.empty()) {
+        indexed_flat_normals_.resize(vertex_indexes_.size() / 3);
+        ParallelFor(indexed_flat_normals_.size(), thread_count_, [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; ++i) {
+                const glm::vec3& p0 = indexed_positions_[vertex_indexes_[i * 3 + 0]];
+                const glm::vec3& p1 = indexed_positions_[vertex_indexes_[i * 3 + 1]];
+                const glm::vec3& p2 = indexed_positions_[vertex_indexes_[i * 3 + 2]];
+                indexed_flat_normals_[i] = glm::normalize(glm::cross(p1 - p0, p2 - p1));
+            }
+        });
+    }
+    return indexed_flat_normals_;
+}
+
+const std::vector<glm::vec3>& Subface::NormalFlat() const
+{
+    if (unindexed_flat_normals_.empty()) {
+        const std::vector<glm::vec3>& flat_normals = IndexedNormalFlat();
+        ExpandCorners(unindexed_flat_normals_, vertex_indexes_, thread_count_, [&](size_t i, int) {
+            return flat_normals[i / 3];
+        });
+    }
+    return unindexed_flat_normals_;
+}
+
+const std::vector<glm::vec2>& Subface::UV() const
+{
+    if (unindexed_uvs_.empty() && carry_uvs_)
+        ExpandCorners(unindexed_uvs_, attribute_indexes_, thread_count_, [&](size_t, int a) {
+            return indexed_attributes_[a].uv;
+        });
+    return unindexed_uvs_;
+}
+
+const std::vector<glm::vec3>& Subface::NormalAttribute() const
+{
+    if (unindexed_attribute_normals_.empty() && carry_normals_)
+        ExpandCorners(unindexed_attribute_normals_, attribute_indexes_, thread_count_, [&](size_t, int a) {
+            return indexed_attributes_[a].normal;
+        });
+    return unindexed_attribute_normals_;
+}
+
+// The sinks skip the caches. An output that is cached already is copied from the cache instead of being expanded again.
+
+bool Subface::WritePosition(OutputSink<glm::vec3>& sink) const
+{
+    if (!unindexed_positions_.empty())
+        return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t i, int) {
+            return unindexed_positions_[i];
+        });
+    return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t, int v) {
+        return indexed_positions_[v];
+    });
+}
+
+bool Subface::WriteNormalSmooth(OutputSink<glm::vec3>& sink) const
+{
+    if (!unindexed_smooth_normals_.empty())
+        return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t i, int) {
+            return unindexed_smooth_normals_[i];
+        });
+    return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t, int v) {
+        return indexed_smooth_normals_[v];
+    });
+}
+
+bool Subface::WriteNormalFlat(OutputSink<glm::vec3>& sink) const
+{
+    // The per-face normals are a third of the size, so they are cached.
+    const std::vector<glm::vec3>& flat_normals = IndexedNormalFlat();
+    return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t i, int) {
+        return flat_normals[i / 3];
+    });
+}
+
+bool Subface::WriteIndexedPosition(OutputSink<glm::vec3>& sink) const
+{
+    return ExpandCorners(sink, indexed_positions_, thread_count_, [&](size_t, const glm::vec3& p) {
+        return p;
+    });
+}
+
+bool Subface::WriteIndexedNormalSmooth(OutputSink<glm::vec3>& sink) const
+{
+    return ExpandCorners(sink, indexed_smooth_normals_, thread_count_, [&](size_t, const glm::vec3& n) {
+        return n;
+    });
+}
+
+bool Subface::WriteIndex(OutputSink<uint32_t>& sink) const
+{
+    return ExpandCorners(sink, vertex_indexes_, thread_count_, [&](size_t, int v) {
+        return static_cast<uint32_t>(v);
+    });
+}
+
+bool Subface::TakeIndexedChanges(std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners)
+{
+    vertexes.clear();
+    corners.clear();
+    if (outputs_replaced_) {
+        outputs_replaced_ = false;
+        return false;
+    }
+    vertexes.swap(changed_vertexes_);
+    corners.swap(changed_corners_);
+    return true;
 }
 
 bool Subface::CheckLevel(const std::string& func_name, int level, int base)
@@ -431,26 +1109,199 @@ bool Subface::CheckLevel(const std::string& func_name, int level, int base)
     return false;
 }
 
-void Subface::LoopSubdivide(int level, bool flat, bool compute_limit)
-{
-    std::string func_name = fmt::format("LoopSubface::LoopSubdivide(level={}, flat={}, compute_limit={})", level, flat, compute_limit);
-    Timer timer(func_name);
+// Interpolates face-varying attributes for subdivision and tessellation, appending the new attributes to `attributes`.
+// Each new corner is interpolated from the corners of its parent face, so the corners on both sides of a seam keep their own values.
+// Midpoints of the same 2 attributes are shared, so the corners of a new vertex on an edge without a seam get one attribute.
+// `EdgePoint()` and `VertexPoints()` weigh the attributes with the Loop stencils of `Subface::EdgePoint()` and `Subface::VertexPoint()`
+// instead, with seams treated as boundaries: attributes on a seam only mix with the attributes along it on the same side.
+class AttributeInterpolator {
+    std::vector<CornerAttribute>& attributes_;
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints_;
+    // Edge points of the edges without a seam, by their 2 faces.
+    std::map<std::pair<const Face*, const Face*>, uint32_t> edge_points_;
+
+    uint32_t Add(glm::vec3 normal, glm::vec2 uv)
+    {
+        float length = glm::length(normal);
+        attributes_.push_back({ length > 0.f ? normal / length : normal, uv });
+        return static_cast<uint32_t>(attributes_.size() - 1);
+    }
+    // Weighted sum of (weight, attribute) pairs.
+    uint32_t Weigh(const std::vector<std::pair<float, uint32_t>>& weights)
+    {
+        glm::vec3 normal(0.f);
+        glm::vec2 uv(0.f);
+        for (const auto& w : weights) {
+            normal += w.first * attributes_[w.second].normal;
+            uv += w.first * attributes_[w.second].uv;
+        }
+        return Add(normal, uv);
+    }
+    // Attribute of `vertex` in `f`.
+    static uint32_t At(const Face* f, const Vertex* vertex)
+    {
+        return f->attributes[f->VertexId(vertex)];
+    }
 
-    if (CheckLevel(func_name, level, 4))
-        return;
+public:
+    explicit AttributeInterpolator(std::vector<CornerAttribute>& attributes)
+        : attributes_(attributes)
+    {
+    }
 
-    level_ = level;
+    uint32_t Midpoint(uint32_t a, uint32_t b)
+    {
+        if (a == b)
+            return a;
+        std::pair<uint32_t, uint32_t> key(std::min(a, b), std::max(a, b));
+        auto it = midpoints_.find(key);
+        if (it != midpoints_.end())
+            return it->second;
+        uint32_t m = Add((attributes_[a].normal + attributes_[b].normal) * 0.5f, (attributes_[a].uv + attributes_[b].uv) * 0.5f);
+        midpoints_.emplace(key, m);
+        return m;
+    }
+    uint32_t Center(uint32_t a, uint32_t b, uint32_t c)
+    {
+        if (a == b && b == c)
+            return a;
+        return Add((attributes_[a].normal + attributes_[b].normal + attributes_[c].normal) / 3.f,
+            (attributes_[a].uv + attributes_[b].uv + attributes_[c].uv) / 3.f);
+    }
 
-    // Ptrs of base vertexes and faces for the current level.
-    std::vector<Vertex*> vertexes_base(vertexes_.size());
-    std::vector<Face*> faces_base(faces_.size());
-    for (size_t i = 0; i < vertexes_.size(); i++)
-        vertexes_base[i] = &vertexes_[i];
-    for (size_t i = 0; i < faces_.size(); i++)
-        faces_base[i] = &faces_[i];
+    // Attribute of the corner of `f` at the vertex added on edge `vi`. 3/8 for the ends and 1/8 for the opposite corners if both
+    // faces have the same attributes on the edge, else the midpoint of the ends on each side.
+    uint32_t EdgePoint(const Face* f, int vi)
+    {
+        const Vertex *v0 = f->v[vi], *v1 = f->v[NEXT(vi)];
+        uint32_t a = f->attributes[vi], b = f->attributes[NEXT(vi)];
+        const Face* fn = f->neighbors[vi];
+        if (!fn || At(fn, v0) != a || At(fn, v1) != b)
+            return Midpoint(a, b);
+
+        std::pair<const Face*, const Face*> key(std::min(f, fn), std::max(f, fn));
+        auto it = edge_points_.find(key);
+        if (it != edge_points_.end())
+            return it->second;
+        uint32_t c = f->attributes[PREV(vi)], d = At(fn, fn->OtherVertex(v0, v1));
+        uint32_t m = Weigh({ { 3.f / 8.f, a }, { 3.f / 8.f, b }, { 1.f / 8.f, c }, { 1.f / 8.f, d } });
+        edge_points_.emplace(key, m);
+        return m;
+    }
 
-    MemoryPool mp;
+    // Set the attributes of the corners of the children of the faces around `v` at `v->child`. The faces around `v` are split into
+    // sectors where the attribute at `v` changes. Off the boundary and without sectors, `v` gets (1-Valence*Beta) of its attribute and
+    // (Beta) of each neighbor, averaged over the 2 faces of the edge. Else each sector gets 3/4 of its attribute and 1/8 of each of the
+    // 2 neighbors on the seams or the boundary edges around it.
+    void VertexPoints(const Vertex* v, float beta)
+    {
+        std::vector<const Face*> sweep = v->OneSweep();
+        size_t n = sweep.size();
+        // `ring[i]` and `ring[i + 1]` are the neighbors on the edges of `sweep[i]` at `v`. Off the boundary, `ring[n]` is `ring[0]`.
+        std::vector<const Vertex*> ring(n + 1, nullptr);
+        for (size_t i = v->boundary ? 1 : 0; i < n; ++i) {
+            const Face *f = sweep[(i + n - 1) % n], *g = sweep[i];
+            for (int k = 0; k < 3; ++k)
+                if (f->v[k] != v && g->VertexId(f->v[k]) >= 0)
+                    ring[i] = f->v[k];
+        }
+        if (v->boundary)
+            ring[0] = n > 1 ? sweep[0]->OtherVertex(v, ring[1]) : sweep[0]->NextVertex(v);
+        ring[n] = v->boundary ? sweep[n - 1]->OtherVertex(v, ring[n - 1]) : ring[0];
+
+        auto set = [&](size_t i, uint32_t attribute) {
+            int vi = sweep[i]->VertexId(v);
+            sweep[i]->children[vi]->attributes[vi] = attribute;
+        };
+
+        std::vector<size_t> cuts;
+        if (v->boundary)
+            cuts.push_back(0);
+        for (size_t i = v->boundary ? 1 : 0; i < n; ++i)
+            if (At(sweep[(i + n - 1) % n], v) != At(sweep[i], v))
+                cuts.push_back(i);
+
+        if (cuts.empty()) {
+            std::vector<std::pair<float, uint32_t>> weights { { 1.f - n * beta, At(sweep[0], v) } };
+            for (size_t i = 0; i < n; ++i) {
+                weights.push_back({ beta * 0.5f, At(sweep[(i + n - 1) % n], ring[i]) });
+                weights.push_back({ beta * 0.5f, At(sweep[i], ring[i]) });
+            }
+            uint32_t attribute = Weigh(weights);
+            for (size_t i = 0; i < n; ++i)
+                set(i, attribute);
+            return;
+        }
+
+        for (size_t j = 0; j < cuts.size(); ++j) {
+            // Sector of `sweep[first]` to `sweep[end - 1]`, wrapping around off the boundary.
+            size_t first = cuts[j], end = j + 1 < cuts.size() ? cuts[j + 1] : (v->boundary ? n : cuts[0] + n);
+            const Face *f_first = sweep[first], *f_last = sweep[(end - 1) % n];
+            uint32_t attribute = Weigh({ { 3.f / 4.f, At(f_first, v) }, { 1.f / 8.f, At(f_first, ring[first]) },
+                { 1.f / 8.f, At(f_last, ring[end > n ? end - n : end]) } });
+            for (size_t i = first; i < end; ++i)
+                set(i % n, attribute);
+        }
+    }
+};
+
+glm::vec3 Subface::VertexPoint(Vertex* v, bool flat)
+{
+    if (flat)
+        return v->p;
+    if (!v->boundary) {
+        //   \ /   //
+        // -- * -- //
+        //   / \   //
+        // (1-6*1/16) for the center vertex, (1/16) for each of the 6 neighbor vertexes.
+        if (v->regular)
+            return WeightOneRing(v, 1.f / 16.f);
+        // (1-Valence*Beta) for the center vertex, (Beta) for each of the Valence neighbor vertexes.
+        else
+            return WeightOneRing(v, Beta(v->valence));
+    } else {
+        //      0 ... 0      //
+        //       \.../       //
+        // 1/8 -- 3/4 -- 1/8 //
+        // Only the boundary vertexes are used.
+        return WeightBoundary(v, 1.f / 8.f);
+    }
+}
+
+glm::vec3 Subface::EdgePoint(const Face* f, int vi, bool flat)
+{
+    Edge e(f->v[vi], f->v[NEXT(vi)]);
+    glm::vec3 p;
+    if (flat || f->neighbors[vi] == nullptr) {
+        p = 0.5f * e.v[0]->p;
+        p += 0.5f * e.v[1]->p;
+    } else {
+        //     *   //
+        //    / \  //
+        //   *-O-* //
+        //    \ /  //
+        //     *   //
+        //
+        //    1/8    //
+        //    / \    //
+        // 3/8 - 3/8 //
+        //    \ /    //
+        //    1/8    //
+        p = 3.f / 8.f * e.v[0]->p;
+        p += 3.f / 8.f * e.v[1]->p;
+        p += 1.f / 8.f
+            * f->OtherVertex(e.v[0], e.v[1])->p;
+        p += 1.f / 8.f
+            * f->neighbors[vi]->OtherVertex(e.v[0], e.v[1])->p;
+    }
+    return p;
+}
+
+void Subface::LoopSubdivideLevels(int level, bool flat, bool carry_attributes, MemoryPool& mp,
+    std::vector<Vertex*>& vertexes_base, std::vector<Face*>& faces_base)
+{
     for (int l = 0; l < level; ++l) {
+        AttributeInterpolator interpolator(attributes_);
         std::vector<Vertex*> vertexes_new;
         std::vector<Face*> faces_new(faces_base.size() * 4);
 
@@ -469,27 +1320,7 @@ void Subface::LoopSubdivide(int level, bool flat, bool compute_limit)
 
         // Update new base vertexes.
         for (auto& v : vertexes_base)
-            if (flat) {
-                v->child->p = v->p;
-            } else {
-                if (!v->boundary) {
-                    //   \ /   //
-                    // -- * -- //
-                    //   / \   //
-                    // (1-6*1/16) for the center vertex, (1/16) for each of the 6 neighbor vertexes.
-                    if (v->regular)
-                        v->child->p = WeightOneRing(v, 1.f / 16.f);
-                    // (1-Valence*Beta) for the center vertex, (Beta) for each of the Valence neighbor vertexes.
-                    else
-                        v->child->p = WeightOneRing(v, Beta(v->valence));
-                } else {
-                    //      0 ... 0      //
-                    //       \.../       //
-                    // 1/8 -- 3/4 -- 1/8 //
-                    // Only the boundary vertexes are used.
-                    v->child->p = WeightBoundary(v, 1.f / 8.f);
-                }
-            }
+            v->child->p = VertexPoint(v, flat);
 
         // Add a new sub-vertex on each edge.
         std::map<Edge, Vertex*> edge2vertex;
@@ -507,28 +1338,7 @@ void Subface::LoopSubdivide(int level, bool flat, bool compute_limit)
                     v->valence = v->boundary ? 4 : 6;
                     v->start_face = f->children[vi];
 
-                    if (flat || v->boundary) {
-                        v->p = 0.5f * e.v[0]->p;
-                        v->p += 0.5f * e.v[1]->p;
-                    } else {
-                        //     *   //
-                        //    / \  //
-                        //   *-O-* //
-                        //    \ /  //
-                        //     *   //
-                        //
-                        //    1/8    //
-                        //    / \    //
-                        // 3/8 - 3/8 //
-                        //    \ /    //
-                        //    1/8    //
-                        v->p = 3.f / 8.f * e.v[0]->p;
-                        v->p += 3.f / 8.f * e.v[1]->p;
-                        v->p += 1.f / 8.f
-                            * f->OtherVertex(e.v[0], e.v[1])->p;
-                        v->p += 1.f / 8.f
-                            * f->neighbors[vi]->OtherVertex(e.v[0], e.v[1])->p;
-                    }
+                    v->p = EdgePoint(f, vi, flat);
                     edge2vertex[e] = v;
                 }
             }
@@ -571,26 +1381,62 @@ void Subface::LoopSubdivide(int level, bool flat, bool compute_limit)
                     f->children[NEXT(ci)]->v[ci] = vertex;
                     f->children[3]->v[ci] = vertex;
                 }
+                // Interpolate new sub-faces' attributes along the same stencils as the positions, or linearly if `flat==true`.
+                if (carry_attributes) {
+                    // Kept by the corners `VertexPoints()` doesn't reach, e.g. on the other fans of a non-manifold vertex.
+                    f->children[ci]->attributes[ci] = f->attributes[ci];
+
+                    uint32_t attribute = flat ? interpolator.Midpoint(f->attributes[ci], f->attributes[NEXT(ci)])
+                                              : interpolator.EdgePoint(f, ci);
+                    f->children[ci]->attributes[NEXT(ci)] = attribute;
+                    f->children[NEXT(ci)]->attributes[ci] = attribute;
+                    f->children[3]->attributes[ci] = attribute;
+                }
             }
         }
+        if (carry_attributes && !flat)
+            for (auto& v : vertexes_base)
+                interpolator.VertexPoints(v, v->boundary ? 0.f : Beta(v->valence));
 
         // All updates done. Replace the base with the new for further subdivisions.
         vertexes_base = std::move(vertexes_new);
         faces_base = std::move(faces_new);
     }
+}
 
-    if (!flat && level && compute_limit) {
-        std::vector<glm::vec3> limit(vertexes_base.size());
-        for (size_t i = 0; i < vertexes_base.size(); ++i)
-            if (vertexes_base[i]->boundary)
-                limit[i] = WeightBoundary(vertexes_base[i], 1.f / 5.f);
-            else
-                limit[i] = WeightOneRing(vertexes_base[i], LoopGamma(vertexes_base[i]->valence));
-        for (size_t i = 0; i < vertexes_base.size(); ++i)
-            vertexes_base[i]->p = limit[i];
+void Subface::LoopSubdivide(int level, bool flat, bool compute_limit)
+{
+    std::string func_name = fmt::format("LoopSubface::LoopSubdivide(level={}, flat={}, compute_limit={})", level, flat, compute_limit);
+    Timer timer(func_name);
+
+    if (CheckLevel(func_name, level, 4))
+        return;
+
+    level_ = level;
+
+    bool carry_attributes = carry_normals_ || carry_uvs_;
+    attributes_ = origin_attributes_;
+
+    // Ptrs of base vertexes and faces for the current level.
+    std::vector<Vertex*> vertexes_base;
+    std::vector<Face*> faces_base;
+    ResetBase(vertexes_base, faces_base);
+
+    MemoryPool mp;
+    LoopSubdivideLevels(level, flat, carry_attributes, mp, vertexes_base, faces_base);
+
+    if (!flat && level && compute_limit) {
+        std::vector<glm::vec3> limit(vertexes_base.size());
+        for (size_t i = 0; i < vertexes_base.size(); ++i)
+            if (vertexes_base[i]->boundary)
+                limit[i] = WeightBoundary(vertexes_base[i], 1.f / 5.f);
+            else
+                limit[i] = WeightOneRing(vertexes_base[i], LoopGamma(vertexes_base[i]->valence));
+        for (size_t i = 0; i < vertexes_base.size(); ++i)
+            vertexes_base[i]->p = limit[i];
     }
 
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    ComputeNormalsAndPositions(vertexes_base, faces_base, carry_attributes);
 
     spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
 }
@@ -605,13 +1451,14 @@ void Subface::Tessellate3(int level)
 
     level_ = level;
 
+    bool carry_attributes = carry_normals_ || carry_uvs_;
+    attributes_ = origin_attributes_;
+    AttributeInterpolator interpolator(attributes_);
+
     // Ptrs of base vertexes and faces for the current level.
-    std::vector<Vertex*> vertexes_base(vertexes_.size());
-    std::vector<Face*> faces_base(faces_.size());
-    for (size_t i = 0; i < vertexes_.size(); i++)
-        vertexes_base[i] = &vertexes_[i];
-    for (size_t i = 0; i < faces_.size(); i++)
-        faces_base[i] = &faces_[i];
+    std::vector<Vertex*> vertexes_base;
+    std::vector<Face*> faces_base;
+    ResetBase(vertexes_base, faces_base);
 
     MemoryPool mp;
     for (int l = 0; l < level; ++l) {
@@ -657,6 +1504,7 @@ void Subface::Tessellate3(int level)
         // Update new sub-faces.
         for (size_t fi = 0; fi < faces_base.size(); ++fi) {
             Face* f = faces_base[fi];
+            uint32_t center_attribute = carry_attributes ? interpolator.Center(f->attributes[0], f->attributes[1], f->attributes[2]) : 0;
             for (int ci = 0; ci < 3; ++ci) {
                 // Update new sub-faces' neighbors.
                 {
@@ -680,6 +1528,12 @@ void Subface::Tessellate3(int level)
                     f->children[ci]->v[NEXT(ci)] = f->v[NEXT(ci)]->child;
                     f->children[ci]->v[PREV(ci)] = vertexes_new[vertexes_base.size() + fi];
                 }
+                // Interpolate new sub-faces' attributes linearly.
+                if (carry_attributes) {
+                    f->children[ci]->attributes[ci] = f->attributes[ci];
+                    f->children[ci]->attributes[NEXT(ci)] = f->attributes[NEXT(ci)];
+                    f->children[ci]->attributes[PREV(ci)] = center_attribute;
+                }
             }
         }
 
@@ -688,7 +1542,7 @@ void Subface::Tessellate3(int level)
         faces_base = std::move(faces_new);
     }
 
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    ComputeNormalsAndPositions(vertexes_base, faces_base, carry_attributes);
 
     spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
 }
@@ -703,13 +1557,14 @@ void Subface::Tessellate4(int level)
 
     level_ = level;
 
+    bool carry_attributes = carry_normals_ || carry_uvs_;
+    attributes_ = origin_attributes_;
+    AttributeInterpolator interpolator(attributes_);
+
     // Ptrs of base vertexes and faces for the current level.
-    std::vector<Vertex*> vertexes_base(vertexes_.size());
-    std::vector<Face*> faces_base(faces_.size());
-    for (size_t i = 0; i < vertexes_.size(); i++)
-        vertexes_base[i] = &vertexes_[i];
-    for (size_t i = 0; i < faces_.size(); i++)
-        faces_base[i] = &faces_[i];
+    std::vector<Vertex*> vertexes_base;
+    std::vector<Face*> faces_base;
+    ResetBase(vertexes_base, faces_base);
 
     MemoryPool mp;
     for (int l = 0; l < level; ++l) {
@@ -790,6 +1645,15 @@ void Subface::Tessellate4(int level)
                     f->children[NEXT(ci)]->v[ci] = vertex;
                     f->children[3]->v[ci] = vertex;
                 }
+                // Interpolate new sub-faces' attributes linearly.
+                if (carry_attributes) {
+                    f->children[ci]->attributes[ci] = f->attributes[ci];
+
+                    uint32_t attribute = interpolator.Midpoint(f->attributes[ci], f->attributes[NEXT(ci)]);
+                    f->children[ci]->attributes[NEXT(ci)] = attribute;
+                    f->children[NEXT(ci)]->attributes[ci] = attribute;
+                    f->children[3]->attributes[ci] = attribute;
+                }
             }
         }
 
@@ -798,7 +1662,7 @@ void Subface::Tessellate4(int level)
         faces_base = std::move(faces_new);
     }
 
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    ComputeNormalsAndPositions(vertexes_base, faces_base, carry_attributes);
 
     spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
 }
@@ -813,13 +1677,14 @@ void Subface::Tessellate4_1(int level)
 
     level_ = level;
 
+    bool carry_attributes = carry_normals_ || carry_uvs_;
+    attributes_ = origin_attributes_;
+    AttributeInterpolator interpolator(attributes_);
+
     // Ptrs of base vertexes and faces for the current level.
-    std::vector<Vertex*> vertexes_base(vertexes_.size());
-    std::vector<Face*> faces_base(faces_.size());
-    for (size_t i = 0; i < vertexes_.size(); i++)
-        vertexes_base[i] = &vertexes_[i];
-    for (size_t i = 0; i < faces_.size(); i++)
-        faces_base[i] = &faces_[i];
+    std::vector<Vertex*> vertexes_base;
+    std::vector<Face*> faces_base;
+    ResetBase(vertexes_base, faces_base);
 
     MemoryPool mp;
     for (int l = 0; l < level; ++l) {
@@ -1027,6 +1892,20 @@ void Subface::Tessellate4_1(int level)
                 f->children[3]->v[1] = edge2vertex[e[1]];
                 f->children[3]->v[2] = f->v[2]->child;
             }
+            // Interpolate new sub-faces' attributes linearly, in the same pattern as the vertexes.
+            if (carry_attributes) {
+                uint32_t a[3];
+                for (int i = 0; i < 3; ++i)
+                    a[i] = interpolator.Midpoint(f->attributes[i], f->attributes[NEXT(i)]);
+                const uint32_t children_attributes[4][3] {
+                    { f->attributes[0], a[0], a[2] },
+                    { a[0], f->attributes[1], a[2] },
+                    { a[2], f->attributes[1], a[1] },
+                    { a[2], a[1], f->attributes[2] },
+                };
+                for (int ci = 0; ci < 4; ++ci)
+                    std::copy(children_attributes[ci], children_attributes[ci] + 3, f->children[ci]->attributes);
+            }
         }
 
         // All updates done. Replace the base with the new for further subdivisions.
@@ -1034,50 +1913,190 @@ void Subface::Tessellate4_1(int level)
         faces_base = std::move(faces_new);
     }
 
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    ComputeNormalsAndPositions(vertexes_base, faces_base, carry_attributes);
 
     spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
 }
 
-struct QueueEdge {
-    const Vertex* const v[2];
-    const float l;
-
-    QueueEdge(const Vertex* v0, const Vertex* v1)
-        : v { std::min(v0, v1), std::max(v0, v1) }
-        , l(glm::distance(v[0]->p, v[1]->p))
-    {
+// Area-weighted quadrics of the faces around each vertex.
+// Boundary edges add quadrics of planes perpendicular to their faces to keep the boundaries in place.
+std::vector<Quadric> ComputeQuadrics(const std::vector<Vertex>& vertexes, const std::vector<Face>& faces)
+{
+    const double boundary_weight = 10.0;
+
+    std::vector<Quadric> quadrics(vertexes.size());
+    const Vertex* base = vertexes.data();
+    for (const Face& f : faces) {
+        glm::dvec3 p[3] { glm::dvec3(f.v[0]->p), glm::dvec3(f.v[1]->p), glm::dvec3(f.v[2]->p) };
+        glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double area2 = glm::length(n);
+        if (area2 == 0.0)
+            continue;
+        n /= area2;
+
+        Quadric q = Quadric::Plane(n, -glm::dot(n, p[0]), area2 * 0.5);
+        for (int i = 0; i < 3; ++i)
+            quadrics[f.v[i] - base] += q;
+
+        for (int i = 0; i < 3; ++i)
+            if (f.neighbors[i] == nullptr) {
+                glm::dvec3 e = p[NEXT(i)] - p[i];
+                double length2 = glm::dot(e, e);
+                if (length2 == 0.0)
+                    continue;
+                glm::dvec3 bn = glm::normalize(glm::cross(e, n));
+                Quadric qb = Quadric::Plane(bn, -glm::dot(bn, p[i]), length2 * boundary_weight);
+                quadrics[f.v[i] - base] += qb;
+                quadrics[f.v[NEXT(i)] - base] += qb;
+            }
     }
+    return quadrics;
+}
 
-    bool operator<(const QueueEdge& qe) const
-    {
-        const std::array<void*, 2>& a = *reinterpret_cast<const std::array<void*, 2>*>(v);
-        const std::array<void*, 2>& b = *reinterpret_cast<const std::array<void*, 2>*>(qe.v);
-        return l < qe.l || (l == qe.l && a < b);
-    }
+// Vertexes whose faces form more than 1 fan, e.g. 2 cones touching at their apexes.
+// The traversal from `start_face` only reaches one of the fans, so their edges must not be collapsed.
+std::vector<uint8_t> NonManifoldVertexes(const std::vector<Vertex>& vertexes, const std::vector<Face>& faces)
+{
+    std::vector<uint32_t> face_counts(vertexes.size(), 0);
+    for (const Face& f : faces)
+        for (int i = 0; i < 3; ++i)
+            ++face_counts[f.v[i] - vertexes.data()];
+
+    std::vector<uint8_t> non_manifold(vertexes.size(), 0);
+    for (size_t i = 0; i < vertexes.size(); ++i)
+        if (vertexes[i].start_face) {
+            uint32_t traversed = 0;
+            vertexes[i].TraverseFaces([&](const Face*) {
+                ++traversed;
+            });
+            non_manifold[i] = traversed != face_counts[i];
+        }
+    return non_manifold;
+}
+
+// Cost and placement of edge collapses.
+struct EdgeCollapse {
+    // Cost of collapsing edge (v0, v1). Smaller costs are collapsed first.
+    std::function<float(const Vertex* v0, const Vertex* v1)> cost;
+    // Called when v1 is merged into v0. Updates v0 as the merged vertex.
+    std::function<void(Vertex* v0, Vertex* v1)> merge;
+    // Optional. Called after each collapse with the removed faces and the faces swept around v1, in which v1 is replaced by v0.
+    std::function<void(const Vertex* v0, const Vertex* v1, const std::vector<Face*>& removed, const std::vector<const Face*>& sweep)> record;
+    // Optional. Whether v1 may be merged into v0, e.g. to keep attribute seams.
+    std::function<bool(const Vertex* v0, const Vertex* v1)> allow;
+    // Whether `allow` may veto only one direction of an edge, so vetoed edges are tried in the other direction.
+    bool allow_reversed = false;
 };
 
-bool CollapseEdge(std::set<QueueEdge>& queue, size_t& decimate_face_count, size_t target_face_count, bool round_down, bool midpoint)
+// Whether merging v0 and v1 at `p` turns a face around them over, i.e. its normal to one at 90 degrees or more from the one before.
+// The faces of the edge, which the collapse removes, and the faces without area, which have no normal to keep, aren't checked.
+bool FlipsFaces(const Vertex* v0, const Vertex* v1, const glm::vec3& p)
 {
-    const QueueEdge collapse_e = *queue.begin();
+    bool flips = false;
+    auto check = [&](const Face* f) {
+        if (flips || (f->VertexId(v0) != -1 && f->VertexId(v1) != -1))
+            return;
+        glm::vec3 q[3];
+        for (int i = 0; i < 3; ++i)
+            q[i] = f->v[i] == v0 || f->v[i] == v1 ? p : f->v[i]->p;
+        glm::vec3 normal = glm::cross(f->v[1]->p - f->v[0]->p, f->v[2]->p - f->v[0]->p);
+        glm::vec3 merged_normal = glm::cross(q[1] - q[0], q[2] - q[0]);
+        flips = normal != glm::vec3(0.f) && glm::dot(normal, merged_normal) <= 0.f;
+    };
+    v0->TraverseFaces(check);
+    v1->TraverseFaces(check);
+    return flips;
+}
 
-    Vertex* v0 = const_cast<Vertex*>(collapse_e.v[0]);
-    Vertex* v1 = const_cast<Vertex*>(collapse_e.v[1]);
-    Vertex* v01[2] { v0, v1 };
+// Cost and placement by the quadric error metric. `quadrics` are of `vertexes` and must outlive the result.
+// Merging only writes the quadric of v0, so collapses of disjoint neighborhoods can merge concurrently.
+EdgeCollapse QuadricEdgeCollapse(const std::vector<Vertex>& vertexes, std::vector<Quadric>& quadrics)
+{
+    // Optimal position of the merged vertex, or the best of v0, v1 and their midpoint if the quadric is singular.
+    auto place = [&quadrics, base = vertexes.data()](const Vertex* v0, const Vertex* v1, double& error) {
+        Quadric q = quadrics[v0 - base] + quadrics[v1 - base];
+        glm::dvec3 p;
+        if (q.Optimal(p)) {
+            error = q.Error(p);
+            return p;
+        }
+        glm::dvec3 candidates[3] { glm::dvec3(v0->p), glm::dvec3(v1->p), (glm::dvec3(v0->p) + glm::dvec3(v1->p)) * 0.5 };
+        error = q.Error(candidates[0]);
+        p = candidates[0];
+        for (int i = 1; i < 3; ++i) {
+            double e = q.Error(candidates[i]);
+            if (e < error) {
+                error = e;
+                p = candidates[i];
+            }
+        }
+        return p;
+    };
 
-    std::vector<const Face*> sweep = v1->OneSweep();
-    int face_count_to_decimate_for_this_collapse = 0;
-    if (!round_down) {
-        for (const Face* f : sweep)
-            if (f->VertexId(v0) != -1)
-                ++face_count_to_decimate_for_this_collapse;
-        if (decimate_face_count - face_count_to_decimate_for_this_collapse < target_face_count)
-            return false;
-    }
-    queue.erase(queue.begin());
+    EdgeCollapse collapse;
+    collapse.cost = [place](const Vertex* v0, const Vertex* v1) {
+        double error;
+        place(v0, v1, error);
+        return static_cast<float>(error);
+    };
+    collapse.merge = [place, &quadrics, base = vertexes.data()](Vertex* v0, Vertex* v1) {
+        double error;
+        v0->p = glm::vec3(place(v0, v1, error));
+        quadrics[v0 - base] += quadrics[v1 - base];
+    };
+    // The optimal position may lie past the 1-ring, folding faces over. Keep such edges as they are.
+    collapse.allow = [place](const Vertex* v0, const Vertex* v1) {
+        double error;
+        return !FlipsFaces(v0, v1, glm::vec3(place(v0, v1, error)));
+    };
+    return collapse;
+}
+
+// Don't collapse the degenerated pieces the topology can't represent after the collapse. Keep them as they are.
+// 2 adjacent non-boundary vertexes of valence 3 form a closed tetrahedron, which would leave 2 faces sharing all their edges.
+// A non-boundary vertex of valence 2 is already such a pair of faces.
+// Besides, the vertexes adjacent to both v0 and v1 must be the opposite vertexes of the faces of the edge (the link condition),
+// the faces of the edge must have distinct opposite vertexes, and an interior edge can't connect 2 boundary vertexes. Otherwise the collapse pinches the surface into a non-manifold one,
+// around which the face traversal never gets back to `start_face`.
+bool Collapsible(const Vertex* v0, const Vertex* v1)
+{
+    auto degenerated = [](const Vertex* v) {
+        return !v->boundary && v->valence < 3;
+    };
+    if (degenerated(v0) || degenerated(v1) || (!v0->boundary && !v1->boundary && v0->valence == 3 && v1->valence == 3))
+        return false;
+
+    std::vector<const Vertex*> ring0, ring1, opposite;
+    v0->TraverseFaces([&](const Face* f) {
+        ring0.push_back(f->NextVertex(v0));
+        ring0.push_back(f->PrevVertex(v0));
+        if (f->VertexId(v1) != -1)
+            opposite.push_back(f->OtherVertex(v0, v1));
+    });
+    v1->TraverseFaces([&](const Face* f) {
+        ring1.push_back(f->NextVertex(v1));
+        ring1.push_back(f->PrevVertex(v1));
+    });
+    size_t edge_face_count = opposite.size();
+    if (v0->boundary && v1->boundary && edge_face_count != 1)
+        return false;
 
-    std::vector<const Vertex*> ring[2] { v0->OneRing(), v1->OneRing() };
+    for (std::vector<const Vertex*>* vs : { &ring0, &ring1, &opposite }) {
+        std::sort(vs->begin(), vs->end());
+        vs->erase(std::unique(vs->begin(), vs->end()), vs->end());
+    }
+    // 2 faces of the edge sharing the opposite vertex are a pillow.
+    if (edge_face_count > 2 || opposite.size() != edge_face_count)
+        return false;
+    std::vector<const Vertex*> common;
+    std::set_intersection(ring0.begin(), ring0.end(), ring1.begin(), ring1.end(), std::back_inserter(common));
+    return common == opposite;
+}
 
+// Collapse edge (v0, v1) on the topology, where `sweep` is `v1->OneSweep()`.
+// `queue` is kept up to date unless it's `nullptr`. Collapses touching disjoint one-rings can run concurrently without `queue`.
+void CollapseEdge(Vertex* v0, Vertex* v1, const std::vector<const Face*>& sweep, size_t& decimate_face_count, const EdgeCollapse& collapse, EdgeQueue* queue)
+{
     std::vector<Face*> collapse_f;
     std::vector<Vertex*> collapse_f_v;
 
@@ -1118,10 +2137,9 @@ bool CollapseEdge(std::set<QueueEdge>& queue, size_t& decimate_face_count, size_
             if (v2->start_face == f)
                 v2->start_face = fn[0] ? fn[0] : fn[1];
 
-            QueueEdge e(v1, v2);
-            auto e_it = queue.find(e);
-            if (e_it != queue.end())
-                queue.erase(e_it);
+            // Edge (v1, v2) merges into edge (v0, v2).
+            if (queue)
+                queue->Remove(queue->Find(v1, v2));
 
             // `Face::children[k]` are initialized as `nullptr`. Use the first child to flag deletion.
             f->children[0] = reinterpret_cast<Face*>(1);
@@ -1137,28 +2155,12 @@ bool CollapseEdge(std::set<QueueEdge>& queue, size_t& decimate_face_count, size_
         f->v[v1_id] = v0;
     }
 
-    if (midpoint) {
-        std::vector<const Vertex*> ring_remain;
-        for (int i = 0; i < 2; ++i)
-            for (auto v : ring[i]) {
-                auto e_it = queue.find({ v, v01[i] });
-                if (e_it != queue.end()) {
-                    queue.erase(e_it);
-                    ring_remain.push_back(v);
-                }
-            }
-        if (midpoint)
-            v0->p = (v0->p + v1->p) * 0.5f;
-        for (auto v : ring_remain)
-            queue.insert({ v, v0 });
-    } else {
-        for (auto v : ring[1]) {
-            auto e_it = queue.find({ v, v1 });
-            if (e_it != queue.end()) {
-                queue.erase(e_it);
-                queue.insert({ v, v0 });
-            }
-        }
+    // Re-target the remaining edges of v1 to v0 and update the costs of all the edges of the merged vertex.
+    collapse.merge(v0, v1);
+    if (queue) {
+        queue->Merge(v1, v0);
+        for (uint32_t e : queue->Incident(v0))
+            queue->Update(e, collapse.cost((*queue)[e].v[0], (*queue)[e].v[1]));
     }
 
     auto f_it = std::find(collapse_f.begin(), collapse_f.end(), v0->start_face);
@@ -1175,11 +2177,8 @@ bool CollapseEdge(std::set<QueueEdge>& queue, size_t& decimate_face_count, size_
         v0->ComputeStartFaceAndBoundary();
         v0->ComputeValence();
     } else {
-        for (auto v : ring[0]) {
-            auto e_it = queue.find({ v, v0 });
-            if (e_it != queue.end())
-                queue.erase(e_it);
-        }
+        if (queue)
+            queue->RemoveIncident(v0);
         v0->child = reinterpret_cast<Vertex*>(1);
     }
 
@@ -1189,45 +2188,101 @@ bool CollapseEdge(std::set<QueueEdge>& queue, size_t& decimate_face_count, size_
         if ((*v_it)->start_face && (*v_it)->start_face->children[0] == nullptr) {
             (*v_it)->ComputeValence();
         } else {
-            auto e_it = queue.find({ *v_it, v0 });
-            if (e_it != queue.end())
-                queue.erase(e_it);
+            // Delete all the edges with the degenerated v2.
+            if (queue)
+                queue->RemoveIncident(*v_it);
             (*v_it)->child = reinterpret_cast<Vertex*>(1);
-
-            /* Delete all the edges with the degenerated v2. */
-            // std::vector<QueueEdge> collapse_f_v_e;
-            // for (const QueueEdge& e : queue) {
-            //     // assert(e.v[0] != *v_it && e.v[1] != *v_it);
-            //     for (int i = 0; i < 2; ++i)
-            //         if (e.v[i] == *v_it) {
-            //             collapse_f_v_e.push_back(e);
-            //             break;
-            //         }
-            // }
-            // for (const QueueEdge& e : collapse_f_v_e)
-            //     queue.erase(e);
         }
 
     // `Vertex::child` is initialized as `nullptr`. Use it to flag deletion.
+    // All the edges of v1 have been merged into v0.
     v1->child = reinterpret_cast<Vertex*>(1);
 
-    /* Delete all the edges with the degenerated v0 and v1. */
-    // for (auto v : v01)
-    //     if (v->start_face == nullptr || v->start_face->children[0] || v->child) {
-    //         std::vector<QueueEdge> erase_e;
-    //         for (const QueueEdge& e : queue) {
-    //             // assert(e.v[0] != v && e.v[1] != v);
-    //             for (int i = 0; i < 2; ++i)
-    //                 if (e.v[i] == v) {
-    //                     erase_e.push_back(e);
-    //                     break;
-    //                 }
-    //         }
-    //         for (const QueueEdge& e : erase_e)
-    //             queue.erase(e);
-    //     }
-
-    return face_count_to_decimate_for_this_collapse;
+    if (collapse.record)
+        collapse.record(v0, v1, collapse_f, sweep);
+}
+
+// Collapse the cheapest edge in `queue`. Returns false if none is left or the collapse would pass `target_face_count`.
+// Edges that can't collapse yet are parked behind the others with an infinite cost, and tried again once a collapse changes the faces
+// around them.
+bool CollapseEdge(EdgeQueue& queue, size_t& decimate_face_count, size_t target_face_count, bool round_down, const EdgeCollapse& collapse)
+{
+    const float parked = std::numeric_limits<float>::infinity();
+    if (queue.Empty() || queue[queue.Top()].cost == parked)
+        return false;
+    const uint32_t collapse_e = queue.Top();
+
+    Vertex* v0 = queue[collapse_e].v[0];
+    Vertex* v1 = queue[collapse_e].v[1];
+
+    std::vector<const Face*> sweep = v1->OneSweep();
+    int face_count_to_decimate_for_this_collapse = 0;
+    if (!round_down) {
+        for (const Face* f : sweep)
+            if (f->VertexId(v0) != -1)
+                ++face_count_to_decimate_for_this_collapse;
+        if (decimate_face_count - face_count_to_decimate_for_this_collapse < target_face_count)
+            return false;
+    }
+
+    if (!Collapsible(v0, v1)) {
+        queue.Update(collapse_e, parked);
+        return true;
+    }
+    if (collapse.allow && !collapse.allow(v0, v1)) {
+        if (!collapse.allow_reversed || !collapse.allow(v1, v0)) {
+            queue.Update(collapse_e, parked);
+            return true;
+        }
+        std::swap(v0, v1);
+        sweep = v1->OneSweep();
+    }
+    queue.Remove(collapse_e);
+    CollapseEdge(v0, v1, sweep, decimate_face_count, collapse, &queue);
+
+    // The edges of v0 got their costs updated. The faces around the neighbors of v0 changed too, so the parked edges there may
+    // collapse now.
+    if (v0->child)
+        return true;
+    std::vector<const Vertex*> ring;
+    v0->TraverseFaces([&](const Face* f) {
+        ring.push_back(f->NextVertex(v0));
+        ring.push_back(f->PrevVertex(v0));
+    });
+    std::sort(ring.begin(), ring.end());
+    ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    for (const Vertex* v : ring)
+        for (uint32_t e : queue.Incident(v))
+            if (queue[e].cost == parked)
+                queue.Update(e, collapse.cost(queue[e].v[0], queue[e].v[1]));
+    return true;
+}
+
+void Subface::MeasureDeviation(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, float& to_origin, float& from_origin)
+{
+    if (!origin_bvh_)
+        origin_bvh_ = std::make_unique<TriangleBvh>(origin_positions_, origin_indexes_);
+    TriangleBvh bvh(positions, indexes);
+    to_origin = OneSidedHausdorff(positions, indexes, *origin_bvh_, thread_count_);
+    from_origin = OneSidedHausdorff(origin_positions_, origin_indexes_, bvh, thread_count_);
+}
+
+float Subface::Deviation(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes)
+{
+    float to_origin = 0.f, from_origin = 0.f;
+    MeasureDeviation(positions, indexes, to_origin, from_origin);
+    return std::max(to_origin, from_origin);
+}
+
+void Subface::ReportDeviation(const std::string& func_name, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes)
+{
+    if (!report_error_ && max_error_ <= 0.f)
+        return;
+
+    float to_origin = 0.f, from_origin = 0.f;
+    MeasureDeviation(positions, indexes, to_origin, from_origin);
+    spdlog::info("{}: Hausdorff distance {} (result to original {}, original to result {}), max error {}",
+        func_name, std::max(to_origin, from_origin), to_origin, from_origin, max_error_);
 }
 
 void Subface::Decimate(int level, bool midpoint)
@@ -1235,14 +2290,22 @@ void Subface::Decimate(int level, bool midpoint)
     std::string func_name = fmt::format("LoopSubface::Decimate(level={}, midpoint={})", level, midpoint);
     Timer timer(func_name);
 
+    EdgeCollapseDecimate(func_name, level, midpoint ? DP_Midpoint : DP_V0);
+}
+
+void Subface::QuadricDecimate(int level)
+{
+    std::string func_name = fmt::format("LoopSubface::QuadricDecimate(level={})", level);
+    Timer timer(func_name);
+
+    EdgeCollapseDecimate(func_name, level, DP_Quadric);
+}
+
+void Subface::EdgeCollapseDecimate(const std::string& func_name, int level, EDecimatePlacement placement)
+{
     if (level >= 0)
         level_ = level;
 
-    std::vector<Vertex> vertexes;
-    std::vector<Face> faces;
-    BuildTopology(origin_positions_, origin_indexes_, vertexes, faces);
-    size_t face_count = faces_.size();
-
     float threshold = (1 <= level_ && level_ <= 9) ? (1.f - level_ * 0.1f) : 1.f;
     size_t target_face_count = static_cast<size_t>(faces_.size() * threshold);
     if (level == -1)
@@ -1250,130 +2313,1246 @@ void Subface::Decimate(int level, bool midpoint)
     else if (level == -2)
         target_face_count = std::max(size_t(1), result_face_count_) - 1;
 
-    std::set<QueueEdge> queue;
-    for (auto& f : faces)
-        for (int vi = 0; vi < 3; ++vi)
-            queue.insert({ f.v[vi], f.v[NEXT(vi)] });
+    // The collapse sequence doesn't depend on the target. Record it as far as the targets need and seek to them.
+    if (!edge_collapses_ || edge_collapses_->Placement() != placement) {
+        edge_collapses_ = std::make_unique<EdgeCollapseRecorder>(*this, placement);
+        live_decimation_ = false;
+    }
+    ProgressiveMesh& mesh = edge_collapses_->Mesh();
+    // Stepping by a face from the last result only changes the outputs around a few collapses, so they are updated in place.
+    bool step = (level == -1 || level == -2) && !optimize_vertex_order_;
+    if (!step || !live_decimation_)
+        mesh.TrackChanges(false);
 
-    size_t decimate_face_count = face_count;
-    if (level == -1) {
-        // An edge collapse may decimate more than 1 face (2 usually, 1 for border edges, >2 for corner cases).
-        // Use round up mode (with the last parameter `round_down==false`) here to ensure we can increase the face count successfully.
-        while (decimate_face_count > target_face_count && CollapseEdge(queue, decimate_face_count, target_face_count, false, midpoint))
-            ;
+    std::vector<glm::vec3> result_positions;
+    std::vector<uint32_t> result_indexes;
+    size_t collapse = 0;
+    if (max_error_ > 0.f && level > 0) {
+        // The deviation grows with the collapses but not monotonically, so a bisection over the whole sequence may jump over states
+        // beyond the bound to a dip within it. Scan evenly spaced states for the first one beyond the bound, then bisect between it
+        // and the scanned state before, which takes O(log n) measurements instead of one per collapse. Only states measured within
+        // the bound are taken, so the result never exceeds it, with the original mesh as the fallback.
+        edge_collapses_->RecordTo(0);
+        auto within = [&](size_t collapse) {
+            mesh.Seek(collapse);
+            mesh.Extract(result_positions, result_indexes);
+            return Deviation(result_positions, result_indexes) <= max_error_;
+        };
+        const size_t scan_count = 8;
+        size_t collapse_count = mesh.CollapseCount();
+        size_t lo = 0, hi = collapse_count;
+        for (size_t k = 1; k <= scan_count; ++k) {
+            size_t scan = collapse_count * k / scan_count;
+            if (scan <= lo)
+                continue;
+            if (!within(scan)) {
+                hi = scan - 1;
+                break;
+            }
+            lo = scan;
+        }
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo + 1) / 2;
+            if (within(mid))
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        collapse = lo;
     } else {
-        while (decimate_face_count > target_face_count)
-            CollapseEdge(queue, decimate_face_count, target_face_count, true, midpoint);
+        // An edge collapse may decimate more than 1 face (2 usually, 1 for border edges, >2 for corner cases).
+        // Use round up mode for `level == -1` to ensure we can increase the face count successfully.
+        edge_collapses_->RecordTo(target_face_count);
+        collapse = mesh.Find(target_face_count, level != -1);
+    }
+    mesh.Seek(collapse);
+    result_face_count_ = mesh.FaceCount(collapse);
+
+    if (step) {
+        StepIndexedOutputs();
+        if (report_error_ || max_error_ > 0.f)
+            ReportDeviation(func_name, mesh.Positions(),
+                std::vector<uint32_t>(mesh.Indexes().begin(), mesh.Indexes().begin() + result_face_count_ * 3));
+        spdlog::info("{}: {} triangles", func_name, result_face_count_);
+        return;
     }
-    result_face_count_ = decimate_face_count;
 
-    std::vector<Vertex*> vertexes_base;
-    std::vector<Face*> faces_base;
-    for (size_t i = 0; i < faces.size(); i++)
-        if (faces[i].children[0] == nullptr)
-            faces_base.push_back(&faces[i]);
-    if (!faces_base.empty())
-        for (size_t i = 0; i < vertexes.size(); i++)
-            if (vertexes[i].child == nullptr)
-                vertexes_base.push_back(&vertexes[i]);
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    std::vector<uint32_t> result_attribute_indexes;
+    mesh.Extract(result_positions, result_indexes, &result_attribute_indexes);
+    ReportDeviation(func_name, result_positions, result_indexes);
 
-    spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
+    attributes_ = edge_collapses_->Attributes();
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes, result_attribute_indexes);
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, result_indexes.size() / 3, indexed_positions_.size());
 }
 
-template <typename... Args>
-size_t meshopt_simplify_func(bool sloppy, Args... args)
+void Subface::StepIndexedOutputs()
 {
-    if (sloppy)
-        return meshopt_simplifySloppy(args...);
-    else
-        return meshopt_simplify(args...);
+    ProgressiveMesh& mesh = edge_collapses_->Mesh();
+    const std::vector<glm::vec3>& positions = mesh.Positions();
+    const std::vector<uint32_t>& indexes = mesh.Indexes();
+    const std::vector<uint32_t>& corner_attributes = mesh.CornerAttributes();
+    size_t index_count = mesh.FaceCount(mesh.Current()) * 3;
+    bool carry_attributes = !corner_attributes.empty();
+
+    if (!live_decimation_) {
+        mesh.TrackChanges(true);
+        indexed_positions_ = positions;
+        indexed_smooth_normals_.resize(positions.size());
+        ParallelFor(positions.size(), thread_count_, [&](size_t begin, size_t end, int) {
+            for (size_t v = begin; v < end; ++v)
+                indexed_smooth_normals_[v] = mesh.Normal(static_cast<uint32_t>(v));
+        });
+        vertex_indexes_.assign(indexes.begin(), indexes.begin() + index_count);
+        FinishOutputs({}, {});
+        // All the attributes, so the corners index them as the collapses do.
+        attributes_ = edge_collapses_->Attributes();
+        if (carry_attributes) {
+            indexed_attributes_ = attributes_;
+            attribute_indexes_.assign(corner_attributes.begin(), corner_attributes.begin() + index_count);
+        }
+        live_decimation_ = true;
+        return;
+    }
+
+    std::vector<uint32_t> vertexes, corners;
+    mesh.TakeChanges(vertexes, corners);
+    for (uint32_t v : vertexes) {
+        indexed_positions_[v] = positions[v];
+        indexed_smooth_normals_[v] = mesh.Normal(v);
+    }
+    // Corners past the old count are of split faces, which are among the changes.
+    vertex_indexes_.resize(index_count);
+    if (carry_attributes)
+        attribute_indexes_.resize(index_count);
+    for (uint32_t c : corners)
+        if (c < index_count) {
+            vertex_indexes_[c] = static_cast<int>(indexes[c]);
+            if (carry_attributes)
+                attribute_indexes_[c] = static_cast<int>(corner_attributes[c]);
+        }
+    // Recording may have merged more attributes.
+    const std::vector<CornerAttribute>& attributes = edge_collapses_->Attributes();
+    if (carry_attributes && indexed_attributes_.size() < attributes.size()) {
+        attributes_.insert(attributes_.end(), attributes.begin() + attributes_.size(), attributes.end());
+        indexed_attributes_.insert(indexed_attributes_.end(), attributes.begin() + indexed_attributes_.size(), attributes.end());
+    }
+    FreeDerivedOutputs();
+
+    changed_vertexes_.insert(changed_vertexes_.end(), vertexes.begin(), vertexes.end());
+    changed_corners_.insert(changed_corners_.end(), corners.begin(), corners.end());
+    // Nobody takes the changes. Past the size of the outputs, replacing them is cheaper anyway.
+    if (changed_vertexes_.size() > indexed_positions_.size() || changed_corners_.size() > vertex_indexes_.size()) {
+        outputs_replaced_ = true;
+        std::vector<uint32_t>().swap(changed_vertexes_);
+        std::vector<uint32_t>().swap(changed_corners_);
+    }
 }
 
-void Subface::MeshoptDecimate(int level, bool sloppy)
+// Attribute index of the corner of `v` in `f`.
+uint32_t CornerAttributeIndex(const Face* f, const Vertex* v)
 {
-    std::string func_name = fmt::format("LoopSubface::MeshoptDecimate(level={}, sloppy={})", level, sloppy);
-    Timer timer(func_name);
+    return f->attributes[f->VertexId(v)];
+}
 
-    if (level >= 0)
-        level_ = level;
+// Whether the corners around `v` have different attributes, i.e. `v` is on a UV or normal seam.
+bool AttributeSeam(const Vertex* v)
+{
+    uint32_t attribute = CornerAttributeIndex(v->start_face, v);
+    bool seam = false;
+    v->TraverseFaces([&](const Face* f) {
+        seam |= CornerAttributeIndex(f, v) != attribute;
+    });
+    return seam;
+}
 
-    size_t index_count = origin_indexes_.size();
-    size_t position_count = origin_positions_.size();
-    float threshold = (1 <= level_ && level_ <= 9) ? (1.f - level_ * 0.1f) : 1.f;
-    /* Hardcoded threshold table. */
-    // float threshold_table[] { 1.f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
-    // threshold = threshold_table[level % (sizeof(threshold_table) / sizeof(float))];
-    size_t target_index_count = static_cast<size_t>(index_count * threshold);
-    if (level == -1)
-        target_index_count = std::min((result_face_count_ + 1) * 3, index_count);
-    else if (level == -2)
-        target_index_count = std::max(size_t(1), result_face_count_) * 3 - 3;
-    float target_error = 1.f;
+// Half the normal distance plus the UV distance. Both are 0 for attributes not carried.
+float AttributeDistance(const CornerAttribute& a, const CornerAttribute& b)
+{
+    return 0.5f * glm::length(a.normal - b.normal) + glm::length(a.uv - b.uv);
+}
 
-    std::vector<uint32_t> result_indexes(index_count);
-    size_t result_index_count = 0;
-    // Use meshopt_simplify_func() as a proxy to prevent duplicated code (writing those many parameters for both functions).
-    if (level == -1) {
-        size_t target_index_count_temp = target_index_count;
-        // Meshopt simplifies index count to a round-down number. To ensure we can increase the face count successfully,
-        // we progressively increase `target_index_count_temp` to get `result_index_count` larger than `target_index_count`.
-        while (true) {
-            result_index_count = meshopt_simplify_func(sloppy, &result_indexes[0], &origin_indexes_[0], index_count,
-                &origin_positions_[0].x, position_count, sizeof(glm::vec3),
-                target_index_count_temp, target_error);
-            if (result_index_count < target_index_count)
-                target_index_count_temp += 3;
-            else
-                break;
-        }
+CornerAttribute LerpAttribute(const CornerAttribute& a, const CornerAttribute& b, float t)
+{
+    glm::vec3 normal = a.normal * (1.f - t) + b.normal * t;
+    float length = glm::length(normal);
+    return { length > 0.f ? normal / length : normal, a.uv * (1.f - t) + b.uv * t };
+}
+
+Subface::EdgeCollapseRecorder::EdgeCollapseRecorder(const Subface& sf, EDecimatePlacement placement)
+    : placement_(placement)
+    , carry_attributes_(sf.carry_normals_ || sf.carry_uvs_)
+    , collapse_(std::make_unique<EdgeCollapse>())
+    , face_count_(sf.origin_faces_.size())
+    , mesh_(sf.origin_positions_, sf.origin_indexes_, carry_attributes_ ? sf.origin_attribute_indexes_ : std::vector<uint32_t>())
+{
+    CloneTopology(sf.origin_vertexes_, sf.origin_faces_, vertexes_, faces_);
+
+    if (carry_attributes_) {
+        attributes_ = sf.origin_attributes_;
+        vertex_attributes_.resize(vertexes_.size());
+        for (size_t i = 0; i < sf.origin_indexes_.size(); ++i)
+            vertex_attributes_[sf.origin_indexes_[i]] = sf.origin_attribute_indexes_[i];
+    }
+
+    EdgeCollapse& collapse = *collapse_;
+    if (placement == DP_Quadric) {
+        quadrics_ = ComputeQuadrics(vertexes_, faces_);
+        collapse = QuadricEdgeCollapse(vertexes_, quadrics_);
     } else {
-        result_index_count = meshopt_simplify_func(sloppy, &result_indexes[0], &origin_indexes_[0], index_count,
-            &origin_positions_[0].x, position_count, sizeof(glm::vec3),
-            target_index_count, target_error);
+        collapse.cost = [](const Vertex* v0, const Vertex* v1) {
+            return glm::distance(v0->p, v1->p);
+        };
+        if (placement == DP_Midpoint)
+            collapse.merge = [](Vertex* v0, Vertex* v1) {
+                v0->p = (v0->p + v1->p) * 0.5f;
+            };
+        else
+            collapse.merge = [](Vertex*, Vertex*) {};
     }
-    result_face_count_ = result_index_count / 3;
-    result_indexes.resize(result_index_count);
 
-    std::vector<glm::vec3> result_positions(position_count);
-    size_t result_position_count = 0;
-    // `result_index_count` may be 0 meaning all the triangles are decimated.
-    if (result_index_count)
-        result_position_count = meshopt_optimizeVertexFetch(&result_positions[0].x, &result_indexes[0], result_index_count,
-            &origin_positions_[0].x, position_count, sizeof(glm::vec3));
-    result_positions.resize(result_position_count);
+    // Scale the costs by the attribute differences, and keep the seams by never removing or moving a seam vertex.
+    // A seam vertex may only absorb a neighbor on one side of the seam, whose corners then take that side's attribute.
+    // `allow` stashes the attributes of the allowed collapse for `record`.
+    if (carry_attributes_) {
+        collapse.cost = [this, cost = collapse.cost](const Vertex* v0, const Vertex* v1) {
+            const CornerAttribute& a0 = attributes_[vertex_attributes_[v0 - vertexes_.data()]];
+            const CornerAttribute& a1 = attributes_[vertex_attributes_[v1 - vertexes_.data()]];
+            return cost(v0, v1) * (1.f + AttributeDistance(a0, a1));
+        };
+        collapse.allow = [this, placement, allow = collapse.allow](const Vertex* v0, const Vertex* v1) {
+            if (AttributeSeam(v1) || (allow && !allow(v0, v1)))
+                return false;
+            uint32_t attribute0 = CornerAttributeIndex(v0->start_face, v0);
+            if (AttributeSeam(v0)) {
+                if (placement != DP_V0)
+                    return false;
+                bool first = true, one_side = true;
+                v0->TraverseFaces([&](const Face* f) {
+                    if (f->VertexId(v1) == -1)
+                        return;
+                    if (first)
+                        attribute0 = CornerAttributeIndex(f, v0);
+                    one_side &= CornerAttributeIndex(f, v0) == attribute0;
+                    first = false;
+                });
+                if (!one_side)
+                    return false;
+            }
+            allowed_ = { attribute0, CornerAttributeIndex(v1->start_face, v1), v0->p };
+            return true;
+        };
+        collapse.allow_reversed = true;
+    }
+    collapse.record = [this](const Vertex* v0, const Vertex* v1, const std::vector<Face*>& removed, const std::vector<const Face*>& sweep) {
+        Record(v0, v1, removed, sweep);
+    };
 
-    std::vector<Vertex> vertexes;
-    std::vector<Face> faces;
-    BuildTopology(result_positions, result_indexes, vertexes, faces);
+    std::vector<uint8_t> non_manifold = NonManifoldVertexes(vertexes_, faces_);
+    queue_ = std::make_unique<EdgeQueue>(vertexes_);
+    for (auto& f : faces_)
+        for (int vi = 0; vi < 3; ++vi) {
+            Vertex* v0 = const_cast<Vertex*>(f.v[vi]);
+            Vertex* v1 = const_cast<Vertex*>(f.v[NEXT(vi)]);
+            if (!non_manifold[v0 - vertexes_.data()] && !non_manifold[v1 - vertexes_.data()])
+                queue_->Push(v0, v1, collapse.cost(v0, v1), false);
+        }
+    queue_->Heapify();
+}
 
-    std::vector<Vertex*> vertexes_base(vertexes.size());
-    std::vector<Face*> faces_base(faces.size());
-    for (size_t i = 0; i < vertexes.size(); i++)
-        vertexes_base[i] = &vertexes[i];
-    for (size_t i = 0; i < faces.size(); i++)
-        faces_base[i] = &faces[i];
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+Subface::EdgeCollapseRecorder::~EdgeCollapseRecorder() = default;
 
-    spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
+void Subface::EdgeCollapseRecorder::Record(const Vertex* v0, const Vertex* v1, const std::vector<Face*>& removed,
+    const std::vector<const Face*>& sweep)
+{
+    removed_faces_.clear();
+    corners_.clear();
+    moved_faces_.clear();
+    for (const Face* f : removed)
+        removed_faces_.push_back(static_cast<uint32_t>(f - faces_.data()));
+    for (const Face* f : sweep)
+        if (f->children[0] == nullptr)
+            corners_.push_back(static_cast<uint32_t>((f - faces_.data()) * 3 + f->VertexId(v0)));
+    if (v0->child == nullptr)
+        v0->TraverseFaces([&](const Face* f) {
+            if (std::find(sweep.begin(), sweep.end(), f) == sweep.end())
+                moved_faces_.push_back(static_cast<uint32_t>(f - faces_.data()));
+        });
+
+    attribute_corners_.clear();
+    if (carry_attributes_) {
+        auto set_attribute = [&](const Face* f, uint32_t attribute) {
+            int id = f->VertexId(v0);
+            if (f->attributes[id] != attribute) {
+                const_cast<Face*>(f)->attributes[id] = attribute;
+                attribute_corners_.emplace_back(static_cast<uint32_t>((f - faces_.data()) * 3 + id), attribute);
+            }
+        };
+        if (placement_ == DP_V0) {
+            // v0 stays. The former corners of v1 take the attribute of v0 on their side.
+            for (const Face* f : sweep)
+                if (f->children[0] == nullptr)
+                    set_attribute(f, allowed_.attribute0);
+        } else if (v0->child == nullptr) {
+            // Interpolate at the projection of the new position onto the edge.
+            glm::vec3 e = v1->p - allowed_.p0;
+            float length2 = glm::dot(e, e);
+            float t = length2 > 0.f ? glm::clamp(glm::dot(v0->p - allowed_.p0, e) / length2, 0.f, 1.f) : 0.f;
+            attributes_.push_back(LerpAttribute(attributes_[allowed_.attribute0], attributes_[allowed_.attribute1], t));
+            uint32_t attribute = static_cast<uint32_t>(attributes_.size() - 1);
+            vertex_attributes_[v0 - vertexes_.data()] = attribute;
+            v0->TraverseFaces([&](const Face* f) {
+                set_attribute(f, attribute);
+            });
+        }
+    }
+    mesh_.Record(static_cast<uint32_t>(v0 - vertexes_.data()), static_cast<uint32_t>(v1 - vertexes_.data()), v0->p,
+        removed_faces_, corners_, moved_faces_, attribute_corners_);
 }
 
-void Subface::SimplygonDecimate(int level)
+void Subface::EdgeCollapseRecorder::RecordTo(size_t target_face_count)
 {
-    std::string func_name = fmt::format("LoopSubface::SimplygonDecimate(level={})", level);
+    // `face_count_` is the face count of the last state.
+    std::string func_name = fmt::format("LoopSubface::EdgeCollapseRecorder::RecordTo(target_face_count={})", target_face_count);
+    size_t collapse_count = mesh_.CollapseCount();
+    if (face_count_ <= target_face_count)
+        return;
+
+    mesh_.Seek(collapse_count);
+    while (face_count_ > target_face_count)
+        if (!CollapseEdge(*queue_, face_count_, 0, true, *collapse_))
+            break;
+    spdlog::info("{}: Recorded {} edge collapses, {} in all", func_name, mesh_.CollapseCount() - collapse_count, mesh_.CollapseCount());
+    // A target of 0 records the whole sequence.
+    if (face_count_ > target_face_count && target_face_count > 0)
+        spdlog::warn("{}: No edge left can collapse, stopped at {} faces", func_name, face_count_);
+}
+
+void Subface::ParallelQuadricDecimate(int level)
+{
+    std::string func_name = fmt::format("LoopSubface::ParallelQuadricDecimate(level={}, threads={})", level, thread_count_);
     Timer timer(func_name);
 
     if (level >= 0)
         level_ = level;
 
-    size_t index_count = origin_indexes_.size();
-    size_t face_count = index_count / 3;
-    [[maybe_unused]] size_t position_count = origin_positions_.size();
     float threshold = (1 <= level_ && level_ <= 9) ? (1.f - level_ * 0.1f) : 1.f;
-    /* Hardcoded threshold table. */
-    // float threshold_table[] { 1.f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
-    // threshold = threshold_table[level % (sizeof(threshold_table) / sizeof(float))];
-    [[maybe_unused]] size_t target_face_count = static_cast<size_t>(face_count * threshold);
+    size_t target_face_count = static_cast<size_t>(faces_.size() * threshold);
+    if (level == -1)
+        target_face_count = result_face_count_ + 1;
+    else if (level == -2)
+        target_face_count = std::max(size_t(1), result_face_count_) - 1;
+    // Use round up mode for `level == -1` to ensure we can increase the face count successfully.
+    bool round_down = level != -1;
+
+    std::vector<Vertex> vertexes;
+    std::vector<Face> faces;
+    CloneTopology(origin_vertexes_, origin_faces_, vertexes, faces);
+    std::vector<Quadric> quadrics = ComputeQuadrics(vertexes, faces);
+    EdgeCollapse collapse = QuadricEdgeCollapse(vertexes, quadrics);
+    std::vector<uint8_t> non_manifold = NonManifoldVertexes(vertexes, faces);
+    const Vertex* vertex_base = vertexes.data();
+
+    struct Candidate {
+        Vertex* v[2];
+        float cost;
+
+        bool operator<(const Candidate& c) const
+        {
+            if (cost != c.cost)
+                return cost < c.cost;
+            if (v[0] != c.v[0])
+                return v[0] < c.v[0];
+            return v[1] < c.v[1];
+        }
+    };
+    std::vector<std::vector<Candidate>> thread_candidates(thread_count_);
+    std::vector<Candidate> candidates;
+    std::vector<Candidate> selected;
+    std::vector<uint32_t> claimed(vertexes.size(), 0);
+    std::vector<size_t> thread_face_counts(thread_count_);
+    std::vector<const Vertex*> claim;
+
+    size_t face_count = faces.size();
+    size_t round = 0;
+    while (face_count > target_face_count) {
+        ++round;
+
+        // Gather the edges of the remaining faces with their costs. Each interior edge is owned by one of its 2 faces.
+        for (std::vector<Candidate>& c : thread_candidates)
+            c.clear();
+        ParallelFor(faces.size(), thread_count_, [&](size_t begin, size_t end, int t) {
+            std::vector<Candidate>& c = thread_candidates[t];
+            for (size_t i = begin; i < end; ++i) {
+                const Face& f = faces[i];
+                if (f.children[0])
+                    continue;
+                for (int j = 0; j < 3; ++j)
+                    if (f.neighbors[j] == nullptr || &f < f.neighbors[j]) {
+                        Vertex* v0 = const_cast<Vertex*>(std::min(f.v[j], f.v[NEXT(j)]));
+                        Vertex* v1 = const_cast<Vertex*>(std::max(f.v[j], f.v[NEXT(j)]));
+                        if (!non_manifold[v0 - vertex_base] && !non_manifold[v1 - vertex_base])
+                            c.push_back({ { v0, v1 }, collapse.cost(v0, v1) });
+                    }
+            }
+        });
+        candidates.clear();
+        for (const std::vector<Candidate>& c : thread_candidates)
+            candidates.insert(candidates.end(), c.begin(), c.end());
+        if (candidates.empty())
+            break;
+
+        // Only the cheapest quarter competes in each round, so that costly edges wait for the cheap ones around them.
+        // The rest compete only if none of the quarter can be collapsed.
+        size_t candidate_count = std::max(size_t(1), candidates.size() / 4);
+        std::nth_element(candidates.begin(), candidates.begin() + candidate_count - 1, candidates.end());
+        std::sort(candidates.begin(), candidates.begin() + candidate_count);
+
+        // Greedily select collapses in cost order whose neighborhoods don't overlap, i.e. an independent set of the edges.
+        // A collapse only touches the faces around v0 and v1 and the vertexes of those faces. Claim the vertexes.
+        selected.clear();
+        size_t selected_face_count = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (face_count - selected_face_count <= target_face_count)
+                break;
+            if (i == candidate_count) {
+                if (!selected.empty())
+                    break;
+                std::sort(candidates.begin() + candidate_count, candidates.end());
+            }
+            const Candidate& c = candidates[i];
+            Vertex* v0 = c.v[0];
+            Vertex* v1 = c.v[1];
+            // Deleted vertexes may still be in remaining faces after a degenerated collapse. Their edges are dropped as in the queue.
+            if (v0->child || v1->child || claimed[v0 - vertex_base] == round || claimed[v1 - vertex_base] == round || !Collapsible(v0, v1)
+                || !collapse.allow(v0, v1))
+                continue;
+
+            claim.clear();
+            bool unclaimed = true;
+            size_t face_count_for_this_collapse = 0;
+            auto claim_face = [&](const Face* f) {
+                for (int i = 0; i < 3; ++i) {
+                    unclaimed &= claimed[f->v[i] - vertex_base] != round;
+                    claim.push_back(f->v[i]);
+                }
+            };
+            v0->TraverseFaces(claim_face);
+            v1->TraverseFaces([&](const Face* f) {
+                claim_face(f);
+                if (f->VertexId(v0) != -1)
+                    ++face_count_for_this_collapse;
+            });
+            if (!unclaimed)
+                continue;
+            if (!round_down && face_count - selected_face_count - face_count_for_this_collapse < target_face_count)
+                continue;
+
+            for (const Vertex* v : claim)
+                claimed[v - vertex_base] = static_cast<uint32_t>(round);
+            selected.push_back(c);
+            selected_face_count += face_count_for_this_collapse;
+        }
+        if (selected.empty())
+            break;
+
+        // The selected collapses touch disjoint parts of the topology. Apply them concurrently.
+        ParallelFor(selected.size(), thread_count_, [&](size_t begin, size_t end, int t) {
+            size_t& thread_face_count = thread_face_counts[t];
+            thread_face_count = face_count;
+            for (size_t i = begin; i < end; ++i) {
+                Vertex* v0 = selected[i].v[0];
+                Vertex* v1 = selected[i].v[1];
+                CollapseEdge(v0, v1, v1->OneSweep(), thread_face_count, collapse, nullptr);
+            }
+        });
+        size_t decimated_face_count = 0;
+        for (int t = 0; t < std::min(thread_count_, static_cast<int>(selected.size())); ++t)
+            decimated_face_count += face_count - thread_face_counts[t];
+        face_count -= decimated_face_count;
+    }
+    result_face_count_ = face_count;
+
+    std::vector<uint32_t> remap(vertexes.size(), UINT32_MAX);
+    std::vector<glm::vec3> result_positions;
+    std::vector<uint32_t> result_indexes;
+    result_indexes.reserve(face_count * 3);
+    for (const Face& f : faces)
+        if (f.children[0] == nullptr)
+            for (int i = 0; i < 3; ++i) {
+                uint32_t& index = remap[f.v[i] - vertex_base];
+                if (index == UINT32_MAX) {
+                    index = static_cast<uint32_t>(result_positions.size());
+                    result_positions.push_back(f.v[i]->p);
+                }
+                result_indexes.push_back(index);
+            }
+
+    ReportDeviation(func_name, result_positions, result_indexes);
+
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes);
+
+    spdlog::info("{}: {} triangles, {} vertexes in {} rounds", func_name, result_indexes.size() / 3, indexed_positions_.size(), round);
+}
+
+// Buckets of `[0, count)` by `bucket_of(i)`, filled in parallel. Items keep their order within each bucket.
+// Returns the items ordered by bucket. `offsets[b]` to `offsets[b + 1]` is bucket `b`.
+template <typename BucketOf>
+std::vector<uint32_t> Bucket(size_t count, size_t bucket_count, int thread_count, const BucketOf& bucket_of, std::vector<size_t>& offsets)
+{
+    std::vector<std::vector<size_t>> thread_counts(thread_count, std::vector<size_t>(bucket_count, 0));
+    ParallelFor(count, thread_count, [&](size_t begin, size_t end, int t) {
+        for (size_t i = begin; i < end; ++i)
+            ++thread_counts[t][bucket_of(i)];
+    });
+
+    // Thread `t` writes bucket `b` after all the earlier threads.
+    offsets.assign(bucket_count + 1, 0);
+    for (size_t b = 0; b < bucket_count; ++b) {
+        size_t offset = offsets[b];
+        for (int t = 0; t < thread_count; ++t) {
+            size_t c = thread_counts[t][b];
+            thread_counts[t][b] = offset;
+            offset += c;
+        }
+        offsets[b + 1] = offset;
+    }
+
+    std::vector<uint32_t> items(count);
+    ParallelFor(count, thread_count, [&](size_t begin, size_t end, int t) {
+        for (size_t i = begin; i < end; ++i)
+            items[thread_counts[t][bucket_of(i)]++] = static_cast<uint32_t>(i);
+    });
+    return items;
+}
+
+// Vertex clustering of Rossignac and Borrel, "Multi-resolution 3D approximations for rendering complex scenes", 1993.
+// Vertexes are merged per cell of a uniform grid of `cell_size`. Representatives are the means of the cells, or the optimal positions
+// of the summed face quadrics if `quadric==true` (Lindstrom, "Out-of-Core Simplification of Large Polygonal Models", 2000).
+// Triangles with 2 corners in the same cell and duplicated triangles are dropped.
+// The grid is split into slabs along its longest axis, and each slab is clustered by one thread.
+void ClusterVertexes(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, float cell_size, bool quadric,
+    int thread_count, std::vector<glm::vec3>& result_positions, std::vector<uint32_t>& result_indexes)
+{
+    result_positions.clear();
+    result_indexes.clear();
+    if (positions.empty() || indexes.empty())
+        return;
+
+    glm::vec3 p_min = positions[0], p_max = positions[0];
+    for (const glm::vec3& p : positions) {
+        p_min = glm::min(p_min, p);
+        p_max = glm::max(p_max, p);
+    }
+    // Cell coordinates are packed into 21 bits each.
+    const uint32_t max_resolution = 1u << 21;
+    glm::uvec3 resolution;
+    for (int i = 0; i < 3; ++i)
+        resolution[i] = static_cast<uint32_t>(std::min(float(max_resolution), std::floor((p_max[i] - p_min[i]) / cell_size) + 1.f));
+    int axis = 0;
+    for (int i = 1; i < 3; ++i)
+        if (resolution[i] > resolution[axis])
+            axis = i;
+
+    auto cell_coord = [&](const glm::vec3& p) {
+        glm::uvec3 c;
+        for (int i = 0; i < 3; ++i)
+            c[i] = std::min(resolution[i] - 1, static_cast<uint32_t>((p[i] - p_min[i]) / cell_size));
+        return c;
+    };
+    // More slabs than threads balance the work of uneven slabs.
+    size_t slab_count = std::min(size_t(resolution[axis]), size_t(thread_count) * 4);
+    std::vector<uint64_t> keys(positions.size());
+    std::vector<uint32_t> slabs(positions.size());
+    ParallelFor(positions.size(), thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::uvec3 c = cell_coord(positions[i]);
+            keys[i] = (uint64_t(c.x) << 42) | (uint64_t(c.y) << 21) | uint64_t(c.z);
+            slabs[i] = static_cast<uint32_t>(uint64_t(c[axis]) * slab_count / resolution[axis]);
+        }
+    });
+
+    std::vector<size_t> vertex_offsets;
+    std::vector<uint32_t> slab_vertexes = Bucket(positions.size(), slab_count, thread_count, [&](size_t i) {
+        return slabs[i];
+    }, vertex_offsets);
+
+    // Cells of each slab are numbered in the order of their first vertexes.
+    std::vector<uint32_t> cells(positions.size());
+    std::vector<std::vector<glm::dvec3>> slab_sums(slab_count);
+    std::vector<std::vector<uint32_t>> slab_counts(slab_count);
+    ParallelFor(slab_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t s = begin; s < end; ++s) {
+            std::unordered_map<uint64_t, uint32_t> slab_cells;
+            for (size_t k = vertex_offsets[s]; k < vertex_offsets[s + 1]; ++k) {
+                uint32_t v = slab_vertexes[k];
+                auto it = slab_cells.emplace(keys[v], static_cast<uint32_t>(slab_cells.size())).first;
+                cells[v] = it->second;
+                if (it->second == slab_sums[s].size()) {
+                    slab_sums[s].push_back(glm::dvec3(0.0));
+                    slab_counts[s].push_back(0);
+                }
+                slab_sums[s][it->second] += glm::dvec3(positions[v]);
+                ++slab_counts[s][it->second];
+            }
+        }
+    });
+    std::vector<uint32_t> cell_offsets(slab_count + 1, 0);
+    for (size_t s = 0; s < slab_count; ++s)
+        cell_offsets[s + 1] = cell_offsets[s] + static_cast<uint32_t>(slab_sums[s].size());
+    ParallelFor(positions.size(), thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            cells[i] += cell_offsets[slabs[i]];
+    });
+
+    std::vector<glm::vec3> cell_positions(cell_offsets[slab_count]);
+    ParallelFor(slab_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t s = begin; s < end; ++s)
+            for (size_t c = 0; c < slab_sums[s].size(); ++c)
+                cell_positions[cell_offsets[s] + c] = glm::vec3(slab_sums[s][c] / double(slab_counts[s][c]));
+    });
+
+    if (quadric) {
+        // Each corner adds the quadric of its face to the cell of its vertex, so the cells of a slab only get the corners of the slab.
+        std::vector<size_t> corner_offsets;
+        std::vector<uint32_t> slab_corners = Bucket(indexes.size(), slab_count, thread_count, [&](size_t i) {
+            return slabs[indexes[i]];
+        }, corner_offsets);
+        std::vector<Quadric> quadrics(cell_positions.size());
+        ParallelFor(slab_count, thread_count, [&](size_t begin, size_t end, int) {
+            for (size_t s = begin; s < end; ++s)
+                for (size_t k = corner_offsets[s]; k < corner_offsets[s + 1]; ++k) {
+                    uint32_t corner = slab_corners[k];
+                    const uint32_t* f = &indexes[corner / 3 * 3];
+                    glm::dvec3 p[3] { glm::dvec3(positions[f[0]]), glm::dvec3(positions[f[1]]), glm::dvec3(positions[f[2]]) };
+                    glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    double area2 = glm::length(n);
+                    if (area2 == 0.0)
+                        continue;
+                    n /= area2;
+                    quadrics[cells[indexes[corner]]] += Quadric::Plane(n, -glm::dot(n, p[0]), area2 * 0.5);
+                }
+        });
+        // Keep the means for the cells whose optimal positions are singular or out of the cells.
+        ParallelFor(cell_positions.size(), thread_count, [&](size_t begin, size_t end, int) {
+            for (size_t c = begin; c < end; ++c) {
+                glm::dvec3 p;
+                if (quadrics[c].Optimal(p)) {
+                    glm::uvec3 coord = cell_coord(cell_positions[c]);
+                    bool inside = true;
+                    for (int i = 0; i < 3; ++i) {
+                        double cell_min = p_min[i] + double(coord[i]) * cell_size;
+                        inside &= cell_min <= p[i] && p[i] <= cell_min + cell_size;
+                    }
+                    if (inside)
+                        cell_positions[c] = glm::vec3(p);
+                }
+            }
+        });
+    }
+
+    // Triangles of 3 different cells, in the original order.
+    std::vector<std::vector<uint32_t>> thread_indexes(thread_count);
+    ParallelFor(indexes.size() / 3, thread_count, [&](size_t begin, size_t end, int t) {
+        for (size_t f = begin; f < end; ++f) {
+            uint32_t c0 = cells[indexes[f * 3 + 0]], c1 = cells[indexes[f * 3 + 1]], c2 = cells[indexes[f * 3 + 2]];
+            if (c0 != c1 && c1 != c2 && c2 != c0)
+                thread_indexes[t].insert(thread_indexes[t].end(), { c0, c1, c2 });
+        }
+    });
+    std::vector<uint32_t> cell_indexes;
+    for (const std::vector<uint32_t>& ti : thread_indexes)
+        cell_indexes.insert(cell_indexes.end(), ti.begin(), ti.end());
+    std::vector<std::vector<uint32_t>>().swap(thread_indexes);
+
+    // Drop duplicated triangles regardless of their orientations. Triangles are bucketed by their smallest cells, and each bucket is
+    // sorted by the cells, so the duplicates are next to each other and the first of them in the original order is kept.
+    size_t triangle_count = cell_indexes.size() / 3;
+    std::vector<std::array<uint32_t, 3>> triangles(triangle_count);
+    ParallelFor(triangle_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            triangles[i] = { cell_indexes[i * 3], cell_indexes[i * 3 + 1], cell_indexes[i * 3 + 2] };
+            std::sort(triangles[i].begin(), triangles[i].end());
+        }
+    });
+    size_t bucket_count = std::max(size_t(1), std::min(cell_positions.size(), size_t(thread_count) * 16));
+    std::vector<size_t> triangle_offsets;
+    std::vector<uint32_t> sorted_triangles = Bucket(triangle_count, bucket_count, thread_count, [&](size_t i) {
+        return uint64_t(triangles[i][0]) * bucket_count / cell_positions.size();
+    }, triangle_offsets);
+    std::vector<uint8_t> duplicated(triangle_count, 0);
+    ParallelFor(bucket_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t b = begin; b < end; ++b) {
+            auto first = sorted_triangles.begin() + triangle_offsets[b], last = sorted_triangles.begin() + triangle_offsets[b + 1];
+            std::sort(first, last, [&](uint32_t i, uint32_t j) {
+                return triangles[i] != triangles[j] ? triangles[i] < triangles[j] : i < j;
+            });
+            for (auto it = first; it != last; ++it)
+                duplicated[*it] = it != first && triangles[*it] == triangles[*(it - 1)];
+        }
+    });
+
+    // Compact the cells the remaining triangles use.
+    std::vector<uint32_t> remap(cell_positions.size(), UINT32_MAX);
+    for (size_t i = 0; i < triangle_count; ++i) {
+        if (duplicated[i])
+            continue;
+        for (int j = 0; j < 3; ++j) {
+            uint32_t& index = remap[cell_indexes[i * 3 + j]];
+            if (index == UINT32_MAX) {
+                index = static_cast<uint32_t>(result_positions.size());
+                result_positions.push_back(cell_positions[cell_indexes[i * 3 + j]]);
+            }
+            result_indexes.push_back(index);
+        }
+    }
+}
+
+void Subface::VertexClusterDecimate(int level, bool quadric)
+{
+    std::string func_name = fmt::format("LoopSubface::VertexClusterDecimate(level={}, quadric={}, threads={})", level, quadric, thread_count_);
+    Timer timer(func_name);
+
+    if (level >= 0)
+        level_ = level;
+
+    std::vector<glm::vec3> result_positions;
+    std::vector<uint32_t> result_indexes;
+    auto cluster = [&](float cell_size) {
+        ClusterVertexes(origin_positions_, origin_indexes_, cell_size, quadric, thread_count_, result_positions, result_indexes);
+        return result_indexes.size() / 3;
+    };
+
+    // A closed mesh has about twice as many faces as vertexes, and a surface occupies about `area / cell_size^2` cells.
+    auto estimate_cell_size = [&](size_t target_face_count) {
+        double area = 0.0;
+        for (size_t i = 0; i < origin_indexes_.size(); i += 3) {
+            const glm::vec3& p0 = origin_positions_[origin_indexes_[i]];
+            area += 0.5 * glm::length(glm::cross(origin_positions_[origin_indexes_[i + 1]] - p0, origin_positions_[origin_indexes_[i + 2]] - p0));
+        }
+        return static_cast<float>(std::sqrt(area / std::max(size_t(1), target_face_count / 2)));
+    };
+
+    size_t result_face_count = 0;
+    if ((level == -1 && cluster_cell_size_ > 0.f) || level == -2) {
+        // The face count can't be stepped by one. Bisect the cell size, in log scale, between the current one, which doesn't change the
+        // face count, and a bound from the bounding box that changes it in the direction asked: cells of 2^-21 of the box keep about all
+        // the vertexes apart, and a cell of twice the box merges them all. The first probe is 1% off, where the count usually changes.
+        float extent = 0.f;
+        if (!origin_positions_.empty()) {
+            glm::vec3 p_min = origin_positions_[0], p_max = origin_positions_[0];
+            for (const glm::vec3& p : origin_positions_) {
+                p_min = glm::min(p_min, p);
+                p_max = glm::max(p_max, p);
+            }
+            extent = std::max({ p_max.x - p_min.x, p_max.y - p_min.y, p_max.z - p_min.z });
+        }
+        extent = std::max(extent, std::numeric_limits<float>::min());
+        float unchanged = cluster_cell_size_ > 0.f ? cluster_cell_size_ : estimate_cell_size(result_face_count_);
+        float changed = level == -1 ? extent / float(1u << 21) : extent * 2.f;
+        float cell_size = unchanged * (level == -1 ? 0.99f : 1.01f);
+        std::vector<glm::vec3> changed_positions;
+        std::vector<uint32_t> changed_indexes;
+        bool clustered = false;
+        for (int i = 0; i < 32 && std::min(changed, unchanged) < cell_size && cell_size < std::max(changed, unchanged); ++i) {
+            result_face_count = cluster(cell_size);
+            if (level == -1 ? result_face_count > result_face_count_ : result_face_count < result_face_count_) {
+                changed = cell_size;
+                changed_positions.swap(result_positions);
+                changed_indexes.swap(result_indexes);
+                clustered = true;
+            } else {
+                unchanged = cell_size;
+            }
+            // Close enough once the bounds are within 2%.
+            if (std::max(changed, unchanged) < std::min(changed, unchanged) * 1.02f)
+                break;
+            cell_size = std::sqrt(changed * unchanged);
+        }
+        if (clustered) {
+            result_positions.swap(changed_positions);
+            result_indexes.swap(changed_indexes);
+            result_face_count = result_indexes.size() / 3;
+        } else {
+            result_face_count = cluster(changed);
+        }
+        cluster_cell_size_ = changed;
+    } else if (1 <= level_ && level_ <= 9) {
+        size_t target_face_count = static_cast<size_t>(faces_.size() * (1.f - level_ * 0.1f));
+        // The face count goes with `1 / cell_size^2`. Correct the estimation with the results a few times, each pass being O(n).
+        // Keep the closest result.
+        std::vector<glm::vec3> best_positions;
+        std::vector<uint32_t> best_indexes;
+        float best_cell_size = 0.f;
+        size_t best_difference = SIZE_MAX;
+        float cell_size = estimate_cell_size(target_face_count);
+        for (int i = 0; i < 4; ++i) {
+            result_face_count = cluster(cell_size);
+            size_t difference = result_face_count > target_face_count ? result_face_count - target_face_count : target_face_count - result_face_count;
+            if (difference < best_difference) {
+                best_difference = difference;
+                best_cell_size = cell_size;
+                best_positions.swap(result_positions);
+                best_indexes.swap(result_indexes);
+            }
+            if (difference * 20 <= target_face_count)
+                break;
+            cell_size *= result_face_count ? std::sqrt(float(result_face_count) / std::max(size_t(1), target_face_count)) : 0.5f;
+        }
+        result_positions.swap(best_positions);
+        result_indexes.swap(best_indexes);
+        result_face_count = result_indexes.size() / 3;
+        cluster_cell_size_ = best_cell_size;
+    } else {
+        // Level 0, or one less decimated face than the original mesh.
+        result_positions = origin_positions_;
+        result_indexes = origin_indexes_;
+        result_face_count = faces_.size();
+        cluster_cell_size_ = 0.f;
+    }
+    result_face_count_ = result_face_count;
+
+    ReportDeviation(func_name, result_positions, result_indexes);
+
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes);
+
+    spdlog::info("{}: {} triangles, {} vertexes, cell size {}", func_name, result_indexes.size() / 3, indexed_positions_.size(), cluster_cell_size_);
+}
+
+template <typename... Args>
+size_t meshopt_simplify_func(bool sloppy, Args... args)
+{
+    if (sloppy)
+        return meshopt_simplifySloppy(args...);
+    else
+        return meshopt_simplify(args...);
+}
+
+void Subface::MeshoptDecimate(int level, bool sloppy)
+{
+    std::string func_name = fmt::format("LoopSubface::MeshoptDecimate(level={}, sloppy={})", level, sloppy);
+    Timer timer(func_name);
+
+    if (level >= 0)
+        level_ = level;
+
+    size_t index_count = origin_indexes_.size();
+    size_t position_count = origin_positions_.size();
+    float threshold = (1 <= level_ && level_ <= 9) ? (1.f - level_ * 0.1f) : 1.f;
+    /* Hardcoded threshold table. */
+    // float threshold_table[] { 1.f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+    // threshold = threshold_table[level % (sizeof(threshold_table) / sizeof(float))];
+    size_t target_index_count = static_cast<size_t>(index_count * threshold);
+    if (level == -1)
+        target_index_count = std::min((result_face_count_ + 1) * 3, index_count);
+    else if (level == -2)
+        target_index_count = std::max(size_t(1), result_face_count_) * 3 - 3;
+    float target_error = 1.f;
+
+    // With carried attributes, simplify the wedges, i.e. the distinct (vertex, attribute) pairs of the corners, instead.
+    // Meshopt keeps the seams between the wedges of the same position.
+    bool carry_attributes = carry_normals_ || carry_uvs_;
+    std::vector<glm::vec3> wedge_positions;
+    std::vector<uint32_t> wedge_indexes, wedge_vertexes, wedge_attributes;
+    if (carry_attributes) {
+        std::unordered_map<uint64_t, uint32_t> wedges;
+        wedge_indexes.resize(index_count);
+        for (size_t i = 0; i < index_count; ++i) {
+            uint64_t key = uint64_t(origin_indexes_[i]) << 32 | origin_attribute_indexes_[i];
+            auto it = wedges.emplace(key, static_cast<uint32_t>(wedge_vertexes.size())).first;
+            if (it->second == wedge_vertexes.size()) {
+                wedge_vertexes.push_back(origin_indexes_[i]);
+                wedge_attributes.push_back(origin_attribute_indexes_[i]);
+                wedge_positions.push_back(origin_positions_[origin_indexes_[i]]);
+            }
+            wedge_indexes[i] = it->second;
+        }
+    }
+    const std::vector<glm::vec3>& simplify_positions = carry_attributes ? wedge_positions : origin_positions_;
+    const std::vector<uint32_t>& simplify_indexes = carry_attributes ? wedge_indexes : origin_indexes_;
+    // Indexes of the wedges to indexes of the vertexes.
+    auto to_vertexes = [&](std::vector<uint32_t> indexes) {
+        if (carry_attributes)
+            for (uint32_t& i : indexes)
+                i = wedge_vertexes[i];
+        return indexes;
+    };
+
+    std::vector<uint32_t> result_indexes(index_count);
+    size_t result_index_count = 0;
+    // Use meshopt_simplify_func() as a proxy to prevent duplicated code (writing those many parameters for both functions).
+    auto simplify = [&](size_t target_index_count_temp) {
+        return meshopt_simplify_func(sloppy, &result_indexes[0], &simplify_indexes[0], index_count,
+            &simplify_positions[0].x, simplify_positions.size(), sizeof(glm::vec3),
+            target_index_count_temp, target_error);
+    };
+    if (max_error_ > 0.f && level > 0) {
+        // Meshopt bounds its own error metric relative to the mesh extents, which doesn't bound the Hausdorff distance.
+        // Start from the bound and tighten it until the measured deviation is within the bound.
+        // Keep the original mesh if it never is.
+        target_error = max_error_ / meshopt_simplifyScale(&origin_positions_[0].x, position_count, sizeof(glm::vec3));
+        bool within = false;
+        for (int i = 0; i < 16 && !within; ++i, target_error *= 0.5f) {
+            result_index_count = simplify(0);
+            std::vector<uint32_t> indexes(result_indexes.begin(), result_indexes.begin() + result_index_count);
+            within = Deviation(origin_positions_, to_vertexes(indexes)) <= max_error_;
+        }
+        if (!within) {
+            result_indexes = simplify_indexes;
+            result_index_count = index_count;
+        }
+    } else if (level == -1) {
+        // Meshopt simplifies index count to a round-down number. To ensure we can increase the face count successfully,
+        // we search for the smallest `target_index_count_temp` giving `result_index_count` no less than `target_index_count`.
+        // Grow the step exponentially to bound the search, then bisect, instead of trying every 3 indexes.
+        size_t lo = target_index_count, hi = target_index_count, step = 3;
+        while ((result_index_count = simplify(hi)) < target_index_count && hi < index_count) {
+            lo = hi + 3;
+            hi = std::min(hi + step, index_count);
+            step *= 2;
+        }
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 6 * 3;
+            if (simplify(mid) < target_index_count)
+                lo = mid + 3;
+            else
+                hi = mid;
+        }
+        result_index_count = simplify(hi);
+    } else {
+        result_index_count = simplify(target_index_count);
+    }
+    result_face_count_ = result_index_count / 3;
+    result_indexes.resize(result_index_count);
+    std::vector<uint32_t> result_attribute_indexes;
+    if (carry_attributes) {
+        result_attribute_indexes.resize(result_index_count);
+        for (size_t i = 0; i < result_index_count; ++i)
+            result_attribute_indexes[i] = wedge_attributes[result_indexes[i]];
+        result_indexes = to_vertexes(std::move(result_indexes));
+    }
+    ReportDeviation(func_name, origin_positions_, result_indexes);
+
+    std::vector<glm::vec3> result_positions(position_count);
+    size_t result_position_count = 0;
+    // `result_index_count` may be 0 meaning all the triangles are decimated.
+    if (result_index_count)
+        result_position_count = meshopt_optimizeVertexFetch(&result_positions[0].x, &result_indexes[0], result_index_count,
+            &origin_positions_[0].x, position_count, sizeof(glm::vec3));
+    result_positions.resize(result_position_count);
+
+    attributes_ = origin_attributes_;
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes, result_attribute_indexes);
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, result_indexes.size() / 3, indexed_positions_.size());
+}
+
+// Faces of `indexes` sorted along the Z-order curve (Morton order) of their centroids in the box from `lower` to `upper`.
+// The 30-bit codes are sorted by 2 passes of `Bucket()`, so faces with the same code keep their order.
+std::vector<uint32_t> MortonOrder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+    const glm::vec3& lower, const glm::vec3& upper, int thread_count)
+{
+    // Spread the 10 bits of `x` to every third bit.
+    auto spread = [](uint32_t x) {
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    };
+
+    size_t face_count = indexes.size() / 3;
+    glm::vec3 extent = upper - lower;
+    glm::vec3 scale(0.f);
+    for (int i = 0; i < 3; ++i)
+        if (extent[i] > 0.f)
+            scale[i] = 1023.f / extent[i];
+    std::vector<uint32_t> codes(face_count);
+    ParallelFor(face_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t f = begin; f < end; ++f) {
+            glm::vec3 c = (positions[indexes[f * 3]] + positions[indexes[f * 3 + 1]] + positions[indexes[f * 3 + 2]]) / 3.f;
+            glm::vec3 g = (c - lower) * scale;
+            uint32_t code = 0;
+            for (int i = 0; i < 3; ++i)
+                code |= spread(static_cast<uint32_t>(std::min(std::max(g[i], 0.f), 1023.f))) << i;
+            codes[f] = code;
+        }
+    });
+
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> low = Bucket(face_count, 1 << 15, thread_count, [&](size_t f) {
+        return codes[f] & 0x7fff;
+    },
+        offsets);
+    std::vector<uint32_t> high = Bucket(face_count, 1 << 15, thread_count, [&](size_t i) {
+        return codes[low[i]] >> 15;
+    },
+        offsets);
+    for (uint32_t& i : high)
+        i = low[i];
+    return high;
+}
+
+// meshopt_simplify() of the faces `faces` of `indexes` to `target_face_count` faces, without moving the vertexes with `locked[v] != 0`.
+// meshoptimizer 0.18 has no per-vertex locks, so each locked vertex gets a face with 2 more copies of it, as vertexes with more than one
+// copy are locked. These faces never collapse and are dropped from the result. `remap` has an `UINT32_MAX` per vertex, and is left so.
+std::vector<uint32_t> SimplifyLocked(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, const uint32_t* faces,
+    size_t face_count, const std::vector<uint8_t>& locked, size_t target_face_count, std::vector<uint32_t>& remap)
+{
+    std::vector<uint32_t> result;
+    if (face_count == 0)
+        return result;
+
+    std::vector<uint32_t> vertexes, local_indexes;
+    std::vector<glm::vec3> local_positions;
+    local_indexes.reserve(face_count * 3);
+    for (size_t i = 0; i < face_count; ++i)
+        for (int j = 0; j < 3; ++j) {
+            uint32_t v = indexes[faces[i] * 3 + j];
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = static_cast<uint32_t>(vertexes.size());
+                vertexes.push_back(v);
+                local_positions.push_back(positions[v]);
+            }
+            local_indexes.push_back(remap[v]);
+        }
+    uint32_t vertex_count = static_cast<uint32_t>(vertexes.size());
+    size_t lock_count = 0;
+    for (uint32_t v : vertexes)
+        if (locked[v]) {
+            uint32_t copy = static_cast<uint32_t>(local_positions.size());
+            local_positions.insert(local_positions.end(), 2, positions[v]);
+            local_indexes.insert(local_indexes.end(), { remap[v], copy, copy + 1 });
+            ++lock_count;
+        }
+
+    result.resize(local_indexes.size());
+    result.resize(meshopt_simplify(result.data(), local_indexes.data(), local_indexes.size(), &local_positions.data()->x,
+        local_positions.size(), sizeof(glm::vec3), std::min((target_face_count + lock_count) * 3, local_indexes.size()), 1.f, 0, nullptr));
+    // Map back, dropping the faces of the copies.
+    size_t result_index_count = 0;
+    for (size_t i = 0; i < result.size(); i += 3)
+        if (result[i + 1] < vertex_count)
+            for (int j = 0; j < 3; ++j)
+                result[result_index_count++] = vertexes[result[i + j]];
+    result.resize(result_index_count);
+    for (uint32_t v : vertexes)
+        remap[v] = UINT32_MAX;
+    return result;
+}
+
+// `SimplifyLocked()` of each cluster of `cluster_face_count` consecutive faces in `order`, the clusters in parallel, each to its share
+// of `target_face_count`. The vertexes shared by more than one cluster are locked too, by setting them in `locked`, so the simplified
+// clusters still fit together. The result only depends on the clusters, not on `thread_count`.
+std::vector<uint32_t> SimplifyLockedClusters(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+    const std::vector<uint32_t>& order, std::vector<uint8_t>& locked, size_t target_face_count, size_t cluster_face_count, int thread_count)
+{
+    size_t face_count = order.size();
+    size_t cluster_count = (face_count + cluster_face_count - 1) / cluster_face_count;
+
+    // Cluster of the first face using each vertex.
+    std::vector<uint32_t> clusters(positions.size(), UINT32_MAX);
+    for (size_t i = 0; i < face_count; ++i) {
+        uint32_t c = static_cast<uint32_t>(i / cluster_face_count);
+        for (int j = 0; j < 3; ++j) {
+            uint32_t v = indexes[order[i] * 3 + j];
+            if (clusters[v] == UINT32_MAX)
+                clusters[v] = c;
+            else if (clusters[v] != c)
+                locked[v] = 1;
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> cluster_indexes(cluster_count);
+    ParallelFor(cluster_count, thread_count, [&](size_t begin, size_t end, int) {
+        std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+        for (size_t c = begin; c < end; ++c) {
+            size_t face_begin = c * cluster_face_count, face_end = std::min(face_begin + cluster_face_count, face_count);
+            // Split the target so that the shares sum to `target_face_count`.
+            size_t target = face_end * target_face_count / face_count - face_begin * target_face_count / face_count;
+            cluster_indexes[c] = SimplifyLocked(positions, indexes, &order[face_begin], face_end - face_begin, locked, target, remap);
+        }
+    });
+
+    std::vector<uint32_t> result_indexes;
+    for (const std::vector<uint32_t>& c : cluster_indexes)
+        result_indexes.insert(result_indexes.end(), c.begin(), c.end());
+    return result_indexes;
+}
+
+// Simplify `indexes` to about `target_face_count` faces with `SimplifyLockedClusters()` on clusters of `cluster_face_count` faces in
+// `order`. The locked seams are still at full resolution, so further passes simplify the faces around them toward the target, with
+// the vertexes they share with the other faces locked. The seam faces are grown ring by ring from the locked vertexes, for at least
+// 2 rings and until they are 4 times the faces to remove or half the faces, and are simplified the same way in clusters in Morton
+// order. The vertexes these clusters share are the seams of the next pass, until the target is reached or a pass removes no face.
+// The result only depends on the clusters, not on `thread_count`.
+std::vector<uint32_t> SimplifyClusters(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
+    const std::vector<uint32_t>& order, size_t target_face_count, size_t cluster_face_count, int thread_count)
+{
+    std::vector<uint8_t> locked(positions.size(), 0), fixed(positions.size());
+    std::vector<uint32_t> result_indexes
+        = SimplifyLockedClusters(positions, indexes, order, locked, target_face_count, cluster_face_count, thread_count);
+    std::vector<uint32_t> vertex_face_offsets(positions.size() + 1), vertex_faces;
+    while (result_indexes.size() / 3 > target_face_count) {
+        size_t merged_face_count = result_indexes.size() / 3;
+        // Faces around each vertex of the merged faces.
+        std::fill(vertex_face_offsets.begin(), vertex_face_offsets.end(), 0);
+        for (uint32_t v : result_indexes)
+            ++vertex_face_offsets[v + 1];
+        for (size_t v = 0; v < positions.size(); ++v)
+            vertex_face_offsets[v + 1] += vertex_face_offsets[v];
+        vertex_faces.resize(result_indexes.size());
+        std::vector<uint32_t> fill(vertex_face_offsets.begin(), vertex_face_offsets.end() - 1);
+        for (size_t i = 0; i < result_indexes.size(); ++i)
+            vertex_faces[fill[result_indexes[i]]++] = static_cast<uint32_t>(i / 3);
+
+        // Breadth-first from the locked vertexes, which then mark the vertexes whose faces are taken.
+        size_t excess = merged_face_count - target_face_count;
+        std::vector<uint8_t> seams(merged_face_count, 0);
+        std::vector<uint32_t> seam_faces, frontier;
+        for (size_t v = 0; v < positions.size(); ++v)
+            if (locked[v])
+                frontier.push_back(static_cast<uint32_t>(v));
+        for (int ring = 0; !frontier.empty(); ++ring) {
+            size_t ring_begin = seam_faces.size();
+            for (uint32_t v : frontier)
+                for (uint32_t k = vertex_face_offsets[v]; k < vertex_face_offsets[v + 1]; ++k)
+                    if (!seams[vertex_faces[k]]) {
+                        seams[vertex_faces[k]] = 1;
+                        seam_faces.push_back(vertex_faces[k]);
+                    }
+            if ((ring >= 1 && seam_faces.size() >= excess * 4) || seam_faces.size() * 2 >= merged_face_count)
+                break;
+            frontier.clear();
+            for (size_t i = ring_begin; i < seam_faces.size(); ++i)
+                for (int j = 0; j < 3; ++j) {
+                    uint32_t v = result_indexes[seam_faces[i] * 3 + j];
+                    if (!locked[v]) {
+                        locked[v] = 1;
+                        frontier.push_back(v);
+                    }
+                }
+        }
+        // No seams are left, e.g. of a single cluster.
+        if (seam_faces.empty())
+            break;
+
+        std::vector<uint32_t> other_indexes, seam_indexes;
+        seam_indexes.reserve(seam_faces.size() * 3);
+        for (size_t f = 0; f < merged_face_count; ++f) {
+            std::vector<uint32_t>& to = seams[f] ? seam_indexes : other_indexes;
+            to.insert(to.end(), &result_indexes[f * 3], &result_indexes[f * 3] + 3);
+        }
+        std::fill(fixed.begin(), fixed.end(), 0);
+        for (uint32_t v : other_indexes)
+            fixed[v] = 1;
+        locked = fixed;
+
+        glm::vec3 lower = positions[seam_indexes[0]], upper = lower;
+        for (uint32_t v : seam_indexes) {
+            lower = glm::min(lower, positions[v]);
+            upper = glm::max(upper, positions[v]);
+        }
+        std::vector<uint32_t> seam_order = MortonOrder(positions, seam_indexes, lower, upper, thread_count);
+        size_t seam_face_count = seam_indexes.size() / 3;
+        seam_indexes = SimplifyLockedClusters(positions, seam_indexes, seam_order, locked,
+            seam_face_count - std::min(excess, seam_face_count), cluster_face_count, thread_count);
+        if (seam_indexes.size() / 3 >= seam_face_count)
+            break;
+        other_indexes.insert(other_indexes.end(), seam_indexes.begin(), seam_indexes.end());
+        result_indexes.swap(other_indexes);
+        for (size_t v = 0; v < positions.size(); ++v)
+            locked[v] &= !fixed[v];
+    }
+    return result_indexes;
+}
+
+void Subface::PartitionedMeshoptDecimate(int level)
+{
+    std::string func_name = fmt::format("LoopSubface::PartitionedMeshoptDecimate(level={}, threads={})", level, thread_count_);
+    Timer timer(func_name);
+
+    if (level >= 0)
+        level_ = level;
+
+    // Small enough for every thread to get a few clusters of a large mesh, large enough to keep the seams a small part of each cluster.
+    constexpr size_t cluster_face_count = 16384;
+    size_t face_count = origin_indexes_.size() / 3;
+    size_t position_count = origin_positions_.size();
+
+    glm::vec3 lower(0.f), upper(0.f);
+    if (position_count) {
+        lower = upper = origin_positions_[0];
+        for (const glm::vec3& p : origin_positions_) {
+            lower = glm::min(lower, p);
+            upper = glm::max(upper, p);
+        }
+    }
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> result_indexes;
+    auto simplify = [&](size_t target_face_count) {
+        if (order.empty())
+            order = MortonOrder(origin_positions_, origin_indexes_, lower, upper, thread_count_);
+        result_indexes = SimplifyClusters(origin_positions_, origin_indexes_, order, target_face_count, cluster_face_count, thread_count_);
+        return result_indexes.size() / 3;
+    };
+
+    size_t result_face_count = face_count;
+    if ((level == -1 && result_face_count_ < face_count) || (level == -2 && result_face_count_ > 0)) {
+        // Locked seams make the face count move in uneven steps. Widen the step until it changes in the direction asked.
+        size_t target_face_count = result_face_count_, step = 1;
+        for (;;) {
+            target_face_count = level == -1 ? std::min(target_face_count + step, face_count) : target_face_count - std::min(step, target_face_count);
+            result_face_count = simplify(target_face_count);
+            if (level == -1 ? result_face_count > result_face_count_ : result_face_count < result_face_count_)
+                break;
+            if (target_face_count == (level == -1 ? face_count : 0))
+                break;
+            step *= 2;
+        }
+    } else if (level == -2) {
+        // All the faces are already decimated.
+        result_face_count = 0;
+    } else if (level >= 0 && 1 <= level_ && level_ <= 9) {
+        result_face_count = simplify(static_cast<size_t>(face_count * (1.f - level_ * 0.1f)));
+    } else {
+        // Level 0, or one less decimated face than the original mesh.
+        result_indexes = origin_indexes_;
+    }
+    result_face_count_ = result_face_count;
+
+    std::vector<glm::vec3> result_positions(position_count);
+    size_t result_position_count = 0;
+    // `result_indexes` may be empty meaning all the triangles are decimated.
+    if (!result_indexes.empty())
+        result_position_count = meshopt_optimizeVertexFetch(&result_positions[0].x, &result_indexes[0], result_indexes.size(),
+            &origin_positions_[0].x, position_count, sizeof(glm::vec3));
+    result_positions.resize(result_position_count);
+
+    ReportDeviation(func_name, result_positions, result_indexes);
+
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes);
+
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, result_indexes.size() / 3, indexed_positions_.size());
+}
+
+void Subface::SimplygonDecimate(int level)
+{
+    std::string func_name = fmt::format("LoopSubface::SimplygonDecimate(level={})", level);
+    Timer timer(func_name);
+
+    if (level >= 0)
+        level_ = level;
+
+    size_t index_count = origin_indexes_.size();
+    size_t face_count = index_count / 3;
+    [[maybe_unused]] size_t position_count = origin_positions_.size();
+    float threshold = (1 <= level_ && level_ <= 9) ? (1.f - level_ * 0.1f) : 1.f;
+    /* Hardcoded threshold table. */
+    // float threshold_table[] { 1.f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+    // threshold = threshold_table[level % (sizeof(threshold_table) / sizeof(float))];
+    [[maybe_unused]] size_t target_face_count = static_cast<size_t>(face_count * threshold);
     if (level == -1)
         target_face_count = std::min(result_face_count_ + 2, face_count); // Add 2 faces.
     else if (level == -2)
@@ -1428,51 +3607,899 @@ void Subface::SimplygonDecimate(int level)
 
     result_face_count_ = result_indexes.size() / 3;
 
-    std::vector<Vertex> vertexes;
-    std::vector<Face> faces;
-    BuildTopology(result_positions, result_indexes, vertexes, faces);
+    ReportDeviation(func_name, result_positions, result_indexes);
 
-    std::vector<Vertex*> vertexes_base(vertexes.size());
-    std::vector<Face*> faces_base(faces.size());
-    for (size_t i = 0; i < vertexes.size(); i++)
-        vertexes_base[i] = &vertexes[i];
-    for (size_t i = 0; i < faces.size(); i++)
-        faces_base[i] = &faces[i];
-    ComputeNormalsAndPositions(vertexes_base, faces_base);
+    ComputeIndexedOutputs(std::move(result_positions), result_indexes);
 
-    spdlog::info("{}: {} triangles, {} vertexes", func_name, faces_base.size(), vertexes_base.size());
+    spdlog::info("{}: {} triangles, {} vertexes", func_name, result_indexes.size() / 3, indexed_positions_.size());
 }
 
-void Subface::ExportObj(const std::string& file_name, bool smooth) const
+glm::vec2 OctahedralEncode(const glm::vec3& n)
 {
-    std::string func_name = fmt::format("LoopSubface::ExportObj(file_name={}, smooth={})", file_name, smooth);
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    // Also catches NaN normals of degenerate faces.
+    if (!(sum > 0.f))
+        return glm::vec2(0.f, 0.f);
+    glm::vec2 e(n.x / sum, n.y / sum);
+    if (n.z < 0.f)
+        e = glm::vec2((1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f));
+    return e;
+}
+
+glm::vec3 OctahedralDecode(const glm::vec2& e)
+{
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.f) {
+        n.x = (1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f);
+        n.y = (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f);
+    }
+    return glm::normalize(n);
+}
+
+// Snorm octahedral components of `n` with `max` as 1. Of the 4 roundings of the components, take the one decoding closest to `n`.
+template <typename T>
+void QuantizeOctahedral(const glm::vec3& n, float max, T* q)
+{
+    glm::vec2 e = OctahedralEncode(n) * max;
+    float best = -2.f;
+    for (int i = 0; i < 4; ++i) {
+        glm::vec2 r((i & 1) ? std::ceil(e.x) : std::floor(e.x), (i & 2) ? std::ceil(e.y) : std::floor(e.y));
+        r = glm::vec2(glm::clamp(r.x, -max, max), glm::clamp(r.y, -max, max));
+        float d = glm::dot(OctahedralDecode(r / max), n);
+        if (d > best) {
+            best = d;
+            q[0] = static_cast<T>(r.x);
+            q[1] = static_cast<T>(r.y);
+        }
+    }
+}
+
+QuantizedMesh Subface::Quantize(int normal_bits) const
+{
+    std::string func_name = fmt::format("LoopSubface::Quantize(normal_bits={})", normal_bits);
     Timer timer(func_name);
 
-    std::ofstream ofs(file_name);
-
-    for (auto& v : indexed_positions_)
-        ofs << "v " << v.x << " " << v.y << " " << v.z << std::endl;
-    if (smooth) {
-        for (auto& n : indexed_smooth_normals_)
-            ofs << "vn " << n.x << " " << n.y << " " << n.z << std::endl;
-        for (size_t i = 0; i < vertex_indexes_.size(); i += 3)
-            ofs << "f "
-                << vertex_indexes_[i + 0] + 1 << "//" << smooth_normal_indexes_[i + 0] + 1 << " "
-                << vertex_indexes_[i + 1] + 1 << "//" << smooth_normal_indexes_[i + 1] + 1 << " "
-                << vertex_indexes_[i + 2] + 1 << "//" << smooth_normal_indexes_[i + 2] + 1 << std::endl;
+    QuantizedMesh q;
+    q.normal_bits = normal_bits <= 8 ? 8 : 16;
+    size_t vertex_count = indexed_positions_.size();
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3& p : indexed_positions_) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    if (vertex_count == 0)
+        lo = hi = glm::vec3(0.f);
+    q.position_offset = lo;
+    q.position_scale = hi - lo;
+
+    q.positions.resize(vertex_count * 3);
+    if (q.normal_bits == 8)
+        q.normals_8.resize(vertex_count * 2);
+    else
+        q.normals_16.resize(vertex_count * 2);
+    float normal_max = q.normal_bits == 8 ? 127.f : 32767.f;
+    std::vector<float> position_errors(thread_count_, 0.f), normal_errors(thread_count_, 0.f);
+    ParallelFor(vertex_count, thread_count_, [&](size_t begin, size_t end, int thread_id) {
+        for (size_t v = begin; v < end; ++v) {
+            const glm::vec3& p = indexed_positions_[v];
+            glm::vec3 dequantized;
+            for (int k = 0; k < 3; ++k) {
+                float t = q.position_scale[k] > 0.f ? (p[k] - lo[k]) / q.position_scale[k] : 0.f;
+                uint16_t c = static_cast<uint16_t>(std::lround(glm::clamp(t, 0.f, 1.f) * 65535.f));
+                q.positions[v * 3 + k] = c;
+                dequantized[k] = lo[k] + q.position_scale[k] * (c / 65535.f);
+            }
+            position_errors[thread_id] = std::max(position_errors[thread_id], glm::distance(p, dequantized));
+
+            const glm::vec3& n = indexed_smooth_normals_[v];
+            glm::vec2 e;
+            if (q.normal_bits == 8) {
+                QuantizeOctahedral(n, normal_max, &q.normals_8[v * 2]);
+                e = glm::vec2(q.normals_8[v * 2], q.normals_8[v * 2 + 1]);
+            } else {
+                QuantizeOctahedral(n, normal_max, &q.normals_16[v * 2]);
+                e = glm::vec2(q.normals_16[v * 2], q.normals_16[v * 2 + 1]);
+            }
+            // `acos()` of the dot product loses the small angles in float precision.
+            glm::vec3 decoded = OctahedralDecode(e / normal_max);
+            float angle = std::atan2(glm::length(glm::cross(decoded, n)), glm::dot(decoded, n)) * 180.f / PI;
+            // NaN normals are skipped.
+            if (angle == angle)
+                normal_errors[thread_id] = std::max(normal_errors[thread_id], angle);
+        }
+    });
+    q.max_position_error = *std::max_element(position_errors.begin(), position_errors.end());
+    q.max_normal_error = *std::max_element(normal_errors.begin(), normal_errors.end());
+
+    // Leave out 65535, the usual primitive restart index.
+    if (vertex_count < 65536)
+        q.indexes_16.assign(vertex_indexes_.begin(), vertex_indexes_.end());
+    else
+        q.indexes_32.assign(vertex_indexes_.begin(), vertex_indexes_.end());
+
+    size_t byte_size = vertex_count * 2 * sizeof(glm::vec3) + vertex_indexes_.size() * sizeof(uint32_t);
+    spdlog::info("{}: {} -> {} bytes, max position error {:.3g} ({:.3g} of the bounds diagonal), max normal error {:.3g} degrees",
+        func_name, byte_size, q.ByteSize(), q.max_position_error,
+        vertex_count ? q.max_position_error / std::max(glm::length(q.position_scale), std::numeric_limits<float>::min()) : 0.f,
+        q.max_normal_error);
+    return q;
+}
+
+LodChain Subface::BuildLodChain(EProcessingMethod method)
+{
+    std::string func_name = fmt::format("LoopSubface::BuildLodChain(method={})", GetProcessingMethod(method).name);
+    Timer timer(func_name);
+
+    const int level_count = 10;
+    size_t index_count = origin_indexes_.size();
+    size_t position_count = origin_positions_.size();
+
+    LodChain chain;
+    std::vector<uint32_t>& indexes = chain.indexes;
+    auto add_lod = [&](size_t index_offset) {
+        chain.lods.push_back({ static_cast<uint32_t>(index_offset), static_cast<uint32_t>(indexes.size() - index_offset) });
+    };
+
+    // Vertexes of all the levels, which the levels index before the compaction below.
+    std::vector<glm::vec3> positions;
+    if (method == PM_Decimate_ShortestEdge_V0 || method == PM_Decimate_ShortestEdge_Midpoint || method == PM_QuadricDecimate) {
+        // Levels are states of one recorded collapse sequence. Collapsing v1 into v0 keeps v0 in place for `DP_V0`, so all the levels
+        // index the original vertexes. The other placements move v0, which then takes a new vertex in the levels from there on.
+        EDecimatePlacement placement = method == PM_Decimate_ShortestEdge_V0 ? DP_V0
+            : method == PM_Decimate_ShortestEdge_Midpoint                   ? DP_Midpoint
+                                                                            : DP_Quadric;
+        if (!edge_collapses_ || edge_collapses_->Placement() != placement) {
+            edge_collapses_ = std::make_unique<EdgeCollapseRecorder>(*this, placement);
+            live_decimation_ = false;
+        }
+        ProgressiveMesh& mesh = edge_collapses_->Mesh();
+        // Seeking here moves the sequence away from the outputs, which then don't follow it anymore.
+        mesh.TrackChanges(false);
+        live_decimation_ = false;
+        edge_collapses_->RecordTo(static_cast<size_t>(faces_.size() * (1.f - (level_count - 1) * 0.1f)));
+        positions = origin_positions_;
+        // Vertex of each original vertex in `positions` at its position in the last level.
+        std::vector<uint32_t> lod_vertexes(position_count);
+        for (size_t i = 0; i < position_count; ++i)
+            lod_vertexes[i] = static_cast<uint32_t>(i);
+        for (int level = 0; level < level_count; ++level) {
+            size_t target_face_count = static_cast<size_t>(faces_.size() * (1.f - level * 0.1f));
+            mesh.Seek(mesh.Find(target_face_count, true));
+            size_t index_offset = indexes.size();
+            mesh.AppendIndexes(indexes);
+            const std::vector<glm::vec3>& level_positions = mesh.Positions();
+            for (size_t i = index_offset; i < indexes.size(); ++i) {
+                uint32_t& vertex = lod_vertexes[indexes[i]];
+                if (positions[vertex] != level_positions[indexes[i]]) {
+                    vertex = static_cast<uint32_t>(positions.size());
+                    positions.push_back(level_positions[indexes[i]]);
+                }
+                indexes[i] = vertex;
+            }
+            add_lod(index_offset);
+        }
+    } else if (method == PM_MeshoptDecimate || method == PM_MeshoptDecimateSloppy) {
+        bool sloppy = method == PM_MeshoptDecimateSloppy;
+        float target_error = 1.f;
+        positions = origin_positions_;
+        indexes = origin_indexes_;
+        add_lod(0);
+        // Each level only reads the previous one, which is smaller than the original mesh for all but level 1.
+        std::vector<uint32_t> lod_indexes(index_count);
+        for (int level = 1; level < level_count; ++level) {
+            const LodChain::Range& previous = chain.lods.back();
+            size_t target_index_count = static_cast<size_t>(index_count * (1.f - level * 0.1f));
+            size_t lod_index_count = 0;
+            if (previous.index_count)
+                lod_index_count = meshopt_simplify_func(sloppy, &lod_indexes[0], &indexes[previous.index_offset], previous.index_count,
+                    &origin_positions_[0].x, position_count, sizeof(glm::vec3),
+                    target_index_count, target_error);
+            size_t index_offset = indexes.size();
+            indexes.insert(indexes.end(), lod_indexes.begin(), lod_indexes.begin() + lod_index_count);
+            add_lod(index_offset);
+        }
     } else {
-        for (auto& n : indexed_flat_normals_)
-            ofs << "vn " << n.x << " " << n.y << " " << n.z << std::endl;
-        for (size_t i = 0; i < vertex_indexes_.size(); i += 3)
-            ofs << "f "
-                << vertex_indexes_[i + 0] + 1 << "//" << flat_normal_indexes_[i + 0] + 1 << " "
-                << vertex_indexes_[i + 1] + 1 << "//" << flat_normal_indexes_[i + 1] + 1 << " "
-                << vertex_indexes_[i + 2] + 1 << "//" << flat_normal_indexes_[i + 2] + 1 << std::endl;
+        spdlog::error("{}: Only Decimate_ShortestEdge_*, QuadricDecimate, MeshoptDecimate and MeshoptDecimateSloppy have levels of one pass!",
+            func_name);
+        return chain;
+    }
+
+    // Drop the vertexes no level uses, and order the rest by their first use, i.e. by level 0 mostly.
+    chain.positions.resize(positions.size());
+    size_t result_position_count = 0;
+    if (!indexes.empty())
+        result_position_count = meshopt_optimizeVertexFetch(&chain.positions[0].x, &indexes[0], indexes.size(),
+            &positions[0].x, positions.size(), sizeof(glm::vec3));
+    chain.positions.resize(result_position_count);
+
+    for (size_t level = 0; level < chain.lods.size(); ++level)
+        spdlog::info("{}: Level {}: {} triangles", func_name, level, chain.lods[level].index_count / 3);
+    spdlog::info("{}: {} vertexes, {} indexes in total", func_name, chain.positions.size(), indexes.size());
+    return chain;
+}
+
+// Bound of a float written by `FormatFloat()`, e.g. "-340282346638528859811704183484516925440.000000001".
+constexpr size_t max_float_chars = 52;
+// Bound of an OBJ index.
+constexpr size_t max_index_chars = 10;
+
+// The fewest digits reading back the same float if `precision < 0`, else `precision` decimals without trailing zeros.
+char* FormatFloat(char* p, float value, int precision)
+{
+    if (precision < 0)
+        return std::to_chars(p, p + max_float_chars, value).ptr;
+    char* end = std::to_chars(p, p + max_float_chars, value, std::chars_format::fixed, std::min(precision, 9)).ptr;
+    if (precision > 0) {
+        while (end[-1] == '0')
+            --end;
+        if (end[-1] == '.')
+            --end;
+    }
+    return end;
+}
+
+// `prefix` and `count` floats, e.g. "v 1 2 3".
+char* FormatFloats(char* p, const char* prefix, const float* values, int count, int precision)
+{
+    while (*prefix)
+        *p++ = *prefix++;
+    for (int i = 0; i < count; ++i) {
+        *p++ = ' ';
+        p = FormatFloat(p, values[i], precision);
+    }
+    return p;
+}
+
+// 1-based OBJ index of a 0-based index.
+char* FormatObjIndex(char* p, size_t index)
+{
+    return std::to_chars(p, p + max_index_chars, index + 1).ptr;
+}
+
+// Write `count` items, item `i` formatted by `format(p, i)` which writes at most `max_item_size` bytes at `p` and returns the end.
+// Blocks of items are formatted in parallel into reused buffers, then written in order.
+template <typename Format>
+void WriteBlocks(std::ostream& os, size_t count, size_t max_item_size, int thread_count, const Format& format)
+{
+    const size_t block_items = 1 << 14;
+    size_t block_count = (count + block_items - 1) / block_items;
+    thread_count = std::max(1, thread_count);
+    std::vector<std::vector<char>> buffers(thread_count);
+    std::vector<size_t> sizes(thread_count);
+    for (size_t first = 0; first < block_count; first += thread_count) {
+        size_t round_count = std::min(static_cast<size_t>(thread_count), block_count - first);
+        ParallelFor(round_count, thread_count, [&](size_t begin, size_t end, int) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t item_begin = (first + b) * block_items, item_end = std::min(count, item_begin + block_items);
+                std::vector<char>& buffer = buffers[b];
+                buffer.resize(std::max(buffer.size(), (item_end - item_begin) * max_item_size));
+                char* p = buffer.data();
+                for (size_t i = item_begin; i < item_end; ++i)
+                    p = format(p, i);
+                sizes[b] = p - buffer.data();
+            }
+        });
+        for (size_t b = 0; b < round_count; ++b)
+            os.write(buffers[b].data(), sizes[b]);
+    }
+}
+
+// `WriteBlocks()` of text lines, `format` writing at most `max_line_chars` chars excluding the line break.
+template <typename Format>
+void WriteLines(std::ostream& os, size_t count, size_t max_line_chars, int thread_count, const Format& format)
+{
+    WriteBlocks(os, count, max_line_chars + 1, thread_count, [&](char* p, size_t i) {
+        p = format(p, i);
+        *p++ = '\n';
+        return p;
+    });
+}
+
+// Copy `value` to `p` as it is in memory, i.e. little-endian on the supported platforms.
+template <typename T>
+char* WriteBytes(char* p, const T& value)
+{
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+}
+
+void Subface::ExportLodChainObj(const std::string& file_name, const LodChain& chain, int precision, int thread_count)
+{
+    std::string func_name = fmt::format("LoopSubface::ExportLodChainObj(file_name={})", file_name);
+    Timer timer(func_name);
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+
+    WriteLines(ofs, chain.positions.size(), 1 + 3 * (1 + max_float_chars), thread_count, [&](char* p, size_t i) {
+        return FormatFloats(p, "v", &chain.positions[i].x, 3, precision);
+    });
+    for (size_t level = 0; level < chain.lods.size(); ++level) {
+        const LodChain::Range& lod = chain.lods[level];
+        ofs << "o lod" << level << "\n";
+        const uint32_t* indexes = chain.indexes.data() + lod.index_offset;
+        WriteLines(ofs, lod.index_count / 3, 1 + 3 * (1 + max_index_chars), thread_count, [&](char* p, size_t i) {
+            *p++ = 'f';
+            for (size_t j = i * 3; j < i * 3 + 3; ++j) {
+                *p++ = ' ';
+                p = FormatObjIndex(p, indexes[j]);
+            }
+            return p;
+        });
+    }
+    if (!ofs) {
+        spdlog::error("{}: Failed to write {}!", func_name, file_name);
+        return;
+    }
+
+    spdlog::info("{}: LOD chain exported: {}", func_name, file_name);
+}
+
+void Subface::ExportObj(const std::string& file_name, bool smooth, int precision) const
+{
+    std::string func_name = fmt::format("LoopSubface::ExportObj(file_name={}, smooth={})", file_name, smooth);
+    Timer timer(func_name);
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    auto write_vectors = [&](const char* prefix, size_t count, int dimension, const auto& vector) {
+        WriteLines(ofs, count, 2 + dimension * (1 + max_float_chars), thread_count_, [&](char* p, size_t i) {
+            return FormatFloats(p, prefix, &vector(i).x, dimension, precision);
+        });
+    };
+    // "f v/vt/vn v/vt/vn v/vt/vn" with the given parts.
+    auto write_faces = [&](const auto& corner) {
+        WriteLines(ofs, vertex_indexes_.size() / 3, 1 + 3 * (3 + 3 * max_index_chars), thread_count_, [&](char* p, size_t i) {
+            *p++ = 'f';
+            for (size_t j = i * 3; j < i * 3 + 3; ++j) {
+                *p++ = ' ';
+                p = corner(p, i, j);
+            }
+            return p;
+        });
+    };
+
+    write_vectors("v", indexed_positions_.size(), 3, [&](size_t i) -> const glm::vec3& { return indexed_positions_[i]; });
+    // The UV and the carried normal of a corner share the index of its attribute. The computed normals stand in for missing carried
+    // ones, the smooth ones per vertex or the flat ones per face.
+    bool uvs = !attribute_indexes_.empty() && carry_uvs_;
+    bool carried_normals = !attribute_indexes_.empty() && carry_normals_;
+    if (uvs)
+        write_vectors("vt", indexed_attributes_.size(), 2, [&](size_t i) -> const glm::vec2& { return indexed_attributes_[i].uv; });
+    const std::vector<glm::vec3>* normals = carried_normals ? nullptr : smooth ? &indexed_smooth_normals_ : &IndexedNormalFlat();
+    if (carried_normals)
+        write_vectors("vn", indexed_attributes_.size(), 3, [&](size_t i) -> const glm::vec3& { return indexed_attributes_[i].normal; });
+    else
+        write_vectors("vn", normals->size(), 3, [&](size_t i) -> const glm::vec3& { return (*normals)[i]; });
+    write_faces([&](char* p, size_t i, size_t j) {
+        p = FormatObjIndex(p, vertex_indexes_[j]);
+        *p++ = '/';
+        if (uvs)
+            p = FormatObjIndex(p, attribute_indexes_[j]);
+        *p++ = '/';
+        return FormatObjIndex(p, carried_normals ? attribute_indexes_[j] : smooth ? vertex_indexes_[j] : i);
+    });
+    if (!ofs) {
+        spdlog::error("{}: Failed to write {}!", func_name, file_name);
+        return;
     }
 
     spdlog::info("{}: Mesh exported: {}", func_name, file_name);
 }
 
+void Subface::ExportPly(const std::string& file_name, bool smooth) const
+{
+    std::string func_name = fmt::format("LoopSubface::ExportPly(file_name={}, smooth={})", file_name, smooth);
+    Timer timer(func_name);
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    ofs << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << indexed_positions_.size() << "\n"
+        << "property float x\nproperty float y\nproperty float z\n";
+    if (smooth)
+        ofs << "property float nx\nproperty float ny\nproperty float nz\n";
+    ofs << "element face " << vertex_indexes_.size() / 3 << "\n"
+        << "property list uchar int vertex_indices\n"
+        << "end_header\n";
+
+    WriteBlocks(ofs, indexed_positions_.size(), 2 * sizeof(glm::vec3), thread_count_, [&](char* p, size_t i) {
+        p = WriteBytes(p, indexed_positions_[i]);
+        return smooth ? WriteBytes(p, indexed_smooth_normals_[i]) : p;
+    });
+    WriteBlocks(ofs, vertex_indexes_.size() / 3, 1 + 3 * sizeof(int32_t), thread_count_, [&](char* p, size_t i) {
+        *p++ = 3;
+        return WriteBytes(p, std::array<int32_t, 3> { vertex_indexes_[i * 3 + 0], vertex_indexes_[i * 3 + 1], vertex_indexes_[i * 3 + 2] });
+    });
+    if (!ofs) {
+        spdlog::error("{}: Failed to write {}!", func_name, file_name);
+        return;
+    }
+
+    spdlog::info("{}: Mesh exported: {}", func_name, file_name);
+}
+
+void Subface::ExportStl(const std::string& file_name) const
+{
+    std::string func_name = fmt::format("LoopSubface::ExportStl(file_name={})", file_name);
+    Timer timer(func_name);
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    // An 80-byte header, the triangle count, then per triangle: the normal, 3 corners and a 2-byte attribute.
+    char header[80] = "Binary STL exported by subface";
+    ofs.write(header, sizeof(header));
+    uint32_t triangle_count = static_cast<uint32_t>(vertex_indexes_.size() / 3);
+    ofs.write(reinterpret_cast<const char*>(&triangle_count), sizeof(triangle_count));
+
+    const std::vector<glm::vec3>& normals = IndexedNormalFlat();
+    WriteBlocks(ofs, triangle_count, 4 * sizeof(glm::vec3) + sizeof(uint16_t), thread_count_, [&](char* p, size_t i) {
+        p = WriteBytes(p, normals[i]);
+        for (size_t j = i * 3; j < i * 3 + 3; ++j)
+            p = WriteBytes(p, indexed_positions_[vertex_indexes_[j]]);
+        return WriteBytes(p, uint16_t(0));
+    });
+    if (!ofs) {
+        spdlog::error("{}: Failed to write {}!", func_name, file_name);
+        return;
+    }
+
+    spdlog::info("{}: Mesh exported: {}", func_name, file_name);
+}
+
+void Subface::ExportSfz(const std::string& file_name, bool smooth) const
+{
+    std::string func_name = fmt::format("LoopSubface::ExportSfz(file_name={}, smooth={})", file_name, smooth);
+    Timer timer(func_name);
+
+    // The normals and UVs are per corner in a mesh file. The computed normals stand in for missing carried ones, as in `ExportObj()`.
+    const std::vector<glm::vec3>* flat_normals = carry_normals_ || smooth ? nullptr : &IndexedNormalFlat();
+    std::vector<glm::vec3> normals(vertex_indexes_.size());
+    std::vector<glm::vec2> uvs(carry_uvs_ ? vertex_indexes_.size() : 0);
+    ParallelFor(vertex_indexes_.size(), thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (carry_normals_)
+                normals[i] = indexed_attributes_[attribute_indexes_[i]].normal;
+            else if (smooth)
+                normals[i] = indexed_smooth_normals_[vertex_indexes_[i]];
+            else
+                normals[i] = (*flat_normals)[i / 3];
+            if (carry_uvs_)
+                uvs[i] = indexed_attributes_[attribute_indexes_[i]].uv;
+        }
+    });
+    MeshView view;
+    view.positions = indexed_positions_.data();
+    view.position_count = indexed_positions_.size();
+    // `int` and `uint32_t` may alias each other.
+    view.indexes = reinterpret_cast<const uint32_t*>(vertex_indexes_.data());
+    view.index_count = vertex_indexes_.size();
+    view.normals = normals.data();
+    view.uvs = uvs.empty() ? nullptr : uvs.data();
+    if (SaveCompressedMesh(file_name, view, thread_count_))
+        spdlog::info("{}: Mesh exported: {}", func_name, file_name);
+}
+
+// Add `vertex_count` glTF vertexes to `glb` as one interleaved buffer view, and return their (semantic, accessor) pairs.
+// `position(v)`, `normal(v)` and `uv(v)` are the attributes of vertex `v`:
+//     Positions are floats, or unsigned 16-bit integers if `quantize==true`, dequantized by the node transform `translation` and `scale`.
+//     Normals are left out if `normal_bits==0`, else floats if `normal_bits==32`, else normalized integers of `normal_bits` 8 or 16.
+//     UVs are floats if `has_uvs==true`.
+template <typename Position, typename Normal, typename Uv>
+std::vector<std::pair<std::string, int>> AddGlbVertexes(GlbBuilder& glb, size_t vertex_count, bool quantize, int normal_bits, bool has_uvs,
+    int thread_count, glm::vec3& translation, glm::vec3& scale, const Position& position, const Normal& normal, const Uv& uv)
+{
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < vertex_count; ++v) {
+        lo = glm::min(lo, position(v));
+        hi = glm::max(hi, position(v));
+    }
+    glm::vec3 extent = hi - lo;
+    translation = quantize ? lo : glm::vec3(0.f);
+    scale = glm::vec3(1.f);
+    if (quantize)
+        for (int k = 0; k < 3; ++k)
+            if (extent[k] > 0.f)
+                scale[k] = extent[k] / 65535.f;
+
+    // glTF aligns each attribute to 4 bytes.
+    size_t position_size = quantize ? 4 * sizeof(uint16_t) : sizeof(glm::vec3);
+    size_t normal_size = normal_bits == 8 ? 4 * sizeof(int8_t) : normal_bits == 16 ? 4 * sizeof(int16_t) : normal_bits ? sizeof(glm::vec3) : 0;
+    size_t stride = position_size + normal_size + (has_uvs ? sizeof(glm::vec2) : 0);
+    int buffer_view = glb.AddBufferView(vertex_count * stride, stride);
+    char* data = glb.BufferViewData(buffer_view);
+    ParallelFor(vertex_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t v = begin; v < end; ++v) {
+            char* p = data + v * stride;
+            glm::vec3 pos = position(v);
+            if (quantize) {
+                std::array<uint16_t, 4> q {};
+                for (int k = 0; k < 3; ++k)
+                    if (extent[k] > 0.f)
+                        q[k] = static_cast<uint16_t>(std::lround(glm::clamp((pos[k] - lo[k]) / extent[k], 0.f, 1.f) * 65535.f));
+                p = WriteBytes(p, q);
+            } else {
+                p = WriteBytes(p, pos);
+            }
+            if (normal_bits == 8 || normal_bits == 16) {
+                glm::vec3 n = glm::clamp(normal(v), -1.f, 1.f) * (normal_bits == 8 ? 127.f : 32767.f);
+                if (normal_bits == 8)
+                    p = WriteBytes(p, std::array<int8_t, 4> { static_cast<int8_t>(std::lround(n.x)), static_cast<int8_t>(std::lround(n.y)), static_cast<int8_t>(std::lround(n.z)) });
+                else
+                    p = WriteBytes(p, std::array<int16_t, 4> { static_cast<int16_t>(std::lround(n.x)), static_cast<int16_t>(std::lround(n.y)), static_cast<int16_t>(std::lround(n.z)) });
+            } else if (normal_bits) {
+                p = WriteBytes(p, normal(v));
+            }
+            if (has_uvs)
+                WriteBytes(p, uv(v));
+        }
+    });
+
+    // Bounds of the stored values, i.e. before the node transform.
+    std::vector<std::pair<std::string, int>> attributes;
+    if (quantize) {
+        std::vector<double> max;
+        for (int k = 0; k < 3; ++k)
+            max.push_back(extent[k] > 0.f ? 65535. : 0.);
+        attributes.emplace_back("POSITION", glb.AddAccessor(buffer_view, 0, GCT_UnsignedShort, false, vertex_count, "VEC3", { 0., 0., 0. }, max));
+    } else {
+        attributes.emplace_back("POSITION", glb.AddAccessor(buffer_view, 0, GCT_Float, false, vertex_count, "VEC3", { lo.x, lo.y, lo.z }, { hi.x, hi.y, hi.z }));
+    }
+    if (normal_bits) {
+        EGltfComponentType type = normal_bits == 8 ? GCT_Byte : normal_bits == 16 ? GCT_Short : GCT_Float;
+        attributes.emplace_back("NORMAL", glb.AddAccessor(buffer_view, position_size, type, type != GCT_Float, vertex_count, "VEC3"));
+    }
+    if (has_uvs)
+        attributes.emplace_back("TEXCOORD_0", glb.AddAccessor(buffer_view, position_size + normal_size, GCT_Float, false, vertex_count, "VEC2"));
+    return attributes;
+}
+
+// Add `index_count` indexes to `glb` as one buffer view, of 16-bit indexes if `vertex_count < 65536`, else of 32-bit ones.
+template <typename Index>
+int AddGlbIndexes(GlbBuilder& glb, const Index* indexes, size_t index_count, size_t vertex_count, int thread_count, EGltfComponentType& component_type)
+{
+    bool indexes_16 = vertex_count < 65536;
+    component_type = indexes_16 ? GCT_UnsignedShort : GCT_UnsignedInt;
+    int buffer_view = glb.AddBufferView(index_count * (indexes_16 ? sizeof(uint16_t) : sizeof(uint32_t)), 0);
+    char* data = glb.BufferViewData(buffer_view);
+    ParallelFor(index_count, thread_count, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            if (indexes_16)
+                reinterpret_cast<uint16_t*>(data)[i] = static_cast<uint16_t>(indexes[i]);
+            else
+                reinterpret_cast<uint32_t*>(data)[i] = static_cast<uint32_t>(indexes[i]);
+    });
+    return buffer_view;
+}
+
+void Subface::ExportGlb(const std::string& file_name, bool smooth, int quantize_normal_bits) const
+{
+    std::string func_name = fmt::format("LoopSubface::ExportGlb(file_name={}, smooth={}, quantize_normal_bits={})", file_name, smooth, quantize_normal_bits);
+    Timer timer(func_name);
+
+    GlbBuilder glb;
+    bool quantize = quantize_normal_bits > 0;
+    if (quantize)
+        glb.UseExtension("KHR_mesh_quantization", true);
+    int normal_bits = quantize ? (quantize_normal_bits <= 8 ? 8 : 16) : 32;
+
+    if (!vertex_indexes_.empty()) {
+        glm::vec3 translation, scale;
+        std::vector<std::pair<std::string, int>> attributes;
+        EGltfComponentType index_type;
+        int index_view;
+        size_t vertex_count;
+        if (!attribute_indexes_.empty()) {
+            // glTF vertexes have one set of attributes, so the wedges, i.e. the distinct (vertex, attribute) pairs of the corners, are the vertexes.
+            std::unordered_map<uint64_t, uint32_t> wedges;
+            std::vector<uint32_t> wedge_indexes(vertex_indexes_.size()), wedge_vertexes, wedge_attributes;
+            for (size_t i = 0; i < vertex_indexes_.size(); ++i) {
+                uint64_t key = uint64_t(vertex_indexes_[i]) << 32 | uint32_t(attribute_indexes_[i]);
+                auto it = wedges.emplace(key, static_cast<uint32_t>(wedge_vertexes.size())).first;
+                if (it->second == wedge_vertexes.size()) {
+                    wedge_vertexes.push_back(vertex_indexes_[i]);
+                    wedge_attributes.push_back(attribute_indexes_[i]);
+                }
+                wedge_indexes[i] = it->second;
+            }
+            // Carried normals are exported instead of the computed ones, as in `ExportObj()`.
+            vertex_count = wedge_vertexes.size();
+            attributes = AddGlbVertexes(glb, vertex_count, quantize, carry_normals_ || smooth ? normal_bits : 0, carry_uvs_, thread_count_, translation, scale,
+                [&](size_t v) { return indexed_positions_[wedge_vertexes[v]]; },
+                [&](size_t v) { return carry_normals_ ? indexed_attributes_[wedge_attributes[v]].normal : indexed_smooth_normals_[wedge_vertexes[v]]; },
+                [&](size_t v) { return indexed_attributes_[wedge_attributes[v]].uv; });
+            index_view = AddGlbIndexes(glb, wedge_indexes.data(), wedge_indexes.size(), vertex_count, thread_count_, index_type);
+        } else {
+            // Clients compute flat normals for meshes without normals.
+            vertex_count = indexed_positions_.size();
+            attributes = AddGlbVertexes(glb, vertex_count, quantize, smooth ? normal_bits : 0, false, thread_count_, translation, scale,
+                [&](size_t v) { return indexed_positions_[v]; },
+                [&](size_t v) { return indexed_smooth_normals_[v]; },
+                [&](size_t) { return glm::vec2(0.f); });
+            index_view = AddGlbIndexes(glb, vertex_indexes_.data(), vertex_indexes_.size(), vertex_count, thread_count_, index_type);
+        }
+        int indexes = glb.AddAccessor(index_view, 0, index_type, false, vertex_indexes_.size(), "SCALAR");
+        glb.AddNode(glb.AddMesh(attributes, indexes), translation, scale, true);
+    }
+    if (glb.Save(file_name))
+        spdlog::info("{}: Mesh exported: {}", func_name, file_name);
+}
+
+void Subface::ExportLodChainGlb(const std::string& file_name, const LodChain& chain, bool quantize, int thread_count)
+{
+    std::string func_name = fmt::format("LoopSubface::ExportLodChainGlb(file_name={}, quantize={})", file_name, quantize);
+    Timer timer(func_name);
+
+    GlbBuilder glb;
+    if (quantize)
+        glb.UseExtension("KHR_mesh_quantization", true);
+    // Clients without MSFT_lod only show the finest level.
+    glb.UseExtension("MSFT_lod", false);
+    if (thread_count <= 0)
+        thread_count = DefaultThreadCount();
+
+    // All the levels share the vertex buffer view and the index buffer view, through accessors of their own.
+    glm::vec3 translation, scale;
+    std::vector<std::pair<std::string, int>> attributes;
+    EGltfComponentType index_type = GCT_UnsignedInt;
+    int index_view = -1;
+    if (!chain.indexes.empty()) {
+        attributes = AddGlbVertexes(glb, chain.positions.size(), quantize, 0, false, thread_count, translation, scale,
+            [&](size_t v) { return chain.positions[v]; },
+            [&](size_t) { return glm::vec3(0.f); },
+            [&](size_t) { return glm::vec2(0.f); });
+        index_view = AddGlbIndexes(glb, chain.indexes.data(), chain.indexes.size(), chain.positions.size(), thread_count, index_type);
+    }
+    size_t index_size = index_type == GCT_UnsignedShort ? sizeof(uint16_t) : sizeof(uint32_t);
+    std::vector<int> lod_meshes;
+    for (const LodChain::Range& lod : chain.lods)
+        // glTF doesn't allow empty accessors, so empty levels are left out.
+        if (lod.index_count)
+            lod_meshes.push_back(glb.AddMesh(attributes,
+                glb.AddAccessor(index_view, lod.index_offset * index_size, index_type, false, lod.index_count, "SCALAR")));
+    // Only the finest level is in the scene. It lists the nodes of the coarser ones, from fine to coarse.
+    if (!lod_meshes.empty()) {
+        std::string ids;
+        for (size_t i = 1; i < lod_meshes.size(); ++i)
+            ids += fmt::format("{}{}", i > 1 ? "," : "", glb.AddNode(lod_meshes[i], translation, scale, false));
+        glb.AddNode(lod_meshes[0], translation, scale, true, fmt::format("\"MSFT_lod\":{{\"ids\":[{}]}}", ids));
+    }
+    if (glb.Save(file_name))
+        spdlog::info("{}: LOD chain exported: {}", func_name, file_name);
+}
+
+bool Subface::StreamLoopSubdivide(int level, bool flat, bool compute_limit, const std::string& file_name, EStreamFormat format, int precision)
+{
+    std::string func_name = fmt::format("LoopSubface::StreamLoopSubdivide(level={}, flat={}, compute_limit={}, file_name={})",
+        level, flat, compute_limit, file_name);
+    Timer timer(func_name);
+
+    if (level < 1) {
+        spdlog::error("{}: Only levels from 1 have a last level to stream!", func_name);
+        return false;
+    }
+    // Unlike the other methods, the result size is only bounded by the 32-bit indexes of the formats.
+    if (origin_faces_.size() * std::pow(4., level) > std::numeric_limits<int32_t>::max()) {
+        spdlog::error("{}: Result triangle count {} is too large for 32-bit indexes!", func_name, origin_faces_.size() * std::pow(4., level));
+        return false;
+    }
+
+    level_ = level;
+    ComputeIndexedOutputs({}, {});
+
+    std::vector<Vertex*> vertexes;
+    std::vector<Face*> faces;
+    ResetBase(vertexes, faces);
+    MemoryPool mp;
+    LoopSubdivideLevels(level - 1, flat, false, mp, vertexes, faces);
+
+    size_t vertex_count = vertexes.size(), face_count = faces.size();
+    for (size_t i = 0; i < vertex_count; ++i)
+        vertexes[i]->index = static_cast<uint32_t>(i);
+    for (size_t i = 0; i < face_count; ++i)
+        faces[i]->index = static_cast<uint32_t>(i);
+
+    // The vertexes of the last level are the vertex points, one per vertex, then the edge points in the order `LoopSubdivide()`
+    // adds them, i.e. by the first face of each edge. `edge_points` are the edge points of the faces, and `edge_owners` are the
+    // first faces and edges of the edge points, as `face * 3 + vi`.
+    // Edge `j` of `g` from `v0` to `v1` or back, -1 if `g` doesn't have it.
+    auto edge_id = [](const Face* g, const Vertex* v0, const Vertex* v1) {
+        for (int j = 0; j < 3; ++j)
+            if ((g->v[j] == v0 && g->v[NEXT(j)] == v1) || (g->v[j] == v1 && g->v[NEXT(j)] == v0))
+                return j;
+        return -1;
+    };
+    // The faces of a vertex are one fan if its traversal reaches all of them and its 1-ring has no vertex twice. Then each of its
+    // edges is in a face and its neighbor at most, so the neighbor has the edge point. The edges of the other vertexes are looked up
+    // by their vertexes, as in `LoopSubdivide()`.
+    std::vector<uint32_t> corner_counts(vertex_count, 0);
+    for (const Face* f : faces)
+        for (int vi = 0; vi < 3; ++vi)
+            ++corner_counts[f->v[vi]->index];
+    std::vector<uint8_t> fans(vertex_count);
+    ParallelFor(vertex_count, thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            const Vertex* v = vertexes[i];
+            if (corner_counts[i] != v->valence - (v->boundary ? 1 : 0))
+                continue;
+            std::vector<const Vertex*> ring = v->OneRing();
+            std::sort(ring.begin(), ring.end());
+            fans[i] = std::adjacent_find(ring.begin(), ring.end()) == ring.end();
+        }
+    });
+    std::vector<uint32_t>().swap(corner_counts);
+    auto fan = [&](const Vertex* v) {
+        return fans[v->index] != 0;
+    };
+    std::unordered_map<uint64_t, uint32_t> non_fan_edges;
+    std::vector<uint32_t> edge_points(face_count * 3);
+    std::vector<uint32_t> edge_owners;
+    for (size_t fi = 0; fi < face_count; ++fi) {
+        const Face* f = faces[fi];
+        for (int vi = 0; vi < 3; ++vi) {
+            const Vertex *v0 = f->v[vi], *v1 = f->v[NEXT(vi)];
+            uint32_t edge_point = static_cast<uint32_t>(vertex_count + edge_owners.size());
+            if (fan(v0) && fan(v1)) {
+                const Face* g = f->neighbors[vi];
+                int j = g && g->index < fi ? edge_id(g, v0, v1) : -1;
+                if (j >= 0)
+                    edge_point = edge_points[g->index * 3 + j];
+            } else {
+                uint64_t key = uint64_t(std::min(v0->index, v1->index)) << 32 | std::max(v0->index, v1->index);
+                edge_point = non_fan_edges.emplace(key, edge_point).first->second;
+            }
+            edge_points[fi * 3 + vi] = edge_point;
+            if (edge_point == vertex_count + edge_owners.size())
+                edge_owners.push_back(static_cast<uint32_t>(fi * 3 + vi));
+        }
+    }
+    std::vector<uint8_t>().swap(fans);
+    std::unordered_map<uint64_t, uint32_t>().swap(non_fan_edges);
+    size_t result_vertex_count = vertex_count + edge_owners.size(), result_face_count = face_count * 4;
+    if (result_vertex_count > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        spdlog::error("{}: Result vertex count {} is too large for 32-bit indexes!", func_name, result_vertex_count);
+        return false;
+    }
+
+    auto edge_point = [&](const Face* f, int vi) {
+        return edge_points[f->index * 3 + vi];
+    };
+    // The vertex points take a traversal of the 1-ring each, and every limit position needs several of them, so they are computed
+    // once. The edge points are weighted sums of 4 vertexes, cheaper to compute again than to keep for the whole last level.
+    std::vector<glm::vec3> vertex_points(vertex_count);
+    ParallelFor(vertex_count, thread_count_, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i)
+            vertex_points[i] = VertexPoint(vertexes[i], flat);
+    });
+    // Position of vertex `i` of the last level before taking it to the limit.
+    auto point = [&](size_t i) {
+        if (i < vertex_count)
+            return vertex_points[i];
+        uint32_t owner = edge_owners[i - vertex_count];
+        return EdgePoint(faces[owner / 3], owner % 3, flat);
+    };
+    // Same as `WeightOneRing()` and `WeightBoundary()` of the last level, with the ring given by vertex indexes.
+    auto weight_ring = [&](size_t i, const uint32_t* ring, size_t valence, float beta) {
+        glm::vec3 p = (1 - valence * beta) * point(i);
+        for (size_t k = 0; k < valence; ++k)
+            p += beta * point(ring[k]);
+        return p;
+    };
+    auto weight_boundary = [&](size_t i, uint32_t n0, uint32_t n1, float beta) {
+        return (1 - beta * 2.f) * point(i) + (point(n0) + point(n1)) * beta;
+    };
+    // Limit position of vertex `i` of the last level, from its 1-ring in the last level, which only has edge points around vertex
+    // points, and 2 vertex points and 4 edge points around interior edge points.
+    auto limit = [&](size_t i) {
+        if (i < vertex_count) {
+            // The faces of the last level around the vertex point are the corner children of the faces around the vertex,
+            // so the 1-ring follows `Vertex::OneRing()` of the vertex, with edge points instead of the other vertexes. It is walked
+            // without being stored, once to count it and once to weight it.
+            Vertex* v = vertexes[i];
+            const Face* start_face = v->start_face;
+            int si = start_face->VertexId(v);
+            uint32_t first = 0;
+            if (v->boundary)
+                first = start_face->neighbors[PREV(si)] == nullptr ? edge_point(start_face, PREV(si)) : edge_point(start_face, si);
+            auto walk_ring = [&](const auto& visit) {
+                size_t count = v->boundary ? 1 : 0;
+                uint32_t last = first;
+                auto step = [&](const Face* f) {
+                    int vi = f->VertexId(v);
+                    last = count > 0 && edge_point(f, vi) == last ? edge_point(f, PREV(vi)) : edge_point(f, vi);
+                    visit(count++, last);
+                };
+                // Capturing `step` alone keeps the `std::function` from allocating.
+                const Face* end_face = v->TraverseFaces([&step](const Face* f) {
+                    step(f);
+                });
+                return std::make_pair(count, end_face);
+            };
+            if (v->boundary) {
+                const Face* end_face = walk_ring([](size_t, uint32_t) {}).second;
+                int ei = end_face->VertexId(v);
+                return weight_boundary(i, first, end_face->neighbors[ei] == nullptr ? edge_point(end_face, ei) : edge_point(end_face, PREV(ei)), 1.f / 5.f);
+            }
+            size_t valence = std::min(walk_ring([](size_t, uint32_t) {}).first, size_t(v->valence));
+            float beta = LoopGamma(v->valence);
+            glm::vec3 p = (1 - valence * beta) * point(i);
+            walk_ring([&](size_t k, uint32_t neighbor) {
+                if (k < valence)
+                    p += beta * point(neighbor);
+            });
+            return p;
+        }
+        uint32_t owner = edge_owners[i - vertex_count];
+        const Face* f = faces[owner / 3];
+        int vi = owner % 3;
+        const Face* g = f->neighbors[vi];
+        int j = g ? edge_id(g, f->v[vi], f->v[NEXT(vi)]) : -1;
+        if (j < 0)
+            return weight_boundary(i, f->v[vi]->index, f->v[NEXT(vi)]->index, 1.f / 5.f);
+        // In the order `Vertex::OneRing()` traverses them from the first child face of `f` with the edge point.
+        uint32_t ring[6] = { edge_point(f, PREV(vi)), edge_point(f, NEXT(vi)), f->v[NEXT(vi)]->index,
+            edge_point(g, PREV(j)), edge_point(g, NEXT(j)), f->v[vi]->index };
+        return weight_ring(i, ring, 6, LoopGamma(6));
+    };
+    bool use_limit = !flat && compute_limit;
+    auto position = [&](size_t i) {
+        return use_limit ? limit(i) : point(i);
+    };
+    // Children of each face as in `LoopSubdivide()`: the corner children `ci`, then the middle one.
+    auto child_face = [&](size_t i) {
+        const Face* f = faces[i / 4];
+        int ci = static_cast<int>(i % 4);
+        std::array<uint32_t, 3> v;
+        if (ci == 3) {
+            for (int k = 0; k < 3; ++k)
+                v[k] = edge_point(f, k);
+        } else {
+            v[ci] = f->v[ci]->index;
+            v[NEXT(ci)] = edge_point(f, ci);
+            v[PREV(ci)] = edge_point(f, PREV(ci));
+        }
+        return v;
+    };
+
+    std::ofstream ofs(file_name, std::ios::binary);
+    if (format == SF_Ply) {
+        ofs << "ply\n"
+            << "format binary_little_endian 1.0\n"
+            << "element vertex " << result_vertex_count << "\n"
+            << "property float x\nproperty float y\nproperty float z\n"
+            << "element face " << result_face_count << "\n"
+            << "property list uchar int vertex_indices\n"
+            << "end_header\n";
+        WriteBlocks(ofs, result_vertex_count, sizeof(glm::vec3), thread_count_, [&](char* p, size_t i) {
+            return WriteBytes(p, position(i));
+        });
+        WriteBlocks(ofs, result_face_count, 1 + 3 * sizeof(int32_t), thread_count_, [&](char* p, size_t i) {
+            *p++ = 3;
+            return WriteBytes(p, child_face(i));
+        });
+    } else {
+        WriteLines(ofs, result_vertex_count, 1 + 3 * (1 + max_float_chars), thread_count_, [&](char* p, size_t i) {
+            glm::vec3 v = position(i);
+            return FormatFloats(p, "v", &v.x, 3, precision);
+        });
+        WriteLines(ofs, result_face_count, 1 + 3 * (1 + max_index_chars), thread_count_, [&](char* p, size_t i) {
+            std::array<uint32_t, 3> v = child_face(i);
+            *p++ = 'f';
+            for (int k = 0; k < 3; ++k) {
+                *p++ = ' ';
+                p = FormatObjIndex(p, v[k]);
+            }
+            return p;
+        });
+    }
+    if (!ofs) {
+        spdlog::error("{}: Failed to write {}!", func_name, file_name);
+        return false;
+    }
+
+    spdlog::info("{}: {} triangles, {} vertexes streamed to {}", func_name, result_face_count, result_vertex_count, file_name);
+    return true;
+}
+
 const Subface::ProcessingMethod& Subface::GetProcessingMethod(EProcessingMethod method)
 {
     static std::vector<Subface::ProcessingMethod> processing_methods = {
@@ -1521,6 +4548,26 @@ const Subface::ProcessingMethod& Subface::GetProcessingMethod(EProcessingMethod
             [](Subface& sf, int level) {
                 sf.SimplygonDecimate(level);
             } }, // Alt + 5
+        { "QuadricDecimate",
+            [](Subface& sf, int level) {
+                sf.QuadricDecimate(level);
+            } }, // Alt + 6
+        { "ParallelQuadricDecimate",
+            [](Subface& sf, int level) {
+                sf.ParallelQuadricDecimate(level);
+            } }, // Alt + 7
+        { "VertexClusterDecimate",
+            [](Subface& sf, int level) {
+                sf.VertexClusterDecimate(level, false);
+            } }, // Alt + 8
+        { "VertexClusterDecimateQuadric",
+            [](Subface& sf, int level) {
+                sf.VertexClusterDecimate(level, true);
+            } }, // Alt + 9
+        { "PartitionedMeshoptDecimate",
+            [](Subface& sf, int level) {
+                sf.PartitionedMeshoptDecimate(level);
+            } }, // Alt + 0
     };
     return processing_methods[method];
 }
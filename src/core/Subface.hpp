@@ -10,6 +10,9 @@
 #include <SimplygonLoader.h>
 #endif
 
+#include "MeshIO.hpp"
+#include "OutputSink.hpp"
+
 namespace subface {
 
 constexpr float PI = 3.14159265358979323846f;
@@ -18,9 +21,12 @@ constexpr float PI = 3.14159265358979323846f;
 #define PREV(i) (((i) + 2) % 3)
 
 struct Face;
+class TriangleBvh;
 
 struct Vertex {
     glm::vec3 p;
+    // Dense index in the vertex list of the current result, assigned when the outputs are computed.
+    uint32_t index = 0;
     const Face* start_face = nullptr;
     Vertex* child = nullptr;
     bool regular = false;
@@ -54,6 +60,10 @@ struct Face {
     const Vertex* v[3];
     const Face* neighbors[3];
     Face* children[4];
+    // Attributes of the corners, as indexes into the attribute table of `Subface`. Only meaningful if attributes are carried.
+    uint32_t attributes[3];
+    // Dense index in the face list of a level, assigned where faces are looked up by it.
+    uint32_t index = 0;
 
     Face();
 
@@ -88,6 +98,67 @@ struct Face {
     }
 };
 
+// Face-varying attributes of a corner. Corners of the same vertex differ across seams, e.g. UV island borders and hard edges.
+struct CornerAttribute {
+    glm::vec3 normal;
+    glm::vec2 uv;
+
+    bool operator==(const CornerAttribute& a) const
+    {
+        return normal == a.normal && uv == a.uv;
+    }
+};
+
+// Levels of detail sharing one vertex buffer. The indexes of all the levels are concatenated, finest first.
+struct LodChain {
+    struct Range {
+        uint32_t index_offset;
+        uint32_t index_count;
+    };
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indexes;
+    // Range of each level in `indexes`.
+    std::vector<Range> lods;
+};
+
+// Compact copy of the indexed positions, smooth normals and indexes, for upload and export.
+struct QuantizedMesh {
+    // Each vertex has 3 unsigned normalized `q`, standing for `position_offset + position_scale * q / 65535` per axis.
+    glm::vec3 position_offset { 0.f };
+    glm::vec3 position_scale { 0.f };
+    std::vector<uint16_t> positions;
+    // Octahedral normals, 2 signed normalized components of `normal_bits` bits per vertex, in the vector of that size.
+    int normal_bits = 16;
+    std::vector<int8_t> normals_8;
+    std::vector<int16_t> normals_16;
+    // 16 bits if the vertex count allows, else 32 bits. Only one of them is filled.
+    std::vector<uint16_t> indexes_16;
+    std::vector<uint32_t> indexes_32;
+    // Max distance from the original positions, in model units.
+    float max_position_error = 0.f;
+    // Max angle from the original normals, in degrees.
+    float max_normal_error = 0.f;
+
+    size_t VertexCount() const
+    {
+        return positions.size() / 3;
+    }
+    size_t IndexCount() const
+    {
+        return indexes_16.empty() ? indexes_32.size() : indexes_16.size();
+    }
+    size_t ByteSize() const
+    {
+        return positions.size() * sizeof(uint16_t) + normals_8.size() * sizeof(int8_t) + normals_16.size() * sizeof(int16_t)
+            + indexes_16.size() * sizeof(uint16_t) + indexes_32.size() * sizeof(uint32_t);
+    }
+};
+
+// Octahedral mapping of unit vectors to [-1, 1]^2, see Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors", 2014.
+glm::vec2 OctahedralEncode(const glm::vec3& n);
+glm::vec3 OctahedralDecode(const glm::vec2& e);
+
 class MemoryPool {
     const size_t page_size_ = 4 * 1024 * 1024;
     std::vector<std::unique_ptr<char[]>> pool_;
@@ -110,30 +181,73 @@ public:
 
 class Subface {
     int level_ = 0;
+    int thread_count_ = 1;
+    // Cell size of the last vertex clustering, 0 for the original mesh.
+    float cluster_cell_size_ = 0.f;
+    // Maximum deviation from the original surface for the decimation methods, 0 for none.
+    float max_error_ = 0.f;
+    bool report_error_ = false;
+    bool optimize_vertex_order_ = false;
     size_t result_face_count_ = 0;
 
     std::vector<glm::vec3> origin_positions_;
     std::vector<uint32_t> origin_indexes_;
 
+    // Face-varying attributes, if carried. Identical corner attributes share one entry of the tables.
+    bool carry_normals_ = false;
+    bool carry_uvs_ = false;
+    std::vector<CornerAttribute> origin_attributes_;
+    // Per corner of `origin_indexes_`, into `origin_attributes_`.
+    std::vector<uint32_t> origin_attribute_indexes_;
+    // `origin_attributes_` and the attributes interpolated by the last processing, indexed by `Face::attributes`.
+    std::vector<CornerAttribute> attributes_;
+
+    // Topology of the original mesh, built once. Each processing starts from a clone of it, which is a copy plus a pointer fix-up.
+    std::vector<Vertex> origin_vertexes_;
+    std::vector<Face> origin_faces_;
+    // Base of the last subdivision or tessellation, whose faces and vertexes are linked to their children.
     std::vector<Vertex> vertexes_;
     std::vector<Face> faces_;
 
-    std::vector<glm::vec3> unindexed_positions_;
-    std::vector<glm::vec3> unindexed_smooth_normals_;
-    std::vector<glm::vec3> unindexed_flat_normals_;
-
+    // Outputs computed with each result. The smooth normals share the indexes of the positions.
     std::vector<glm::vec3> indexed_positions_;
     std::vector<glm::vec3> indexed_smooth_normals_;
-    std::vector<glm::vec3> indexed_flat_normals_;
-
     std::vector<int> vertex_indexes_;
-    std::vector<int> smooth_normal_indexes_;
-    std::vector<int> flat_normal_indexes_;
+    // Carried attributes of the result, empty if the last processing doesn't carry them.
+    std::vector<CornerAttribute> indexed_attributes_;
+    std::vector<int> attribute_indexes_;
+
+    // Outputs derived from the ones above on first access, and cached until the next result.
+    mutable std::vector<glm::vec3> indexed_flat_normals_;
+    mutable std::vector<glm::vec3> unindexed_positions_;
+    mutable std::vector<glm::vec3> unindexed_smooth_normals_;
+    mutable std::vector<glm::vec3> unindexed_flat_normals_;
+    mutable std::vector<glm::vec2> unindexed_uvs_;
+    mutable std::vector<glm::vec3> unindexed_attribute_normals_;
 
 #ifdef USE_SIMPLYGON
     Simplygon::ISimplygon* simplygon_ = nullptr;
 #endif
 
+    // Where the merged vertex of an edge collapse is placed. The edge cost follows the placement.
+    enum EDecimatePlacement {
+        DP_V0, // At v0. Cost is the edge length.
+        DP_Midpoint, // At the midpoint. Cost is the edge length.
+        DP_Quadric, // At the optimal position of the quadric error metric. Cost is the quadric error.
+    };
+    // Collapse sequence of the last edge collapse decimation, recorded as far as the decimations ask for.
+    class EdgeCollapseRecorder;
+    std::unique_ptr<EdgeCollapseRecorder> edge_collapses_;
+    // Whether the indexed outputs follow the current state of `edge_collapses_`, updated in place as it steps by a face.
+    bool live_decimation_ = false;
+    // Whether the indexed outputs were replaced as a whole since the last `TakeIndexedChanges()`, else the vertexes and corners
+    // changed in place since.
+    bool outputs_replaced_ = true;
+    std::vector<uint32_t> changed_vertexes_;
+    std::vector<uint32_t> changed_corners_;
+    // Closest point queries on the original mesh, built on the first measurement.
+    std::unique_ptr<TriangleBvh> origin_bvh_;
+
     // Only for non-boundary vertexes.
     static float Beta(int valence);
     // Only for non-boundary vertexes.
@@ -141,19 +255,73 @@ class Subface {
     static glm::vec3 WeightOneRing(Vertex* vertex, float beta);
     // Only for boundary vertexes.
     static glm::vec3 WeightBoundary(Vertex* v, float beta);
+    // Position of the child of `v`.
+    static glm::vec3 VertexPoint(Vertex* v, bool flat);
+    // Position of the vertex added on edge `vi` of `f`.
+    static glm::vec3 EdgePoint(const Face* f, int vi, bool flat);
     static void BuildTopology(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes,
         std::vector<Vertex>& vertexes, std::vector<Face>& faces);
-
-    void ComputeNormalsAndPositions(const std::vector<Vertex*>& vertexes, const std::vector<Face*>& faces);
+    // Copy `vertexes_src` and `faces_src` and re-target the copied pointers to the copies. Links to children are cleared.
+    static void CloneTopology(const std::vector<Vertex>& vertexes_src, const std::vector<Face>& faces_src,
+        std::vector<Vertex>& vertexes, std::vector<Face>& faces);
+    // Reset `vertexes_` and `faces_` to a clone of the original topology and point the bases of a subdivision to them.
+    void ResetBase(std::vector<Vertex*>& vertexes_base, std::vector<Face*>& faces_base);
+    // Subdivide the bases `level` times, allocating the new vertexes and faces from `mp`.
+    void LoopSubdivideLevels(int level, bool flat, bool carry_attributes, MemoryPool& mp,
+        std::vector<Vertex*>& vertexes_base, std::vector<Face*>& faces_base);
+
+    // Also outputs the attributes of the faces from `attributes_` if `carry_attributes==true`.
+    void ComputeNormalsAndPositions(const std::vector<Vertex*>& vertexes, const std::vector<Face*>& faces, bool carry_attributes = false);
+    // Outputs of a result that needs no topology, e.g. a decimation, straight from its index buffer.
+    // Smooth normals are angle weighted averages of the face normals instead of the limit normals.
+    // Also outputs the attributes from `attributes_` if `corner_attributes`, one per index, isn't empty.
+    void ComputeIndexedOutputs(std::vector<glm::vec3>&& positions, const std::vector<uint32_t>& indexes, const std::vector<uint32_t>& corner_attributes = {});
+    // Common end of the above. `vertexes` may be empty if the outputs weren't computed from a topology.
+    void FinishOutputs(const std::vector<Vertex*>& vertexes, const std::vector<uint32_t>& corner_attributes);
+    // Free the outputs derived from the indexed ones, which are stale.
+    void FreeDerivedOutputs();
+    // Reorder the faces of the outputs for the post-transform vertex cache and overdraw, then the vertexes and attributes for fetch locality.
+    // `vertexes` are the ones the outputs were computed from, if any. Their indexes are updated.
+    void ReorderOutputs(const std::vector<Vertex*>& vertexes);
     bool CheckLevel(const std::string& func_name, int level, int base);
+    void EdgeCollapseDecimate(const std::string& func_name, int level, EDecimatePlacement placement);
+    // Update the indexed outputs to the current state of `edge_collapses_` in place, from the vertexes and corners it changed, or
+    // fill them from it in O(n) if they don't follow it yet.
+    void StepIndexedOutputs();
+    // One-sided Hausdorff distances from a result indexing `positions` to the original mesh, and back.
+    void MeasureDeviation(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, float& to_origin, float& from_origin);
+    // Symmetric Hausdorff distance between a result and the original mesh.
+    float Deviation(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes);
+    // Log the Hausdorff distances of a decimation result if `ReportError()` or `MaxError()` is set.
+    void ReportDeviation(const std::string& func_name, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes);
 
 public:
     Subface();
     ~Subface();
     void BuildTopology(const std::vector<glm::vec3>& vertexes, const std::vector<uint32_t>& indexes);
+    // Also carry per-corner `normals` and `uvs`, given for each of `indexes` or empty.
+    // Smooth subdivision weighs them with the Loop stencils of the positions, with the seams as creases, so seams stay sharp.
+    // Flat subdivision and tessellation interpolate them linearly in each face.
+    // Decimate_ShortestEdge_*, QuadricDecimate, MeshoptDecimate and MeshoptDecimateSloppy keep the seams and carry them. The other methods drop them.
+    void BuildTopology(const std::vector<glm::vec3>& vertexes, const std::vector<uint32_t>& indexes,
+        const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& uvs);
+    // Same as above, from arrays that needn't be vectors, e.g. a memory-mapped `BinaryMesh`. They are copied, so they needn't outlive the call.
+    // The attributes are carried if `mesh` has them.
+    void BuildTopology(const MeshView& mesh);
     // Same as Tessellate4(int level) if `flat==true`.
     // `compute_limit` matters only when `flat==false`.
     void LoopSubdivide(int level, bool flat, bool compute_limit);
+    enum EStreamFormat {
+        SF_Obj = 0,
+        SF_Ply = 1,
+    };
+    // Same result as `LoopSubdivide()`, but the last level is never built. Its vertexes and faces are computed from the level before,
+    // in blocks formatted in parallel, and written straight to `file_name` as OBJ with `precision` as in `ExportObj()`, or as binary PLY.
+    // The level before the last stays in memory, with its topology and vertex points, so the memory still grows with the result, but
+    // as about a quarter of it instead of all of it. Only the positions and the faces are written, without the vertex reordering, and
+    // attributes aren't carried. Limit positions next to flipped neighbors may differ in rounding. The outputs are left empty.
+    // Returns false if `level < 1`, the result needs indexes of more than 31 bits or the file can't be written.
+    bool StreamLoopSubdivide(int level, bool flat, bool compute_limit, const std::string& file_name, EStreamFormat format, int precision = -1);
     // Same as LoopSubdivide(int level, bool flat=true).
     void Tessellate4(int level);
     // Another 1-to-4 triangle tessellation pattern than `Tessellate4()`.
@@ -169,7 +337,40 @@ public:
     void Decimate(int level, bool midpoint);
     void MeshoptDecimate(int level, bool sloppy);
     void SimplygonDecimate(int level);
-    void ExportObj(const std::string& file_name, bool smooth) const;
+    // Garland-Heckbert quadric error metric decimation on the topology of this class.
+    // Merged vertexes are placed at the optimal positions of the summed quadrics. Edges whose collapse would flip a face are kept.
+    void QuadricDecimate(int level);
+    // Same metric as `QuadricDecimate()`, but each round collapses a set of cheap edges with disjoint neighborhoods concurrently.
+    // The result doesn't depend on the thread count.
+    void ParallelQuadricDecimate(int level);
+    // Merge the vertexes in each cell of a uniform grid in O(n), for previews of huge meshes.
+    // The cell size is estimated from the surface area, so the face count only approximates the level.
+    // if `quadric==false`:
+    //     Place the merged vertexes at the means of the cells.
+    // else:
+    //     Place the merged vertexes at the optimal positions of the cells' quadrics if they are in the cells.
+    void VertexClusterDecimate(int level, bool quadric);
+    // `MeshoptDecimate()` on spatial clusters of faces in Morton order, each cluster on its own thread with the vertexes shared by other
+    // clusters locked. A second pass simplifies the faces around the seams the same way in clusters, with the vertexes they share with
+    // the rest locked.
+    // The result doesn't depend on the thread count.
+    void PartitionedMeshoptDecimate(int level);
+    // Carried UVs are exported too. Carried normals are exported instead of the computed ones, ignoring `smooth`.
+    // Numbers are written with the fewest digits reading back the same floats if `precision < 0`, else with at most
+    // `precision` (up to 9) decimals. Blocks of lines are formatted in parallel, then written in order.
+    void ExportObj(const std::string& file_name, bool smooth, int precision = -1) const;
+    // Binary little-endian PLY of the indexed positions, and the smooth normals if `smooth==true`. Carried attributes aren't exported.
+    void ExportPly(const std::string& file_name, bool smooth) const;
+    // Binary STL of the faces with their flat normals.
+    void ExportStl(const std::string& file_name) const;
+    // glTF 2.0 binary of the indexed positions, the smooth normals if `smooth==true`, and the carried attributes, in one interleaved
+    // vertex buffer and an index buffer of 16 bits where possible. Without normals, clients compute flat ones. Positions and normals are
+    // floats if `quantize_normal_bits==0`, else 16-bit positions dequantized by the node transform and normals of 8 or 16 bits,
+    // under KHR_mesh_quantization. The file is built in memory and written at once.
+    void ExportGlb(const std::string& file_name, bool smooth, int quantize_normal_bits = 0) const;
+    // Compressed binary mesh (.sfz) of the indexed positions, and per corner the carried UVs and the normals as in `ExportObj()`, which
+    // loads back as the same mesh. The index codec is the most effective on faces in vertex cache order, see `OptimizeVertexOrder()`.
+    void ExportSfz(const std::string& file_name, bool smooth) const;
 
     enum EProcessingMethod {
         PM_SubdivideSmooth = 0,
@@ -186,9 +387,14 @@ public:
         PM_MeshoptDecimate = 8,
         PM_MeshoptDecimateSloppy = 9,
         PM_SimplygonDecimate = 10,
-
-        PM_Decimate_End = 11,
-        PM_Count = 11,
+        PM_QuadricDecimate = 11,
+        PM_ParallelQuadricDecimate = 12,
+        PM_VertexClusterDecimate = 13,
+        PM_VertexClusterDecimateQuadric = 14,
+        PM_PartitionedMeshoptDecimate = 15,
+
+        PM_Decimate_End = 16,
+        PM_Count = 16,
     };
     struct ProcessingMethod {
         std::string name;
@@ -196,18 +402,94 @@ public:
     };
     static const Subface::ProcessingMethod& GetProcessingMethod(EProcessingMethod method);
 
-    const std::vector<glm::vec3>& Position() const
+    // Levels 0 (the original mesh) to 9 in one pass, each decimated from the previous one, sharing the vertexes they have in common:
+    //     PM_Decimate_ShortestEdge_*, PM_QuadricDecimate: levels are states of one recorded collapse sequence. A merged vertex the
+    //         collapse moves is a new vertex of the levels from there on, so only `PM_Decimate_ShortestEdge_V0` never adds vertexes.
+    //     PM_MeshoptDecimate, PM_MeshoptDecimateSloppy: each level simplifies the index buffer of the previous one.
+    // Logs an error and returns an empty chain for the other methods.
+    LodChain BuildLodChain(EProcessingMethod method);
+    // One object per level, sharing the vertexes. `precision` is the same as in `ExportObj()`. Blocks of lines are formatted by
+    // `thread_count` threads, 0 for all the hardware threads.
+    static void ExportLodChainObj(const std::string& file_name, const LodChain& chain, int precision = -1, int thread_count = 0);
+    // One glTF mesh per level, sharing the vertex and index buffers, with the coarser levels as MSFT_lod levels of the finest one.
+    // Positions are quantized as in `ExportGlb()` if `quantize==true`. The buffers are filled by `thread_count` threads, 0 for all the
+    // hardware threads.
+    static void ExportLodChainGlb(const std::string& file_name, const LodChain& chain, bool quantize, int thread_count = 0);
+
+    // Quantize the indexed positions and smooth normals of the last result, with octahedral normals of `normal_bits` 8 or 16.
+    // Logs the size and the errors. Uses 6 bytes per vertex for the positions, 2 or 4 for the normals, and 2 bytes per index
+    // for less than 65536 vertexes, instead of 24 bytes per vertex and 4 per index.
+    QuantizedMesh Quantize(int normal_bits = 16) const;
+
+    // Maximum symmetric Hausdorff distance to the original surface, in model units. 0 (default) disables the bound.
+    // If set, levels 1-9 of the Decimate_ShortestEdge_*, QuadricDecimate and MeshoptDecimate* methods give the smallest mesh
+    // their search finds within the bound, measured rather than estimated, instead of a face ratio. Levels 0, -1 and -2 work as usual.
+    void MaxError(float max_error)
     {
-        return unindexed_positions_;
+        max_error_ = max_error > 0.f ? max_error : 0.f;
     }
-    const std::vector<glm::vec3>& NormalSmooth() const
+    // Log the one-sided and symmetric Hausdorff distances between each decimation result and the original mesh.
+    void ReportError(bool report_error)
     {
-        return unindexed_smooth_normals_;
+        report_error_ = report_error;
     }
-    const std::vector<glm::vec3>& NormalFlat() const
+    // Reorder the faces of each result for the GPU post-transform vertex cache (Forsyth's linear-speed optimizer) and for less overdraw,
+    // then the vertexes in the order the faces use them. Logs the average cache miss ratio before and after.
+    // Affects the indexed outputs and the exports. Unused vertexes are dropped.
+    void OptimizeVertexOrder(bool optimize)
     {
-        return unindexed_flat_normals_;
+        optimize_vertex_order_ = optimize;
     }
+    // Threads used by the parallel methods. Uses all the hardware threads by default.
+    void ThreadCount(int thread_count)
+    {
+        thread_count_ = thread_count > 0 ? thread_count : 1;
+    }
+
+    // Outputs of the last processing. Apart from the indexed positions, smooth normals and indexes,
+    // they are computed on first access and cached until the next processing, so don't call them concurrently.
+
+    // Per corner, 3 per face.
+    const std::vector<glm::vec3>& Position() const;
+    const std::vector<glm::vec3>& NormalSmooth() const;
+    const std::vector<glm::vec3>& NormalFlat() const;
+    // Carried attributes per corner. Empty if not carried.
+    const std::vector<glm::vec2>& UV() const;
+    const std::vector<glm::vec3>& NormalAttribute() const;
+    // Per vertex, indexed by `Index()`.
+    const std::vector<glm::vec3>& IndexedPosition() const
+    {
+        return indexed_positions_;
+    }
+    const std::vector<glm::vec3>& IndexedNormalSmooth() const
+    {
+        return indexed_smooth_normals_;
+    }
+    // Per face.
+    const std::vector<glm::vec3>& IndexedNormalFlat() const;
+    // Vertex indexes of the faces, 3 per face.
+    const std::vector<int>& Index() const
+    {
+        return vertex_indexes_;
+    }
+
+    // Write an output straight into caller memory, e.g. a mapped GL buffer or a memory-mapped file, instead of returning
+    // a vector that the caller copies again. Uncached outputs are expanded into the sink in parallel and aren't cached.
+    // Return false if the sink refuses the output.
+    bool WritePosition(OutputSink<glm::vec3>& sink) const;
+    bool WriteNormalSmooth(OutputSink<glm::vec3>& sink) const;
+    bool WriteNormalFlat(OutputSink<glm::vec3>& sink) const;
+    bool WriteIndexedPosition(OutputSink<glm::vec3>& sink) const;
+    bool WriteIndexedNormalSmooth(OutputSink<glm::vec3>& sink) const;
+    bool WriteIndex(OutputSink<uint32_t>& sink) const;
+
+    // Move the indexed vertexes and the corners of `Index()` changed in place since the last call to `vertexes` and `corners`, for
+    // updating copies of the indexed outputs, e.g. GL buffers, instead of copying them again. Both may repeat, and `corners` may be
+    // past `Index()`. Returns false if the outputs were replaced as a whole instead, e.g. by another processing.
+    // Only levels -1 and -2 of the Decimate_ShortestEdge_* and QuadricDecimate methods change them in place, unless the vertex
+    // order is optimized. Their results keep all the original vertexes, the unused ones included, so the vertex count stays the
+    // same, and their faces aren't in the original order.
+    bool TakeIndexedChanges(std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners);
 };
 
 }
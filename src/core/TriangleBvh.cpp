@@ -0,0 +1,191 @@
+#include "TriangleBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Parallel.hpp"
+
+namespace subface {
+
+static glm::vec3 ClosestPointOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 ab = b - a;
+    float length2 = glm::dot(ab, ab);
+    return length2 > 0.f ? a + ab * std::min(std::max(glm::dot(p - a, ab) / length2, 0.f), 1.f) : a;
+}
+
+// Closest point on triangle `abc` to `p`, by the Voronoi regions of its features (Ericson, "Real-Time Collision Detection", 5.1.5).
+static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+        return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+        return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+        return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+        return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+        return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    // Inside the face.
+    float sum = va + vb + vc;
+    if (sum > 0.f)
+        return a + ab * (vb / sum) + ac * (vc / sum);
+
+    // Degenerate triangle. The closest point is on one of its edges.
+    glm::vec3 q[3] = { ClosestPointOnSegment(p, a, b), ClosestPointOnSegment(p, b, c), ClosestPointOnSegment(p, c, a) };
+    float d[3] = { glm::dot(p - q[0], p - q[0]), glm::dot(p - q[1], p - q[1]), glm::dot(p - q[2], p - q[2]) };
+    return q[std::min_element(d, d + 3) - d];
+}
+
+static float SquaredBoxDistance(const glm::vec3& p, const glm::vec3& lower, const glm::vec3& upper)
+{
+    glm::vec3 d = glm::max(glm::max(lower - p, p - upper), glm::vec3(0.f));
+    return glm::dot(d, d);
+}
+
+TriangleBvh::TriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes)
+    : positions_(positions)
+    , indexes_(indexes)
+{
+    uint32_t triangle_count = static_cast<uint32_t>(indexes.size() / 3);
+    if (triangle_count == 0)
+        return;
+
+    std::vector<glm::vec3> centroids(triangle_count);
+    triangles_.resize(triangle_count);
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        centroids[t] = (positions[indexes[t * 3]] + positions[indexes[t * 3 + 1]] + positions[indexes[t * 3 + 2]]) / 3.f;
+        triangles_[t] = t;
+    }
+    // A binary tree with leaves of at least 2 triangles has less than `triangle_count` nodes.
+    nodes_.reserve(triangle_count);
+    nodes_.push_back({});
+    Build(0, 0, triangle_count, centroids);
+}
+
+void TriangleBvh::Build(uint32_t node, uint32_t begin, uint32_t end, std::vector<glm::vec3>& centroids)
+{
+    constexpr uint32_t leaf_size = 4;
+
+    glm::vec3 lower = positions_[indexes_[triangles_[begin] * 3]], upper = lower;
+    glm::vec3 centroid_lower = centroids[triangles_[begin]], centroid_upper = centroid_lower;
+    for (uint32_t i = begin; i < end; ++i) {
+        uint32_t t = triangles_[i];
+        for (int j = 0; j < 3; ++j) {
+            lower = glm::min(lower, positions_[indexes_[t * 3 + j]]);
+            upper = glm::max(upper, positions_[indexes_[t * 3 + j]]);
+        }
+        centroid_lower = glm::min(centroid_lower, centroids[t]);
+        centroid_upper = glm::max(centroid_upper, centroids[t]);
+    }
+    nodes_[node].lower = lower;
+    nodes_[node].upper = upper;
+    if (end - begin <= leaf_size) {
+        nodes_[node].first = begin;
+        nodes_[node].count = end - begin;
+        return;
+    }
+
+    glm::vec3 extent = centroid_upper - centroid_lower;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(triangles_.begin() + begin, triangles_.begin() + mid, triangles_.begin() + end, [&](uint32_t a, uint32_t b) {
+        return centroids[a][axis] < centroids[b][axis];
+    });
+
+    uint32_t child = static_cast<uint32_t>(nodes_.size());
+    nodes_[node].first = child;
+    nodes_[node].count = 0;
+    nodes_.push_back({});
+    nodes_.push_back({});
+    Build(child, begin, mid, centroids);
+    Build(child + 1, mid, end, centroids);
+}
+
+float TriangleBvh::SquaredDistance(const glm::vec3& p, float bound, float stop) const
+{
+    if (nodes_.empty())
+        return bound;
+
+    // Depth-first, nearer child first. The depth of the balanced tree is about log2(n / leaf_size).
+    uint32_t stack[64];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0) {
+        const Node& node = nodes_[stack[--size]];
+        if (SquaredBoxDistance(p, node.lower, node.upper) >= bound)
+            continue;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const uint32_t* t = &indexes_[triangles_[i] * 3];
+                glm::vec3 d = p - ClosestPointOnTriangle(p, positions_[t[0]], positions_[t[1]], positions_[t[2]]);
+                bound = std::min(bound, glm::dot(d, d));
+            }
+            if (bound <= stop)
+                return bound;
+            continue;
+        }
+        const Node& a = nodes_[node.first];
+        const Node& b = nodes_[node.first + 1];
+        bool a_first = SquaredBoxDistance(p, a.lower, a.upper) <= SquaredBoxDistance(p, b.lower, b.upper);
+        // Push the farther child first so that the nearer one is popped first.
+        stack[size++] = a_first ? node.first + 1 : node.first;
+        stack[size++] = a_first ? node.first : node.first + 1;
+    }
+    return bound;
+}
+
+float OneSidedHausdorff(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, const TriangleBvh& to, int thread_count)
+{
+    size_t face_count = indexes.size() / 3;
+    if (face_count == 0)
+        return 0.f;
+    if (to.Empty())
+        return std::numeric_limits<float>::infinity();
+
+    // Maximum per thread, merged afterwards. The maximum doesn't depend on the split.
+    std::vector<float> maximums(std::max(1, thread_count), 0.f);
+    ParallelFor(face_count, thread_count, [&](size_t begin, size_t end, int t) {
+        float maximum = 0.f;
+        // A sample within the current maximum can't raise it, so its query stops at the first triangle within the maximum.
+        auto sample = [&](const glm::vec3& p) {
+            maximum = std::max(maximum, to.SquaredDistance(p, std::numeric_limits<float>::infinity(), maximum));
+        };
+        for (size_t f = begin; f < end; ++f) {
+            const glm::vec3& p0 = positions[indexes[f * 3]];
+            const glm::vec3& p1 = positions[indexes[f * 3 + 1]];
+            const glm::vec3& p2 = positions[indexes[f * 3 + 2]];
+            // Vertexes and edges shared by several faces are sampled once per face. Repeats only cost time.
+            sample(p0);
+            sample(p1);
+            sample(p2);
+            sample((p0 + p1) * 0.5f);
+            sample((p1 + p2) * 0.5f);
+            sample((p2 + p0) * 0.5f);
+            sample((p0 + p1 + p2) / 3.f);
+        }
+        maximums[t] = maximum;
+    });
+    return std::sqrt(*std::max_element(maximums.begin(), maximums.end()));
+}
+
+}
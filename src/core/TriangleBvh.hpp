@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace subface {
+
+// Bounding volume hierarchy of axis-aligned boxes over the triangles of an indexed mesh, for closest point queries.
+// Nodes are split at the median centroid along the longest axis, so the tree is balanced and built in O(n log n).
+class TriangleBvh {
+    struct Node {
+        glm::vec3 lower, upper;
+        // Leaves hold `count > 0` triangles from `triangles_[first]`. Inner nodes have `count == 0` and children `first` and `first + 1`.
+        uint32_t first, count;
+    };
+
+    const std::vector<glm::vec3>& positions_;
+    const std::vector<uint32_t>& indexes_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> triangles_;
+
+    void Build(uint32_t node, uint32_t begin, uint32_t end, std::vector<glm::vec3>& centroids);
+
+public:
+    // `positions` and `indexes` are referenced, not copied, and must outlive the hierarchy.
+    TriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes);
+
+    bool Empty() const
+    {
+        return nodes_.empty();
+    }
+    // Squared distance from `p` to the closest triangle, skipping the subtrees farther than `bound` (squared).
+    // Returns `bound` if there is no closer triangle. Stops early with any distance no more than `stop` (squared) once one is found.
+    float SquaredDistance(const glm::vec3& p, float bound, float stop = 0.f) const;
+};
+
+// One-sided Hausdorff distance from the surface of mesh A to the surface `to` of mesh B, i.e. how far A strays from B.
+// A is sampled at its vertexes, edge midpoints and face centroids. Returns 0 if A is empty, and infinity if only B is.
+float OneSidedHausdorff(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indexes, const TriangleBvh& to, int thread_count);
+
+}
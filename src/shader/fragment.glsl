@@ -9,11 +9,25 @@ vertexIn;
 
 uniform mat4 mv;
 uniform int wireframe;
+// Shade the faces flat, with the normals of their planes instead of the vertex normals. Lines have no plane, so they keep the
+// vertex normals.
+uniform int flat_normal;
+uniform int lines;
 
 out vec4 color;
 
+vec3 Normal()
+{
+    if (flat_normal == 1 && lines == 0) {
+        // Toward the eye for both sides, so flip it for the back faces.
+        vec3 n = normalize(cross(dFdx(vertexIn.position), dFdy(vertexIn.position)));
+        return gl_FrontFacing ? n : -n;
+    }
+    return normalize(vertexIn.normal);
+}
+
 // Blinn-Phong shading
-vec3 Lighting(vec3 light_position, float light_power, int light_n)
+vec3 Lighting(vec3 light_position, vec3 normal, float light_power, int light_n)
 {
     vec3 light_color = vec3(1.f, 1.f, 1.f);
 
@@ -29,7 +43,6 @@ vec3 Lighting(vec3 light_position, float light_power, int light_n)
     distance *= distance;
 
     light_direction = normalize(light_direction);
-    vec3 normal = normalize(vertexIn.normal);
     float cos_theta = clamp(dot(normal, light_direction), 0.f, 1.f);
     float lambertian = clamp(cos_theta, 0.f, 1.f);
 
@@ -53,10 +66,11 @@ void main()
     vec3 light_position_0 = (mv * vec4(20.f, 20.f, 10.f, 1.f)).xyz;
     vec3 light_position_1 = (mv * vec4(-20.f, 10.f, -10.f, 1.f)).xyz;
 
+    vec3 normal = Normal();
     vec3 c = vec3(0.f);
 
-    c += Lighting(light_position_0, 40.f, 2);
-    c += Lighting(light_position_1, 30.f, 2);
+    c += Lighting(light_position_0, normal, 40.f, 2);
+    c += Lighting(light_position_1, normal, 30.f, 2);
     // c = vec4(1.f, 1.f, 1.f, 1.f);
     // c = vertexIn.normal;
 
@@ -5,6 +5,11 @@ layout(location = 1) in vec3 normal;
 
 uniform mat4 mvp;
 uniform mat4 mv;
+// Quantized vertexes: unsigned normalized positions relative to the bounds, and octahedral normals scaled by `normal_max`.
+uniform int quantized;
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform float normal_max;
 
 out Attribute
 {
@@ -13,10 +18,24 @@ out Attribute
 }
 vertexOut;
 
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+    return normalize(n);
+}
+
 void main()
 {
-    gl_Position = mvp * vec4(position, 1.f);
-    vertexOut.position = (mv * vec4(position, 1.f)).xyz;
-    vertexOut.normal = (mv * vec4(normal, 0.f)).xyz;
+    vec3 p = position;
+    vec3 n = normal;
+    if (quantized == 1) {
+        p = position_offset + position_scale * position;
+        n = OctahedralDecode(clamp(normal.xy / normal_max, -1.f, 1.f));
+    }
+    gl_Position = mvp * vec4(p, 1.f);
+    vertexOut.position = (mv * vec4(p, 1.f)).xyz;
+    vertexOut.normal = (mv * vec4(n, 0.f)).xyz;
     // vertexOut.normal = normal;
 }
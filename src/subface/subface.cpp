@@ -3,9 +3,9 @@
 #include <argparse/argparse.hpp>
 #include <spdlog/spdlog.h>
 
-#include "Model.hpp"
 #include "OGL.hpp"
 
+#include "MeshIO.hpp"
 #include "Subface.hpp"
 using namespace subface;
 
@@ -18,15 +18,15 @@ int main(int argc, char* argv[])
         description += fmt::format("    {}.{}\n", i + 1, Subface::GetProcessingMethod(static_cast<Subface::EProcessingMethod>(i)).name);
     program.add_description(description);
     // Positional arguments.
-    program.add_argument("OBJ_file_path")
-        .help("OBJ file path");
+    program.add_argument("file_path")
+        .help("OBJ, PLY, STL, binary mesh (.sfm) or compressed mesh (.sfz) file path");
     // Optional arguments giving flags.
     program.add_argument("--cmd", "-c")
-        .help("run in command line mode")
+        .help("run in command line mode, with no window or GL context unless saving PNG")
         .default_value(false)
         .implicit_value(true);
     program.add_argument("--export_obj", "-e")
-        .help("export OBJ in command line mode")
+        .help("export the result in command line mode, in the format of --export_format")
         .default_value(false)
         .implicit_value(true);
     program.add_argument("--save_png", "-s")
@@ -49,6 +49,30 @@ int main(int argc, char* argv[])
         .help("enable transparent window")
         .default_value(false)
         .implicit_value(true);
+    program.add_argument("--lod_chain", "-d")
+        .help("export levels 0-9 of the decimation method as one OBJ sharing the vertexes, or as MSFT_lod levels of one glb with --export_format glb, then exit")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--report_error", "-p")
+        .help("log the Hausdorff distances between each decimation result and the original mesh")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--attributes", "-a")
+        .help("carry the UVs and normals of the OBJ through subdivision and decimation, and export them")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--binary", "-b")
+        .help("convert the mesh to a binary mesh (.sfm) next to it, or to a compressed one (.sfz) with --export_format sfz, then exit")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--optimize", "-o")
+        .help("reorder the faces of each result for the vertex cache and overdraw, and the vertexes for fetch locality")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--stream", "-k")
+        .help("write the last level of methods 1-3 straight to a file in the format of --export_format, obj or ply, without keeping it in memory, then exit")
+        .default_value(false)
+        .implicit_value(true);
     // Optional arguments giving values.
     program.add_argument("--render", "-r")
         .help("render mode ID")
@@ -62,6 +86,25 @@ int main(int argc, char* argv[])
         .help("processing level")
         .default_value(0)
         .scan<'i', int>();
+    program.add_argument("--threads", "-j")
+        .help("thread count of loading and the parallel methods, 0 for all the hardware threads")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--quantize", "-q")
+        .help("draw with 16-bit positions, octahedral smooth normals of 8 or 16 bits and 16-bit indexes where possible, and export glb with 16-bit positions and normals of 8 or 16 bits, 0 for floats")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--precision", "-g")
+        .help("decimals of the exported OBJ numbers to shrink the files, -1 for the fewest digits reading back the same floats")
+        .default_value(-1)
+        .scan<'i', int>();
+    program.add_argument("--export_format", "-w")
+        .help("format of the exported results: obj, ply (binary), stl (binary), glb (glTF binary) or sfz (compressed mesh)")
+        .default_value(std::string("obj"));
+    program.add_argument("--max_error", "-x")
+        .help("max Hausdorff distance to the original mesh, making levels 1-9 of methods 7-10 and 12 give the smallest mesh within it, 0 for none")
+        .default_value(0.f)
+        .scan<'g', float>();
     // Parse arguments.
     try {
         program.parse_args(argc, argv);
@@ -72,7 +115,7 @@ int main(int argc, char* argv[])
         std::exit(1);
     }
     // Get parsed arguments.
-    const std::string file_path = program.get<std::string>("OBJ_file_path");
+    const std::string file_path = program.get<std::string>("file_path");
     bool cmd_mode = program.get<bool>("--cmd");
     bool cmd_export_obj = program.get<bool>("--export_obj");
     bool cmd_save_png = program.get<bool>("--save_png");
@@ -80,9 +123,122 @@ int main(int argc, char* argv[])
     bool fix_camera = program.get<bool>("--fix_camera");
     bool cull_face = program.get<bool>("--cull");
     bool transparent_window = program.get<bool>("--transparent");
+    bool lod_chain = program.get<bool>("--lod_chain");
+    bool report_error = program.get<bool>("--report_error");
+    bool carry_attributes = program.get<bool>("--attributes");
+    bool optimize_vertex_order = program.get<bool>("--optimize");
+    bool convert_binary = program.get<bool>("--binary");
+    bool stream = program.get<bool>("--stream");
     OGL::ERenderMode render_mode = static_cast<OGL::ERenderMode>(program.get<int>("--render") % OGL::RM_Count);
     Subface::EProcessingMethod method = static_cast<Subface::EProcessingMethod>((program.get<int>("--method") - 1 + Subface::PM_Count) % Subface::PM_Count);
     int level = program.get<int>("--level") % 10;
+    int thread_count = program.get<int>("--threads");
+    float max_error = program.get<float>("--max_error");
+    int precision = program.get<int>("--precision");
+    std::string export_format = program.get<std::string>("--export_format");
+    if (export_format != "obj" && export_format != "ply" && export_format != "stl" && export_format != "glb" && export_format != "sfz") {
+        std::cerr << "Unknown export format: " << export_format << std::endl;
+        std::exit(1);
+    }
+    int quantize_normal_bits = program.get<int>("--quantize");
+
+    std::string file_stem = file_path.substr(0, file_path.find_last_of('.'));
+    MeshData mesh;
+    BinaryMesh binary_mesh;
+    MeshView view;
+    if (file_path.size() >= 4 && file_path.compare(file_path.size() - 4, 4, ".sfm") == 0) {
+        // The view reads from the mapping of the file, which a conversion to .sfm would overwrite.
+        if (convert_binary && export_format != "sfz") {
+            std::cerr << "The mesh is already a binary mesh. Use --export_format sfz to convert it to a compressed one." << std::endl;
+            return 1;
+        }
+        if (!binary_mesh.Load(file_path, thread_count))
+            return 1;
+        view = binary_mesh.View();
+    } else {
+        // The per-corner attributes are only read when they are carried or converted.
+        if (!LoadMesh(file_path, mesh, thread_count, carry_attributes || convert_binary ? LP_Full : LP_Geometry))
+            return 1;
+        view = mesh.View();
+    }
+    if (convert_binary) {
+        if (export_format == "sfz")
+            return SaveCompressedMesh(file_stem + ".sfz", view, thread_count) ? 0 : 1;
+        return SaveBinaryMesh(file_stem + ".sfm", view) ? 0 : 1;
+    }
+
+    Subface sf;
+    if (thread_count > 0)
+        sf.ThreadCount(thread_count);
+    sf.MaxError(max_error);
+    sf.ReportError(report_error);
+    sf.OptimizeVertexOrder(optimize_vertex_order);
+    // A mapped binary mesh has them anyway.
+    if (!carry_attributes) {
+        view.normals = nullptr;
+        view.uvs = nullptr;
+    }
+    sf.BuildTopology(view);
+    // The topology keeps its own copy. A mapped binary mesh is in the page cache, so it costs no process memory.
+    mesh = MeshData();
+
+    auto get_processing_info = [&](bool smooth) {
+        return fmt::format("{}.Normal_{}",
+            level == 0 ? "origin" : fmt::format("{}(level={})", Subface::GetProcessingMethod(method).name, level),
+            smooth ? "smooth" : "flat");
+    };
+    auto export_result = [&](bool smooth) {
+        std::string file_name = fmt::format("{}.{}.{}",
+            file_stem,
+            get_processing_info(smooth), export_format);
+        if (export_format == "ply")
+            sf.ExportPly(file_name, smooth);
+        else if (export_format == "stl")
+            sf.ExportStl(file_name);
+        else if (export_format == "glb")
+            sf.ExportGlb(file_name, smooth, quantize_normal_bits);
+        else if (export_format == "sfz")
+            sf.ExportSfz(file_name, smooth);
+        else
+            sf.ExportObj(file_name, smooth, precision);
+    };
+
+    if (stream) {
+        if (method > Subface::PM_SubdivideFlat || (export_format != "obj" && export_format != "ply")) {
+            std::cerr << "Only methods 1-3 can be streamed, to obj or ply." << std::endl;
+            return 1;
+        }
+        // Only the positions are written, so clients compute flat normals.
+        std::string file_name = fmt::format("{}.{}.{}",
+            file_stem,
+            get_processing_info(false), export_format);
+        bool streamed = sf.StreamLoopSubdivide(level, method == Subface::PM_SubdivideFlat, method == Subface::PM_SubdivideSmooth, file_name,
+            export_format == "ply" ? Subface::SF_Ply : Subface::SF_Obj, precision);
+        return streamed ? 0 : 1;
+    }
+    if (lod_chain) {
+        bool glb = export_format == "glb";
+        std::string file_name = fmt::format("{}.{}.lods.{}",
+            file_stem,
+            Subface::GetProcessingMethod(method).name, glb ? "glb" : "obj");
+        LodChain chain = sf.BuildLodChain(method);
+        if (chain.lods.empty()) {
+            std::cerr << "Method " << Subface::GetProcessingMethod(method).name << " has no LOD chain." << std::endl;
+            return 1;
+        }
+        if (glb)
+            Subface::ExportLodChainGlb(file_name, chain, quantize_normal_bits != 0, thread_count);
+        else
+            Subface::ExportLodChainObj(file_name, chain, precision, thread_count);
+        return 0;
+    }
+    // Nothing to draw, so don't create a window or a GL context.
+    if (cmd_mode && !cmd_save_png) {
+        Subface::GetProcessingMethod(method).process(sf, level);
+        if (cmd_export_obj)
+            export_result(arg_smooth_normal);
+        return 0;
+    }
 
     int window_w = 1280;
     int window_h = 720;
@@ -95,40 +251,44 @@ int main(int argc, char* argv[])
     ogl.RenderMode(render_mode);
     ogl.FixCamera(fix_camera);
 
-    Toggle use_smooth_normal(ogl.window(), GLFW_KEY_N, arg_smooth_normal);
+    // Quantized meshes are indexed, so they only have smooth normals.
+    Toggle use_smooth_normal(ogl.window(), GLFW_KEY_N, arg_smooth_normal || quantize_normal_bits);
     Toggle decimate_one_less_face(ogl.window(), GLFW_KEY_COMMA, false);
     Toggle decimate_one_more_face(ogl.window(), GLFW_KEY_PERIOD, false);
     Toggle export_obj(ogl.window(), GLFW_KEY_O, false);
     Toggle save_png(ogl.window(), GLFW_KEY_F2, false);
 
-    Model model(ogl.window(), file_path);
-
-    Subface sf;
-    sf.BuildTopology(model.indexed_vertex(), model.index());
-
+    // Indexed drawing, with flat normals from the fragment shader, so a decimation stepping by a face only updates the buffers
+    // around it.
+    ogl.Uniform("flat_normal", !use_smooth_normal.state());
+    std::vector<uint32_t> changed_vertexes, changed_corners;
     auto process = [&](Subface::EProcessingMethod method, int level) {
         Subface::GetProcessingMethod(method).process(sf, level);
-        ogl.Position(sf.Position());
-        if (use_smooth_normal.state())
-            ogl.Normal(sf.NormalSmooth());
-        else
-            ogl.Normal(sf.NormalFlat());
-
-        // ogl.Vertex(model.vertex());
-        // ogl.Normal(model.normal());
+        bool in_place = sf.TakeIndexedChanges(changed_vertexes, changed_corners);
+        if (quantize_normal_bits) {
+            QuantizedMesh q = sf.Quantize(quantize_normal_bits);
+            bool normals_8 = q.normal_bits == 8, indexes_16 = !q.indexes_16.empty();
+            ogl.QuantizedMesh(q.positions.data(), q.VertexCount(), q.position_offset, q.position_scale,
+                normals_8 ? static_cast<const void*>(q.normals_8.data()) : q.normals_16.data(), normals_8 ? GL_BYTE : GL_SHORT,
+                indexes_16 ? static_cast<const void*>(q.indexes_16.data()) : q.indexes_32.data(), q.IndexCount(),
+                indexes_16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+            return;
+        }
+        if (in_place && ogl.UpdateIndexedMesh(sf.IndexedPosition(), sf.IndexedNormalSmooth(), sf.Index(), changed_vertexes, changed_corners))
+            return;
+        sf.WriteIndexedPosition(ogl.PositionSink());
+        sf.WriteIndexedNormalSmooth(ogl.NormalSink());
+        sf.WriteIndex(ogl.IndexSink());
     };
     process(method, level);
 
     Subface::EProcessingMethod method_old = method;
     int level_old = level;
     while (ogl.Alive()) {
-        // clang-format off
-        use_smooth_normal.Update([&]() {
-            ogl.Normal(sf.NormalSmooth());
-        }, [&]() {
-            ogl.Normal(sf.NormalFlat());
-        });
-        // clang-format on
+        if (!quantize_normal_bits)
+            use_smooth_normal.Update([&]() {
+                ogl.Uniform("flat_normal", !use_smooth_normal.state());
+            });
 
         for (int key = GLFW_KEY_0; key <= GLFW_KEY_9; ++key)
             if (glfwGetKey(ogl.window(), key) == GLFW_PRESS) {
@@ -137,9 +297,10 @@ int main(int argc, char* argv[])
                     if (GLFW_KEY_1 <= key && key < GLFW_KEY_1 + Subface::PM_Decimate_Start)
                         method = static_cast<Subface::EProcessingMethod>(key - GLFW_KEY_1);
                 } else if (glfwGetKey(ogl.window(), GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(ogl.window(), GLFW_KEY_RIGHT_ALT) == GLFW_PRESS) {
-                    // Smaller complexity: decimation.
-                    if (GLFW_KEY_1 <= key && key < GLFW_KEY_1 + Subface::PM_Decimate_End - Subface::PM_Decimate_Start)
-                        method = static_cast<Subface::EProcessingMethod>(key - GLFW_KEY_1 + Subface::PM_Decimate_Start);
+                    // Smaller complexity: decimation. `0` follows `9` as on the keyboard.
+                    int id = key == GLFW_KEY_0 ? 9 : key - GLFW_KEY_1;
+                    if (id < Subface::PM_Decimate_End - Subface::PM_Decimate_Start)
+                        method = static_cast<Subface::EProcessingMethod>(id + Subface::PM_Decimate_Start);
                 } else {
                     level = key - GLFW_KEY_0;
                 }
@@ -165,34 +326,26 @@ int main(int argc, char* argv[])
             }
         }
 
-        auto get_processing_info = [&]() {
-            return fmt::format("{}.Normal_{}",
-                level == 0 ? "origin" : fmt::format("{}(level={})", Subface::GetProcessingMethod(method).name, level),
-                use_smooth_normal.state() ? "smooth" : "flat");
-        };
         auto get_rendering_info = [&]() {
             return fmt::format("{}.Cull_{}",
                 ogl.RenderModeName(), ogl.EnableCullFace());
         };
 
         auto export_obj_func = [&]() {
-            std::string file_name = fmt::format("{}.{}.obj",
-                file_path.substr(0, file_path.find_last_of('.')),
-                get_processing_info());
-            sf.ExportObj(file_name, use_smooth_normal.state());
+            export_result(use_smooth_normal.state());
         };
         export_obj.Update(export_obj_func);
 
         auto save_png_func = [&]() {
             std::string file_name = fmt::format("{}.{}.{}.png",
-                file_path.substr(0, file_path.find_last_of('.')),
-                get_processing_info(), get_rendering_info());
+                file_stem,
+                get_processing_info(use_smooth_normal.state()), get_rendering_info());
             ogl.SavePng(file_name);
         };
         save_png.Update(save_png_func);
 
         std::string program_info = fmt::format("{}.{}",
-            get_processing_info(), get_rendering_info());
+            get_processing_info(use_smooth_normal.state()), get_rendering_info());
         ogl.Update(program_info);
 
         if (cmd_mode) {
@@ -0,0 +1,80 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace subface {
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& file_name)
+{
+    HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    file_ = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        return;
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) {
+        valid_ = true;
+        return;
+    }
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+        return;
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    valid_ = data_ != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_)
+        CloseHandle(file_);
+}
+#else
+MappedFile::MappedFile(const std::string& file_name)
+{
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            valid_ = true;
+        } else {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                // The whole file is about to be read, by several threads at once.
+                madvise(data, size_, MADV_WILLNEED);
+                data_ = static_cast<const char*>(data);
+                valid_ = true;
+            }
+        }
+    }
+    // The mapping stays valid after closing the descriptor.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+        munmap(const_cast<char*>(data_), size_);
+}
+#endif
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace subface {
+
+// Read-only memory map of a whole file. The pages are loaded on first access and shared with the page cache,
+// so reading a file this way costs no copy into a user-space buffer.
+class MappedFile {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+
+public:
+    MappedFile(const std::string& file_name);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file can't be opened or mapped. An empty file is valid with `data() == nullptr`.
+    bool valid() const
+    {
+        return valid_;
+    }
+    const char* data() const
+    {
+        return data_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+};
+
+}
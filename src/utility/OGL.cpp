@@ -1,5 +1,6 @@
 #include "OGL.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -19,6 +20,7 @@ OGL::~OGL()
 {
     glDeleteBuffers(1, &position_buffer_);
     glDeleteBuffers(1, &normal_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
     glDeleteVertexArrays(1, &vertex_array_);
     glDeleteProgram(shader_);
 
@@ -223,37 +225,148 @@ void OGL::LoadShader(const char* vertex_file_path, const char* fragment_file_pat
     mv_ = glGetUniformLocation(shader_, "mv");
 }
 
-void OGL::Position(const std::vector<glm::vec3>& position)
+glm::vec3* OGL::BufferSink::Map(size_t count)
 {
-    glGenBuffers(1, &position_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, position_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * position.size(), position.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
+    // The buffer is reallocated below, so nothing is drawn from it until `Unmap()` finds it filled.
+    if (index_ == 0) {
+        ogl_.n_vertex_ = 0;
+        ogl_.indexed_ = false;
+        ogl_.Uniform("quantized", 0);
+    }
+    if (buffer_ == GLuint(-1))
+        glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * count, nullptr, GL_STATIC_DRAW);
+    count_ = count;
+    // Mapping an empty range is an error.
+    void* p = count > 0 ? glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : nullptr;
+    mapped_ = p != nullptr;
+    if (count > 0 && !mapped_)
+        spdlog::error("OGL::BufferSink::Map(): Failed to map {} vertexes of buffer {}", count, buffer_);
+    return static_cast<glm::vec3*>(p);
+}
+
+void OGL::BufferSink::Unmap()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    bool filled = true;
+    if (mapped_ && glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) {
+        spdlog::error("OGL::BufferSink::Unmap(): Buffer {} got corrupted while mapped", buffer_);
+        filled = false;
+    }
+    mapped_ = false;
+    glEnableVertexAttribArray(index_);
     glVertexAttribPointer(
-        0, // index
+        index_, // index
         3, // size
         GL_FLOAT, // type
         GL_FALSE, // normalized
         0, // stride
         (void*)0 // pointer
     );
-    n_vertex_ = position.size();
+    if (index_ == 0 && filled)
+        ogl_.n_vertex_ = count_;
+}
+
+uint32_t* OGL::IndexBufferSink::Map(size_t count)
+{
+    // Nothing is drawn until `Unmap()` finds the indexes filled. The element array binding is part of the vertex array.
+    ogl_.indexed_ = true;
+    ogl_.n_index_ = 0;
+    if (ogl_.index_buffer_ == GLuint(-1))
+        glGenBuffers(1, &ogl_.index_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ogl_.index_buffer_);
+    // Keep a quarter more room, so a growing mesh is mostly updated in place.
+    if (count > ogl_.index_capacity_) {
+        ogl_.index_capacity_ = count + count / 4;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * ogl_.index_capacity_, nullptr, GL_DYNAMIC_DRAW);
+    }
+    count_ = count;
+    void* p = count > 0 ? glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : nullptr;
+    mapped_ = p != nullptr;
+    if (count > 0 && !mapped_)
+        spdlog::error("OGL::IndexBufferSink::Map(): Failed to map {} indexes of buffer {}", count, ogl_.index_buffer_);
+    return static_cast<uint32_t*>(p);
+}
+
+void OGL::IndexBufferSink::Unmap()
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ogl_.index_buffer_);
+    bool filled = true;
+    if (mapped_ && glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_FALSE) {
+        spdlog::error("OGL::IndexBufferSink::Unmap(): Buffer {} got corrupted while mapped", ogl_.index_buffer_);
+        filled = false;
+    }
+    mapped_ = false;
+    if (filled) {
+        ogl_.n_index_ = count_;
+        ogl_.index_type_ = GL_UNSIGNED_INT;
+    }
+}
+
+// Copy the sorted `entries` of `data` below `count` into `buffer`, in one call per run of entries close to each other.
+template <typename T>
+static void UpdateBuffer(GLenum target, GLuint buffer, const T* data, size_t count, std::vector<uint32_t>& entries)
+{
+    // Copying a few unchanged entries is cheaper than another call.
+    const uint32_t gap = 16;
+    std::sort(entries.begin(), entries.end());
+    glBindBuffer(target, buffer);
+    for (size_t i = 0; i < entries.size() && entries[i] < count;) {
+        uint32_t begin = entries[i], end = begin + 1;
+        for (++i; i < entries.size() && entries[i] < count && entries[i] <= end + gap; ++i)
+            end = std::max(end, entries[i] + 1);
+        glBufferSubData(target, sizeof(T) * begin, sizeof(T) * (end - begin), data + begin);
+    }
 }
 
-void OGL::Normal(const std::vector<glm::vec3>& normal)
+bool OGL::UpdateIndexedMesh(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<int>& indexes,
+    std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners)
 {
-    glGenBuffers(1, &normal_buffer_);
+    if (!indexed_ || index_type_ != GL_UNSIGNED_INT || n_vertex_ != positions.size() || indexes.size() > index_capacity_)
+        return false;
+    UpdateBuffer(GL_ARRAY_BUFFER, position_buffer_, positions.data(), positions.size(), vertexes);
+    UpdateBuffer(GL_ARRAY_BUFFER, normal_buffer_, normals.data(), normals.size(), vertexes);
+    UpdateBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_, indexes.data(), indexes.size(), corners);
+    n_index_ = indexes.size();
+    return true;
+}
+
+void OGL::QuantizedMesh(const uint16_t* positions, size_t vertex_count, const glm::vec3& offset, const glm::vec3& scale,
+    const void* normals, GLenum normal_type, const void* indexes, size_t index_count, GLenum index_type)
+{
+    if (position_buffer_ == GLuint(-1))
+        glGenBuffers(1, &position_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, position_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t) * 3 * vertex_count, positions, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0, (void*)0);
+
+    // Before OpenGL 4.2, signed normalized integers can't represent 0, so the shader scales the normals itself.
+    GLsizei normal_size = normal_type == GL_BYTE ? 1 : 2;
+    if (normal_buffer_ == GLuint(-1))
+        glGenBuffers(1, &normal_buffer_);
     glBindBuffer(GL_ARRAY_BUFFER, normal_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normal.size(), normal.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, normal_size * 2 * vertex_count, normals, GL_STATIC_DRAW);
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(
-        1, // index
-        3, // size
-        GL_FLOAT, // type
-        GL_FALSE, // normalized
-        0, // stride
-        (void*)0 // pointer
-    );
+    glVertexAttribPointer(1, 2, normal_type, GL_FALSE, 0, (void*)0);
+
+    // The element array binding is part of the vertex array.
+    GLsizei index_size = index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+    if (index_buffer_ == GLuint(-1))
+        glGenBuffers(1, &index_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size * index_count, indexes, GL_STATIC_DRAW);
+    index_capacity_ = 0;
+    n_vertex_ = vertex_count;
+    indexed_ = true;
+    n_index_ = index_count;
+    index_type_ = index_type;
+
+    Uniform("quantized", 1);
+    glUniform3f(glGetUniformLocation(shader_, "position_offset"), offset.x, offset.y, offset.z);
+    glUniform3f(glGetUniformLocation(shader_, "position_scale"), scale.x, scale.y, scale.z);
+    glUniform1f(glGetUniformLocation(shader_, "normal_max"), normal_type == GL_BYTE ? 127.f : 32767.f);
 }
 
 void OGL::MVP(const glm::mat4& mvp) const
@@ -284,7 +397,10 @@ void OGL::Clear() const
 
 void OGL::Draw() const
 {
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(n_vertex_));
+    if (indexed_)
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(n_index_), index_type_, (void*)0);
+    else
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(n_vertex_));
 }
 
 void OGL::Update(const std::string& program_info)
@@ -309,17 +425,21 @@ void OGL::Update(const std::string& program_info)
     });
     if (render_mode_ == RM_FacesWireframe) {
         Uniform("wireframe", 0);
+        Uniform("lines", 0);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         Draw();
         Uniform("wireframe", 1);
+        Uniform("lines", 1);
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         Draw();
     } else if (render_mode_ == RM_FacesOnly) {
         Uniform("wireframe", 0);
+        Uniform("lines", 0);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         Draw();
     } else if (render_mode_ == RM_WireframeOnly) {
         Uniform("wireframe", 0);
+        Uniform("lines", 1);
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         Draw();
     }
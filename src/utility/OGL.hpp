@@ -10,10 +10,48 @@
 
 #include "Camera.hpp"
 #include "FPS.hpp"
+#include "OutputSink.hpp"
 #include "Toggle.hpp"
 
 class OGL {
 public:
+    // Vertex attribute buffer, written in place through `glMapBufferRange()` and bound to attribute `index` on `Unmap()`.
+    // Mapping the positions switches drawing back to unindexed float vertexes, drawn once `Unmap()` finds them filled, and indexed
+    // once an `IndexBufferSink` is filled after them.
+    class BufferSink : public subface::OutputSink<glm::vec3> {
+        OGL& ogl_;
+        GLuint& buffer_;
+        GLuint index_;
+        size_t count_ = 0;
+        bool mapped_ = false;
+
+    public:
+        BufferSink(OGL& ogl, GLuint& buffer, GLuint index)
+            : ogl_(ogl)
+            , buffer_(buffer)
+            , index_(index)
+        {
+        }
+        glm::vec3* Map(size_t count) override;
+        void Unmap() override;
+    };
+
+    // Index buffer of the float vertexes, written like `BufferSink`. It keeps some spare capacity, so the index count can grow in
+    // place, see `UpdateIndexedMesh()`.
+    class IndexBufferSink : public subface::OutputSink<uint32_t> {
+        OGL& ogl_;
+        size_t count_ = 0;
+        bool mapped_ = false;
+
+    public:
+        IndexBufferSink(OGL& ogl)
+            : ogl_(ogl)
+        {
+        }
+        uint32_t* Map(size_t count) override;
+        void Unmap() override;
+    };
+
     enum ERenderMode {
         RM_FacesWireframe,
         RM_FacesOnly,
@@ -32,8 +70,17 @@ private:
 
     GLuint shader_ = -1;
     GLuint mvp_ = -1, mv_ = -1;
-    GLuint vertex_array_ = -1, position_buffer_ = -1, normal_buffer_ = -1;
+    GLuint vertex_array_ = -1, position_buffer_ = -1, normal_buffer_ = -1, index_buffer_ = -1;
     size_t n_vertex_ = -1;
+    // Indexed drawing of a quantized mesh or of the float vertexes if `indexed_`.
+    bool indexed_ = false;
+    size_t n_index_ = 0;
+    GLenum index_type_ = GL_UNSIGNED_INT;
+    // Indexes the index buffer holds room for, 0 unless `index_sink_` filled it.
+    size_t index_capacity_ = 0;
+    BufferSink position_sink_ { *this, position_buffer_, 0 };
+    BufferSink normal_sink_ { *this, normal_buffer_, 1 };
+    IndexBufferSink index_sink_ { *this };
 
     Toggle enable_cull_face_;
     Toggle enable_transparent_window_;
@@ -47,8 +94,29 @@ public:
     ~OGL();
     GLFWwindow* InitGLFW(std::string window_title, int window_w, int window_h, bool cmd_mode);
     void InitGL(const char* vertex_file_path, const char* fragment_file_path, const char* geometry_file_path = nullptr);
-    void Position(const std::vector<glm::vec3>& vertex);
-    void Normal(const std::vector<glm::vec3>& normal);
+    // Sinks writing the positions and normals straight into the GL buffers, without a copy in between.
+    BufferSink& PositionSink()
+    {
+        return position_sink_;
+    }
+    BufferSink& NormalSink()
+    {
+        return normal_sink_;
+    }
+    IndexBufferSink& IndexSink()
+    {
+        return index_sink_;
+    }
+    // Copy the `vertexes` of `positions` and `normals` and the `corners` of `indexes` into the buffers the sinks filled, and draw
+    // `indexes.size()` indexes, for meshes changing in place. `vertexes` and `corners` are sorted and may repeat. Corners past
+    // `indexes` are skipped. Returns false without a change if the buffers don't hold as many vertexes or room for the indexes.
+    bool UpdateIndexedMesh(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<int>& indexes,
+        std::vector<uint32_t>& vertexes, std::vector<uint32_t>& corners);
+    // Indexed mesh with 3 16-bit unsigned normalized components per position, dequantized as `offset + scale * position`,
+    // and 2 octahedral components per normal of `normal_type` `GL_BYTE` or `GL_SHORT`.
+    // `index_type` is `GL_UNSIGNED_SHORT` or `GL_UNSIGNED_INT`.
+    void QuantizedMesh(const uint16_t* positions, size_t vertex_count, const glm::vec3& offset, const glm::vec3& scale,
+        const void* normals, GLenum normal_type, const void* indexes, size_t index_count, GLenum index_type);
     void MVP(const glm::mat4& mvp) const;
     void MV(const glm::mat4& mv) const;
     void Uniform(const std::string& name, int value) const;
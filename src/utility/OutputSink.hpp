@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+namespace subface {
+
+// Caller-owned destination of an output, e.g. a mapped GL buffer, a memory-mapped file region or a custom allocation.
+// The producer calls `Map(count)` once, writes `count` elements to the returned memory, possibly from several threads,
+// then calls `Unmap()`. `Map()` may return `nullptr` to refuse a non-empty output, in which case `Unmap()` isn't called.
+template <typename T>
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual T* Map(size_t count) = 0;
+    virtual void Unmap() { }
+};
+
+// Fixed memory of `capacity` elements. Refuses outputs that don't fit.
+template <typename T>
+class SpanSink : public OutputSink<T> {
+    T* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+
+public:
+    SpanSink(T* data, size_t capacity)
+        : data_(data)
+        , capacity_(capacity)
+    {
+    }
+
+    T* Map(size_t count) override
+    {
+        if (count > capacity_)
+            return nullptr;
+        size_ = count;
+        return data_;
+    }
+    // Element count of the last output.
+    size_t size() const
+    {
+        return size_;
+    }
+};
+
+}
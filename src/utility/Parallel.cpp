@@ -0,0 +1,71 @@
+#include "Parallel.hpp"
+
+namespace subface {
+
+ThreadPool& ThreadPool::Instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+int ThreadPool::Take(Batch& batch)
+{
+    int i = batch.next++;
+    if (batch.next == batch.count)
+        batches_.erase(std::find(batches_.begin(), batches_.end(), &batch));
+    return i;
+}
+
+void ThreadPool::Run(int count, const std::function<void(int)>& task)
+{
+    Batch batch { &task, count };
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (workers_.size() < static_cast<size_t>(count - 1))
+        workers_.emplace_back(&ThreadPool::Work, this);
+    batches_.push_back(&batch);
+    work_.notify_all();
+
+    while (batch.next < batch.count) {
+        int i = Take(batch);
+        lock.unlock();
+        task(i);
+        lock.lock();
+        ++batch.done;
+    }
+    done_.wait(lock, [&]() {
+        return batch.done == batch.count;
+    });
+}
+
+void ThreadPool::Work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_.wait(lock, [&]() {
+            return stop_ || !batches_.empty();
+        });
+        if (stop_)
+            return;
+
+        Batch& batch = *batches_.front();
+        int i = Take(batch);
+        lock.unlock();
+        (*batch.task)(i);
+        lock.lock();
+        if (++batch.done == batch.count)
+            done_.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace subface {
+
+inline int DefaultThreadCount()
+{
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Process-wide workers, started on first use and kept for the later calls, so a parallel loop doesn't pay for starting threads.
+// The workers grow to the largest batch run so far. A batch may run batches of its own: every caller runs the tasks of its batch
+// that no worker took, so it never waits for a task that hasn't started.
+class ThreadPool {
+    struct Batch {
+        const std::function<void(int)>* task;
+        int count;
+        // Guarded by `mutex_`.
+        int next = 0;
+        int done = 0;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    std::deque<Batch*> batches_;
+    std::vector<std::thread> workers_;
+    bool stop_ = false;
+
+    ThreadPool() = default;
+    ~ThreadPool();
+    void Work();
+    // Take the next task of `batch`, and remove `batch` from the queue when it's the last one. Call with `mutex_` locked.
+    int Take(Batch& batch);
+
+public:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& Instance();
+    // Call `task(i)` for each `i` in `[0, count)`, on the calling thread and up to `count - 1` workers. Returns when all are done.
+    void Run(int count, const std::function<void(int)>& task);
+};
+
+// Call `func(begin, end, thread_id)` on `thread_count` contiguous ranges splitting `[0, count)`, on the threads of `ThreadPool`.
+// The split only depends on `count` and `thread_count`, so results merged by `thread_id` are deterministic.
+template <typename Func>
+void ParallelFor(size_t count, int thread_count, const Func& func)
+{
+    thread_count = static_cast<int>(std::max(size_t(1), std::min(static_cast<size_t>(std::max(thread_count, 1)), count)));
+    if (thread_count == 1) {
+        func(size_t(0), count, 0);
+        return;
+    }
+
+    ThreadPool::Instance().Run(thread_count, [&](int t) {
+        func(count * t / thread_count, count * (t + 1) / thread_count, t);
+    });
+}
+
+}